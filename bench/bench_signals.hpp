@@ -0,0 +1,86 @@
+#ifndef BENCH_BENCH_SIGNALS_HPP
+#define BENCH_BENCH_SIGNALS_HPP
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "webrtc/common_audio/wav_reader.hpp"
+
+// Inputs of the benchmarks, the same on every run:
+//   silence  - dither of a couple of LSBs,
+//   noise    - white noise at -30 dBFS,
+//   speech   - synthetic voiced speech with syllables and pauses,
+//   clipped  - the same speech, 18 dB louder and saturated,
+//   recorded - a WAVE file resampled to the rate, see LoadRecorded().
+namespace bench {
+static inline int16_t Saturate(double value) {
+    return (int16_t)std::max(-32768.0, std::min(32767.0, std::round(value)));
+}
+
+// |seconds| of the synthetic input |input| at |rate|.
+static inline std::vector<int16_t> Synthesize(const std::string& input, int rate, int seconds) {
+    std::vector<int16_t> audio((size_t)rate * seconds);
+    std::mt19937 rng(1);
+    std::normal_distribution<double> gaussian(0, 1);
+    if (input == "silence" || input == "noise") {
+        double level = input == "silence" ? 2 : 32768 * 0.0316;
+        for (int16_t& sample : audio) {
+            sample = Saturate(level * gaussian(rng));
+        }
+        return audio;
+    }
+
+    // Harmonics of a gliding pitch, shaped into syllables of about 140 ms,
+    // with a pause of 600 ms every 2 s, over a faint noise floor.
+    const double gain = input == "clipped" ? 8 : 1;
+    double phase = 0;
+    for (size_t i = 0; i < audio.size(); i++) {
+        double t = (double)i / rate;
+        double pitch = 140 + 40 * sin(2 * M_PI * 0.3 * t);
+        phase += 2 * M_PI * pitch / rate;
+        double syllable = sin(2 * M_PI * 3.5 * t);
+        double envelope = fmod(t, 2.0) < 1.4 ? syllable * syllable : 0;
+        double voiced = 0;
+        for (int k = 1; k * pitch < 3400 && k * pitch < rate / 2; k++) {
+            // Emphasize the first formant region.
+            voiced += (k * pitch > 300 && k * pitch < 900 ? 2.0 : 1.0) / k * sin(k * phase);
+        }
+        audio[i] = Saturate(gain * (4000 * envelope * voiced + 30 * gaussian(rng)));
+    }
+    return audio;
+}
+
+// |wav_path| as mono 16-bit at |rate|, by linear interpolation, looped to
+// |seconds|. Empty if the file cannot be read.
+static inline std::vector<int16_t> LoadRecorded(const std::string& wav_path, int rate, int seconds) {
+    webrtc::WavReader reader;
+    if (!reader.Open(wav_path.c_str()) || reader.num_samples() < 2) {
+        return std::vector<int16_t>();
+    }
+    std::vector<int16_t> source(reader.num_samples());
+    // Mono 16-bit files are read in place, others converted into |source|.
+    const int16_t* samples = reader.GetFrame(0, source.size(), source.data());
+    if (samples != source.data()) {
+        source.assign(samples, samples + source.size());
+    }
+
+    std::vector<int16_t> audio((size_t)rate * seconds);
+    double step = (double)reader.sample_rate() / rate;
+    double position = 0;
+    for (int16_t& sample : audio) {
+        size_t index = (size_t)position;
+        double fraction = position - index;
+        sample = Saturate(source[index] * (1 - fraction) + source[index + 1] * fraction);
+        position += step;
+        if (position >= source.size() - 1) {
+            position -= source.size() - 1;
+        }
+    }
+    return audio;
+}
+}  // namespace bench
+#endif
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Compares vad_bench or vad_kernels results with a stored baseline.
+
+    compare.py [--metric METRIC] [--threshold 0.10] [--ignore FIELD]... baseline.json results.json
+
+Cases are matched on their descriptive fields: (path, input, cache, rate,
+frame_ms, mode, threads) for vad_bench, (kernel, input) for vad_kernels,
+except those given with --ignore; e.g., --ignore lite matches the results of
+vad_bench -L with a default-mode baseline to show the speed-up. A
+case regresses when its metric (ns_per_frame or cycles_per_sample by default)
+grew by more than the threshold, relative to the baseline. Prints the
+regressions and improvements, the geometric mean ratio per path or kernel,
+and exits with status 1 if anything regressed or no case matched the baseline,
+so it can gate a merge. Store a baseline with `vad_bench -o baseline.json` on
+the machine the comparison runs on; numbers from different machines do not
+compare.
+"""
+
+import argparse
+import json
+import math
+import sys
+
+METRICS = ("ns_per_frame", "p50_ns", "p99_ns", "max_ns", "cycles_per_sample", "cycles_per_call", "cycles_per_frame")
+# Measured values that are not compared, and so not part of the key either.
+MEASURED = METRICS + ("rtf", "frames_per_second", "frames", "calls", "samples")
+
+
+def load(path, ignored=()):
+    with open(path) as f:
+        results = json.load(f)["results"]
+    return {tuple((k, v) for k, v in result.items() if k not in MEASURED and k not in ignored): result
+            for result in results}
+
+
+def describe(key):
+    return " ".join("%s=%s" % item for item in key)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flags benchmark regressions against a baseline.")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--metric", choices=METRICS)
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative growth of the metric counted as a regression (default 0.10)")
+    parser.add_argument("--ignore", action="append", default=[], metavar="FIELD",
+                        help="descriptive field left out of the match, e.g., lite or cascade")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.ignore)
+    results = load(args.results, args.ignore)
+    if args.metric is None:
+        first = next(iter(results.values()), {})
+        args.metric = "ns_per_frame" if "ns_per_frame" in first else "cycles_per_sample"
+    regressions = []
+    improvements = []
+    ratios = {}
+    for key, result in sorted(results.items()):
+        old = baseline.get(key, {}).get(args.metric)
+        new = result.get(args.metric)
+        if not old or new is None:
+            continue
+        ratio = new / old
+        ratios.setdefault(key[0][1], []).append(ratio)
+        if ratio > 1 + args.threshold:
+            regressions.append((ratio, key, old, new))
+        elif ratio < 1 / (1 + args.threshold):
+            improvements.append((ratio, key, old, new))
+
+    for title, entries in (("regressions", sorted(regressions, reverse=True)), ("improvements", sorted(improvements))):
+        print("%d %s in %s (threshold %.0f%%)" % (len(entries), title, args.metric, args.threshold * 100))
+        for ratio, key, old, new in entries:
+            print("  %s: %10.1f -> %10.1f (%+.1f%%)" % (describe(key), old, new, (ratio - 1) * 100))
+
+    for path, values in sorted(ratios.items()):
+        mean = math.exp(sum(math.log(value) for value in values) / len(values))
+        print("%s: geometric mean %+.1f%% over %d cases" % (path, (mean - 1) * 100, len(values)))
+    missing = sorted(set(baseline) - set(results))
+    if missing:
+        print("%d baseline cases not in the results" % len(missing))
+    if not ratios:
+        # E.g., kernel results against a vad_bench baseline.
+        print("no case of the results matches the baseline, nothing compared", file=sys.stderr)
+        return 1
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,430 @@
+// vad_bench: throughput and latency of the VAD for every sample rate, frame
+// length and mode.
+//
+//   vad_bench [-t seconds] [-r repetitions] [-j threads] [-p paths] [-i inputs]
+//             [-c caches] [-g] [-L] [-w file.wav] [-o results.json]
+//
+// Every valid (rate, frame_ms, mode) combination is run |repetitions| times
+// (3 by default) for |seconds| (0.05) each, keeping the fastest run to damp
+// the noise of shared machines, on each of the comma-separated
+//   paths   single   - one instance on one thread,
+//           threads  - |threads| instances, one per thread, run concurrently,
+//           batch    - VadProcessChunked() over the whole input on |threads|
+//                      threads, as vad -k does;
+//   inputs  silence, noise, speech, clipped, see bench_signals.hpp, and
+//           recorded - |file.wav| (examples/wave_data/wave_1.wav by default),
+//                      resampled to each rate;
+//   caches  warm     - the instance and its input stay in cache,
+//           cold     - the instance's state and the frame are flushed from
+//                      every cache level before each frame (x86 only), as for
+//                      a server with many more streams than fit in cache.
+// All of them are run by default. -g runs the single and threads paths in
+// cascade mode, see WebRtcVad_set_cascade(), and -L in lite mode, see
+// WebRtcVad_set_lite(); their results are marked with "cascade": true and
+// "lite": true, so compare.py keeps them apart from default-mode runs. To
+// get the speed-up of the lite mode, compare them with a default-mode run
+// with compare.py --ignore lite.
+//
+// Results are written as JSON (stdout unless -o), one entry per case with
+//   ns_per_frame       - mean time of one frame on one thread,
+//   rtf                - real-time factor of one stream on one thread,
+//                        ns_per_frame over the frame duration,
+//   frames_per_second  - frames processed per second over all threads,
+//   p50_ns, p99_ns,
+//   max_ns             - latency percentiles of single frames, measured
+//                        frame by frame (not for batch),
+// and compared with a stored baseline by compare.py.
+//
+// Built with -DWEBRTC_VAD_PERF (make perf), it also prints the hardware
+// counters of each pipeline stage over all cases on stderr, see vad_perf.hpp.
+// The counters slow every frame down, so such builds are for the breakdown,
+// not for timings.
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_signals.hpp"
+#include "webrtc/vad/vad_chunked.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const int kRates[] = {8000, 16000, 32000, 48000};
+static const int kFrameMs[] = {10, 20, 30};
+static const int kModes[] = {0, 1, 2, 3};
+static const char* const kPaths[] = {"single", "threads", "batch"};
+static const char* const kInputs[] = {"silence", "noise", "speech", "clipped", "recorded"};
+static const char* const kCaches[] = {"warm", "cold"};
+// Length of every input, looped over by the single and threads paths.
+static const int kInputSeconds = 30;
+// Cap on the frames timed one by one per thread, for the percentiles.
+static const size_t kMaxLatencySamples = 1 << 20;
+static const size_t kCacheLineSize = 64;
+
+struct Options {
+    double seconds = 0.05;
+    int repetitions = 3;
+    size_t num_threads = 0;
+    vector<string> paths;
+    vector<string> inputs;
+    vector<string> caches;
+    bool cascade = false;
+    bool lite = false;
+    string wav_path = "../examples/wave_data/wave_1.wav";
+    string output_path;
+};
+
+struct Case {
+    string path;
+    string input;
+    string cache;
+    int rate;
+    int frame_ms;
+    int mode;
+    size_t threads;
+    bool cascade;
+    bool lite;
+};
+
+struct Result {
+    uint64_t frames = 0;
+    double ns_per_frame = 0;
+    double frames_per_second = 0;
+    // Per-frame latencies, empty for batch.
+    vector<uint32_t> latencies;
+};
+
+static vector<string> Split(const char* list) {
+    vector<string> items;
+    string item;
+    for (const char* p = list;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0') {
+                return items;
+            }
+        } else {
+            item += *p;
+        }
+    }
+}
+
+static bool Selected(const vector<string>& selection, const char* name) {
+    return find(selection.begin(), selection.end(), name) != selection.end();
+}
+
+// Flushes [data, data + size) from every cache level.
+static void Evict(const void* data, size_t size) {
+#if defined(__x86_64__) || defined(__i386__)
+    uintptr_t line = (uintptr_t)data & ~(uintptr_t)(kCacheLineSize - 1);
+    for (; line < (uintptr_t)data + size; line += kCacheLineSize) {
+        _mm_clflush(reinterpret_cast<const void*>(line));
+    }
+    _mm_mfence();
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+
+static bool CanEvict() {
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Runs frames of |audio| through a new instance for |seconds|, timing frames
+// one by one so that the evictions of cold runs are not counted.
+static bool RunStream(const Case& c, const vector<int16_t>& audio, double seconds, bool cold, Result* result) {
+    const size_t frame_length = (size_t)(c.rate / 1000 * c.frame_ms);
+    const size_t num_frames = audio.size() / frame_length;
+    VadInst* handle = WebRtcVad_Create();
+    if (handle == nullptr || WebRtcVad_Init(handle) != 0 || WebRtcVad_set_mode(handle, c.mode) != 0 ||
+        WebRtcVad_set_cascade(handle, c.cascade) != 0 || WebRtcVad_set_lite(handle, c.lite) != 0) {
+        WebRtcVad_Free(handle);
+        return false;
+    }
+
+    auto now = chrono::steady_clock::now();
+    auto deadline = now + chrono::duration<double>(seconds);
+    chrono::nanoseconds busy(0);
+    size_t frame = 0;
+    bool ok = true;
+    result->latencies.clear();
+    result->latencies.reserve(min(kMaxLatencySamples, (size_t)(seconds * 1e6)));
+    while (ok && now < deadline) {
+        const int16_t* samples = &audio[frame * frame_length];
+        if (cold) {
+            Evict(handle, sizeof(VadInstT));
+            Evict(samples, frame_length * sizeof(int16_t));
+        }
+        auto start = chrono::steady_clock::now();
+        ok = WebRtcVad_Process(handle, c.rate, samples, frame_length) >= 0;
+        now = chrono::steady_clock::now();
+        auto elapsed = now - start;
+        busy += elapsed;
+        if (result->latencies.size() < kMaxLatencySamples) {
+            result->latencies.push_back((uint32_t)min<int64_t>(elapsed.count(), UINT32_MAX));
+        }
+        result->frames++;
+        frame = frame + 1 < num_frames ? frame + 1 : 0;
+    }
+    WebRtcVad_Free(handle);
+    result->ns_per_frame = result->frames > 0 ? (double)busy.count() / result->frames : 0;
+    return ok;
+}
+
+static bool RunThreads(const Case& c, const vector<int16_t>& audio, double seconds, bool cold, Result* result) {
+    vector<Result> results(c.threads);
+    vector<char> ok(c.threads, 0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < c.threads; i++) {
+        threads.emplace_back([&, i] { ok[i] = RunStream(c, audio, seconds, cold, &results[i]); });
+    }
+    bool all_ok = true;
+    double busy = 0;
+    for (size_t i = 0; i < c.threads; i++) {
+        threads[i].join();
+        all_ok = all_ok && ok[i];
+        result->frames += results[i].frames;
+        busy += results[i].ns_per_frame * results[i].frames;
+        result->latencies.insert(result->latencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+    }
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result->ns_per_frame = result->frames > 0 ? busy / result->frames : 0;
+    // Cold runs spend much of the wall time evicting; count processing only.
+    result->frames_per_second =
+        cold ? (result->ns_per_frame > 0 ? c.threads * 1e9 / result->ns_per_frame : 0) : result->frames / wall;
+    return all_ok;
+}
+
+static bool RunBatch(const Case& c, const vector<int16_t>& audio, double seconds, Result* result) {
+    const size_t frame_length = (size_t)(c.rate / 1000 * c.frame_ms);
+    const size_t num_frames = audio.size() / frame_length;
+    vector<Vad::Activity> decisions(num_frames);
+    auto start = chrono::steady_clock::now();
+    double wall = 0;
+    do {
+        if (!VadProcessChunked(static_cast<Vad::Aggressiveness>(c.mode), audio.data(), num_frames, frame_length,
+                               c.rate, c.threads, 0, decisions.data())) {
+            return false;
+        }
+        result->frames += num_frames;
+        wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (wall < seconds);
+    result->frames_per_second = result->frames / wall;
+    result->ns_per_frame = wall * 1e9 * min(c.threads, num_frames) / result->frames;
+    return true;
+}
+
+// Runs |c| |options.repetitions| times and keeps the fastest run in |result|.
+static bool RunCase(const Case& c, const vector<int16_t>& audio, const Options& options, Result* result) {
+    bool cold = c.cache == "cold";
+    for (int i = 0; i < options.repetitions; i++) {
+        Result run;
+        bool ok;
+        if (c.path == "single") {
+            ok = RunStream(c, audio, options.seconds, cold, &run);
+            run.frames_per_second = run.ns_per_frame > 0 ? 1e9 / run.ns_per_frame : 0;
+        } else if (c.path == "threads") {
+            ok = RunThreads(c, audio, options.seconds, cold, &run);
+        } else {
+            ok = RunBatch(c, audio, options.seconds, &run);
+        }
+        if (!ok) {
+            return false;
+        }
+        if (i == 0 || run.ns_per_frame < result->ns_per_frame) {
+            *result = move(run);
+        }
+    }
+    return true;
+}
+
+static double Percentile(vector<uint32_t>* values, double fraction) {
+    if (values->empty()) {
+        return 0;
+    }
+    size_t index = min(values->size() - 1, (size_t)(fraction * values->size()));
+    nth_element(values->begin(), values->begin() + index, values->end());
+    return (*values)[index];
+}
+
+static void WriteResult(FILE* file, const Case& c, Result* result, bool first) {
+    double frame_ns = c.frame_ms * 1e6;
+    fprintf(file,
+            "%s    {\"path\": \"%s\", \"input\": \"%s\", \"cache\": \"%s\", \"rate\": %d, \"frame_ms\": %d, "
+            "\"mode\": %d, \"threads\": %zu, \"frames\": %llu, \"ns_per_frame\": %.1f, \"rtf\": %.6f, "
+            "\"frames_per_second\": %.0f",
+            first ? "" : ",\n", c.path.c_str(), c.input.c_str(), c.cache.c_str(), c.rate, c.frame_ms, c.mode,
+            c.threads, (unsigned long long)result->frames, result->ns_per_frame, result->ns_per_frame / frame_ns,
+            result->frames_per_second);
+    if (c.cascade) {
+        fprintf(file, ", \"cascade\": true");
+    }
+    if (c.lite) {
+        fprintf(file, ", \"lite\": true");
+    }
+    if (!result->latencies.empty()) {
+        double p50 = Percentile(&result->latencies, 0.5);
+        double p99 = Percentile(&result->latencies, 0.99);
+        double max = *max_element(result->latencies.begin(), result->latencies.end());
+        fprintf(file, ", \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f", p50, p99, max);
+    }
+    fprintf(file, "}");
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options->seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            options->repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options->num_threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            options->paths = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            options->inputs = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            options->caches = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-g") == 0) {
+            options->cascade = true;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            options->lite = true;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options->wav_path = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    if (options->num_threads == 0) {
+        options->num_threads = max(2u, thread::hardware_concurrency());
+    }
+    if (options->paths.empty()) {
+        options->paths.assign(begin(kPaths), end(kPaths));
+    }
+    if (options->inputs.empty()) {
+        options->inputs.assign(begin(kInputs), end(kInputs));
+    }
+    if (options->caches.empty()) {
+        options->caches.assign(begin(kCaches), end(kCaches));
+    }
+    for (const string& path : options->paths) {
+        if (!Selected(vector<string>(begin(kPaths), end(kPaths)), path.c_str())) {
+            return false;
+        }
+    }
+    for (const string& input : options->inputs) {
+        if (!Selected(vector<string>(begin(kInputs), end(kInputs)), input.c_str())) {
+            return false;
+        }
+    }
+    for (const string& cache : options->caches) {
+        if (!Selected(vector<string>(begin(kCaches), end(kCaches)), cache.c_str())) {
+            return false;
+        }
+    }
+    return options->seconds > 0 && options->repetitions > 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-t seconds] [-r repetitions] [-j threads] [-p single,threads,batch]\n"
+                "       [-i silence,noise,speech,clipped,recorded] [-c warm,cold] [-g] [-L] [-w file.wav]\n"
+                "       [-o results.json]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (Selected(options.caches, "cold") && !CanEvict()) {
+        fprintf(stderr, "vad_bench: cold runs need x86 cache flushes, skipping them\n");
+        options.caches.erase(find(options.caches.begin(), options.caches.end(), "cold"));
+    }
+    FILE* file = stdout;
+    if (!options.output_path.empty()) {
+        file = fopen(options.output_path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "vad_bench: cannot write %s\n", options.output_path.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(file,
+            "{\n  \"version\": 1,\n  \"compiler\": \"%s\",\n  \"cpus\": %u,\n  \"seconds\": %g,\n"
+            "  \"repetitions\": %d,\n",
+            __VERSION__, thread::hardware_concurrency(), options.seconds, options.repetitions);
+    fprintf(file, "  \"results\": [\n");
+    bool first = true;
+    bool ok = true;
+    for (const string& input : options.inputs) {
+        for (int rate : kRates) {
+            vector<int16_t> audio = input == "recorded" ? bench::LoadRecorded(options.wav_path, rate, kInputSeconds)
+                                                        : bench::Synthesize(input, rate, kInputSeconds);
+            if (audio.empty()) {
+                fprintf(stderr, "vad_bench: cannot read %s, skipping recorded input\n", options.wav_path.c_str());
+                break;
+            }
+            for (int frame_ms : kFrameMs) {
+                for (int mode : kModes) {
+                    for (const string& path : options.paths) {
+                        for (const string& cache : options.caches) {
+                            // Batch streams through its input; it has no cache variants.
+                            if (path == "batch" && cache != options.caches.front()) {
+                                continue;
+                            }
+                            Case c = {path,
+                                      input,
+                                      path == "batch" ? "stream" : cache,
+                                      rate,
+                                      frame_ms,
+                                      mode,
+                                      path == "single" ? 1 : options.num_threads,
+                                      options.cascade && path != "batch",
+                                      options.lite && path != "batch"};
+                            Result result;
+                            if (!RunCase(c, audio, options, &result)) {
+                                fprintf(stderr, "vad_bench: %s %s %s %d Hz %d ms mode %d failed\n", path.c_str(),
+                                        input.c_str(), c.cache.c_str(), rate, frame_ms, mode);
+                                ok = false;
+                                continue;
+                            }
+                            fprintf(stderr, "%-8s %-9s %-6s %5d Hz %2d ms mode %d: %8.1f ns/frame, rtf %.6f%s%s\n",
+                                    path.c_str(), input.c_str(), c.cache.c_str(), rate, frame_ms, mode,
+                                    result.ns_per_frame, result.ns_per_frame / (frame_ms * 1e6),
+                                    c.cascade ? ", cascade" : "", c.lite ? ", lite" : "");
+                            WriteResult(file, c, &result, first);
+                            first = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+    ok = fflush(file) == 0 && (file == stdout || fclose(file) == 0) && ok;
+    VadPerfStats perf;
+    if (WebRtcVad_GetPerfStats(&perf) == 0) {
+        fprintf(stderr, "vad_bench: pipeline stages over all cases\n");
+        WebRtcVad_PrintPerfStats(stderr, &perf);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
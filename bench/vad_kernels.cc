@@ -0,0 +1,427 @@
+// vad_kernels: cycles per sample of every DSP primitive in the VAD's hot path.
+//
+//   vad_kernels [-r repetitions] [-i inputs] [-w file.wav] [-o results.json]
+//
+// Each kernel is fed the data it sees when the VAD processes the input, not
+// synthetic vectors: the inputs (silence, noise, speech, clipped and recorded,
+// see bench_signals.hpp) are run through the real pipeline at 10 ms frames,
+// recording the arguments of every call of
+//   WebRtcSpl_Resample48khzTo8khz  48 kHz -> 8 kHz, 480 samples per call,
+//   WebRtcVad_Downsampling         32 -> 16 and 16 -> 8 kHz,
+//   SplitFilter, AllPassFilter     the five band splits,
+//   HighPassFilter                 the 80 Hz high pass of the lowest band,
+//   LogOfEnergy, WebRtcSpl_Energy  the six band energies,
+//   WebRtcVad_GaussianProbability  24 per frame, against the adapting model,
+//   WebRtcVad_FindMinimum          6 per frame,
+//   GmmProbability                 once per frame, on the recorded features,
+// and the calls are then replayed |repetitions| times (5 by default) between
+// two reads of the time-stamp counter, keeping the fastest replay.
+//
+// Reported per kernel and input, as JSON (stdout unless -o) and as a table on
+// stderr:
+//   cycles_per_sample  - per input sample of the call; feature values for
+//                        WebRtcVad_GaussianProbability and
+//                        WebRtcVad_FindMinimum, the 80 samples of the 8 kHz
+//                        frame for GmmProbability,
+//   cycles_per_call,
+//   cycles_per_frame   - spent in the kernel per 10 ms frame.
+// Kernels include the kernels they call: SplitFilter its AllPassFilter calls,
+// LogOfEnergy its WebRtcSpl_Energy call and GmmProbability its
+// WebRtcVad_GaussianProbability and WebRtcVad_FindMinimum calls.
+// Cycles are TSC ticks, i.e., at the nominal frequency, also reported; on
+// other than x86 the unit is nanoseconds. compare.py compares runs.
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_signals.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const char* const kInputs[] = {"silence", "noise", "speech", "clipped", "recorded"};
+static const int kInputSeconds = 10;
+static const size_t kFrameLength8khz = 80;
+
+struct Options {
+    int repetitions = 5;
+    vector<string> inputs;
+    string wav_path = "../examples/wave_data/wave_1.wav";
+    string output_path;
+};
+
+// Arguments of the calls of one kernel, recorded from the pipeline.
+struct Signal {
+    vector<int16_t> data;
+    // Band of SplitFilter() calls, for their state, or channel of
+    // LogOfEnergy() calls.
+    int band;
+};
+
+struct GaussianCall {
+    int16_t input;
+    int16_t mean;
+    int16_t std;
+};
+
+struct Capture {
+    size_t frames = 0;
+    vector<Signal> resample;
+    vector<Signal> downsampling;
+    vector<Signal> split;
+    vector<Signal> high_pass;
+    vector<Signal> energy;
+    vector<GaussianCall> gaussian;
+    // Feature vectors and total power of every frame, from the start of
+    // |model|.
+    vector<int16_t> features;
+    vector<int16_t> total_power;
+    VadInstT model;
+};
+
+struct Measurement {
+    const char* kernel;
+    uint64_t calls;
+    uint64_t samples;
+    double ticks;
+};
+
+static inline uint64_t Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+#else
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+static const char* TickUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+// Ticks per nanosecond, measured against the steady clock.
+static double TicksPerNanosecond() {
+    auto start = chrono::steady_clock::now();
+    uint64_t ticks = Ticks();
+    this_thread::sleep_for(chrono::milliseconds(50));
+    uint64_t elapsed_ticks = Ticks() - ticks;
+    return elapsed_ticks / (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start)
+                               .count();
+}
+
+// The band splits and energies of WebRtcVad_CalculateFeatures(), recording the
+// input of every call.
+static int16_t CaptureFeatures(VadInstT* self, const int16_t* data_in, int16_t* features, Capture* capture) {
+    int16_t total_energy = 0;
+    int16_t hp_120[120], lp_120[120];
+    int16_t hp_60[60], lp_60[60];
+    size_t length = kFrameLength8khz / 2;
+    auto split = [self, capture](const int16_t* in, size_t in_length, int band, int16_t* hp, int16_t* lp) {
+        capture->split.push_back({vector<int16_t>(in, in + in_length), band});
+        SplitFilter(in, in_length, &self->upper_state[band], &self->lower_state[band], hp, lp);
+    };
+    auto energy = [capture, &total_energy, features](const int16_t* in, size_t in_length, int channel) {
+        capture->energy.push_back({vector<int16_t>(in, in + in_length), channel});
+        LogOfEnergy(in, in_length, kOffsetVector[channel], &total_energy, &features[channel]);
+    };
+
+    split(data_in, kFrameLength8khz, 0, hp_120, lp_120);
+    split(hp_120, length, 1, hp_60, lp_60);
+    energy(hp_60, length / 2, 5);
+    energy(lp_60, length / 2, 4);
+    split(lp_120, length, 2, hp_60, lp_60);
+    length /= 2;
+    energy(hp_60, length, 3);
+    split(lp_60, length, 3, hp_120, lp_120);
+    length /= 2;
+    energy(hp_120, length, 2);
+    split(lp_120, length, 4, hp_60, lp_60);
+    length /= 2;
+    energy(hp_60, length, 1);
+    capture->high_pass.push_back({vector<int16_t>(lp_60, lp_60 + length), 0});
+    HighPassFilter(lp_60, length, self->hp_filter_state, hp_120);
+    energy(hp_120, length, 0);
+    return total_energy;
+}
+
+// Runs |input| at 48 kHz through the pipeline at 10 ms frames.
+static bool CaptureInput(const vector<int16_t>& audio_48khz, Capture* capture) {
+    VadInst* handle = WebRtcVad_Create();
+    if (handle == nullptr || WebRtcVad_Init(handle) != 0 || WebRtcVad_set_mode(handle, 0) != 0) {
+        WebRtcVad_Free(handle);
+        return false;
+    }
+    VadInstT* self = reinterpret_cast<VadInstT*>(handle);
+    capture->model = *self;
+    int32_t downsampling_state[2] = {0, 0};
+    int32_t tmp_mem[480 + 256];
+    int16_t speech_32khz[320], speech_16khz[160];
+    int16_t speech_8khz[kFrameLength8khz];
+    int16_t features[kNumChannels];
+
+    for (size_t offset = 0; offset + 480 <= audio_48khz.size(); offset += 480) {
+        const int16_t* frame = &audio_48khz[offset];
+        capture->resample.push_back({vector<int16_t>(frame, frame + 480), 0});
+        WebRtcSpl_Resample48khzTo8khz(frame, speech_8khz, &self->state_48_to_8, tmp_mem);
+        // The 32 and 16 kHz paths, on the 48 kHz input without every third
+        // sample.
+        for (size_t i = 0; i < 320; i++) {
+            speech_32khz[i] = frame[i * 3 / 2];
+        }
+        capture->downsampling.push_back({vector<int16_t>(speech_32khz, speech_32khz + 320), 0});
+        WebRtcVad_Downsampling(speech_32khz, speech_16khz, downsampling_state, 320);
+        capture->downsampling.push_back({vector<int16_t>(speech_16khz, speech_16khz + 160), 0});
+
+        int16_t total_power = CaptureFeatures(self, speech_8khz, features, capture);
+        capture->features.insert(capture->features.end(), features, features + kNumChannels);
+        capture->total_power.push_back(total_power);
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            for (int k = 0; k < kNumGaussians; k++) {
+                int gaussian = channel + k * kNumChannels;
+                capture->gaussian.push_back({features[channel], self->noise_means[gaussian],
+                                             self->noise_stds[gaussian]});
+                capture->gaussian.push_back({features[channel], self->speech_means[gaussian],
+                                             self->speech_stds[gaussian]});
+            }
+        }
+        VadNoTrace trace;
+        self->vad = GmmProbabilityTraced<false>(self, features, total_power, kFrameLength8khz, trace);
+        capture->frames++;
+    }
+    WebRtcVad_Free(handle);
+    return true;
+}
+
+// Replays the calls of every kernel and returns the fastest of |repetitions|
+// replays of each.
+static vector<Measurement> Measure(const Capture& capture, int repetitions) {
+    vector<Measurement> measurements;
+    // Results are accumulated here so that the calls are not optimized out.
+    volatile int64_t sink = 0;
+    int16_t out[480];
+    int16_t out_lp[240];
+    int32_t tmp_mem[480 + 256];
+
+    // |reset| restores the state the calls start from, outside the timing.
+    auto measure = [&](const char* kernel, uint64_t calls, uint64_t samples, auto reset, auto replay) {
+        double best = 0;
+        for (int i = 0; i < repetitions; i++) {
+            reset();
+            uint64_t start = Ticks();
+            replay();
+            double ticks = (double)(Ticks() - start);
+            best = i == 0 || ticks < best ? ticks : best;
+        }
+        measurements.push_back({kernel, calls, samples, best});
+    };
+    auto samples_of = [](const vector<Signal>& signals) {
+        uint64_t samples = 0;
+        for (const Signal& signal : signals) {
+            samples += signal.data.size();
+        }
+        return samples;
+    };
+    auto stateless = [] {};
+
+    WebRtcSpl_State48khzTo8khz resample_state;
+    measure(
+        "WebRtcSpl_Resample48khzTo8khz", capture.resample.size(), samples_of(capture.resample),
+        [&] { WebRtcSpl_ResetResample48khzTo8khz(&resample_state); },
+        [&] {
+            for (const Signal& call : capture.resample) {
+                WebRtcSpl_Resample48khzTo8khz(call.data.data(), out, &resample_state, tmp_mem);
+                sink += out[0];
+            }
+        });
+    int32_t downsampling_state[2] = {0, 0};
+    measure("WebRtcVad_Downsampling", capture.downsampling.size(), samples_of(capture.downsampling), stateless, [&] {
+        for (const Signal& call : capture.downsampling) {
+            WebRtcVad_Downsampling(call.data.data(), out, downsampling_state, call.data.size());
+            sink += out[0];
+        }
+    });
+    int16_t upper_state[kNumChannels - 1] = {0};
+    int16_t lower_state[kNumChannels - 1] = {0};
+    measure("SplitFilter", capture.split.size(), samples_of(capture.split), stateless, [&] {
+        for (const Signal& call : capture.split) {
+            SplitFilter(call.data.data(), call.data.size(), &upper_state[call.band], &lower_state[call.band], out,
+                        out_lp);
+            sink += out[0] + out_lp[0];
+        }
+    });
+    // The upper branch of every split, which reads every other sample.
+    measure("AllPassFilter", capture.split.size(), samples_of(capture.split) / 2, stateless, [&] {
+        for (const Signal& call : capture.split) {
+            AllPassFilter(call.data.data(), call.data.size() / 2, kAllPassCoefsQ15[0], &upper_state[call.band], out);
+            sink += out[0];
+        }
+    });
+    int16_t hp_filter_state[4] = {0};
+    measure("HighPassFilter", capture.high_pass.size(), samples_of(capture.high_pass), stateless, [&] {
+        for (const Signal& call : capture.high_pass) {
+            HighPassFilter(call.data.data(), call.data.size(), hp_filter_state, out);
+            sink += out[0];
+        }
+    });
+    measure("LogOfEnergy", capture.energy.size(), samples_of(capture.energy), stateless, [&] {
+        for (const Signal& call : capture.energy) {
+            int16_t total_energy = 0;
+            int16_t log_energy;
+            LogOfEnergy(call.data.data(), call.data.size(), kOffsetVector[call.band], &total_energy, &log_energy);
+            sink += log_energy + total_energy;
+        }
+    });
+    measure("WebRtcSpl_Energy", capture.energy.size(), samples_of(capture.energy), stateless, [&] {
+        for (const Signal& call : capture.energy) {
+            int scale;
+            sink += WebRtcSpl_Energy(const_cast<int16_t*>(call.data.data()), call.data.size(), &scale) + scale;
+        }
+    });
+    measure("WebRtcVad_GaussianProbability", capture.gaussian.size(), capture.gaussian.size(), stateless, [&] {
+        int16_t delta;
+        for (const GaussianCall& call : capture.gaussian) {
+            sink += WebRtcVad_GaussianProbability(call.input, call.mean, call.std, &delta) + delta;
+        }
+    });
+    // The minimum tracker and the model adapt, so these replays start from the
+    // model the capture started from.
+    VadInstT model;
+    vector<int16_t> features;
+    measure(
+        "WebRtcVad_FindMinimum", capture.features.size(), capture.features.size(), [&] { model = capture.model; },
+        [&] {
+            for (size_t i = 0; i < capture.features.size(); i++) {
+                sink += WebRtcVad_FindMinimum(&model, capture.features[i], (int)(i % kNumChannels));
+            }
+        });
+    measure(
+        "GmmProbability", capture.frames, capture.frames * kFrameLength8khz,
+        [&] {
+            model = capture.model;
+            features = capture.features;
+        },
+        [&] {
+            VadNoTrace trace;
+            for (size_t frame = 0; frame < capture.frames; frame++) {
+                model.vad = GmmProbabilityTraced<false>(&model, &features[frame * kNumChannels],
+                                                        capture.total_power[frame], kFrameLength8khz, trace);
+                sink += model.vad;
+            }
+        });
+    return measurements;
+}
+
+static vector<string> Split(const char* list) {
+    vector<string> items;
+    string item;
+    for (const char* p = list;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0') {
+                return items;
+            }
+        } else {
+            item += *p;
+        }
+    }
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            options->repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            options->inputs = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options->wav_path = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    if (options->inputs.empty()) {
+        options->inputs.assign(begin(kInputs), end(kInputs));
+    }
+    for (const string& input : options->inputs) {
+        if (find(begin(kInputs), end(kInputs), input) == end(kInputs)) {
+            return false;
+        }
+    }
+    return options->repetitions > 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-r repetitions] [-i silence,noise,speech,clipped,recorded] [-w file.wav]\n"
+                "       [-o results.json]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE* file = stdout;
+    if (!options.output_path.empty()) {
+        file = fopen(options.output_path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "vad_kernels: cannot write %s\n", options.output_path.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    const char* unit = TickUnit();
+    double ticks_per_ns = TicksPerNanosecond();
+    fprintf(file,
+            "{\n  \"version\": 1,\n  \"compiler\": \"%s\",\n  \"unit\": \"%s\",\n  \"ticks_per_ns\": %.3f,\n"
+            "  \"repetitions\": %d,\n  \"results\": [\n",
+            __VERSION__, unit, ticks_per_ns, options.repetitions);
+    fprintf(stderr, "%-30s %-9s %12s %12s %12s  (%s, %.3f per ns)\n", "kernel", "input", "per sample", "per call",
+            "per frame", unit, ticks_per_ns);
+    bool first = true;
+    bool ok = true;
+    for (const string& input : options.inputs) {
+        vector<int16_t> audio = input == "recorded" ? bench::LoadRecorded(options.wav_path, 48000, kInputSeconds)
+                                                    : bench::Synthesize(input, 48000, kInputSeconds);
+        Capture capture;
+        if (audio.empty() || !CaptureInput(audio, &capture)) {
+            fprintf(stderr, "vad_kernels: cannot capture %s, skipping it\n", input.c_str());
+            ok = false;
+            continue;
+        }
+        for (const Measurement& m : Measure(capture, options.repetitions)) {
+            double per_sample = m.samples > 0 ? m.ticks / m.samples : 0;
+            double per_call = m.calls > 0 ? m.ticks / m.calls : 0;
+            double per_frame = m.ticks / capture.frames;
+            fprintf(stderr, "%-30s %-9s %12.2f %12.1f %12.1f\n", m.kernel, input.c_str(), per_sample, per_call,
+                    per_frame);
+            fprintf(file,
+                    "%s    {\"kernel\": \"%s\", \"input\": \"%s\", \"calls\": %llu, \"samples\": %llu, "
+                    "\"cycles_per_sample\": %.3f, \"cycles_per_call\": %.2f, \"cycles_per_frame\": %.1f}",
+                    first ? "" : ",\n", m.kernel, input.c_str(), (unsigned long long)m.calls,
+                    (unsigned long long)m.samples, per_sample, per_call, per_frame);
+            first = false;
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+    ok = fflush(file) == 0 && (file == stdout || fclose(file) == 0) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,254 @@
+// vad_wcet: worst-case time per frame of the VAD, for every sample rate and
+// frame length.
+//
+//   vad_wcet [-r repetitions] [-i inputs] [-w file.wav] [-o results.json]
+//
+// Every input (silence, noise, speech, clipped and recorded, see
+// bench_signals.hpp) is run at every rate and frame length in every mode, and
+// every frame is processed |repetitions| times (7 by default) from the same
+// state, restored outside the timing, in separate passes over the input,
+// keeping the fastest. That removes interrupts and the other noise of the
+// machine and leaves the cost that depends on the data. The instance and the
+// frame are in cache, so the bound is for warm caches; a cold start adds the
+// refill of the instance (about 1 kB) and of the frame.
+//
+// Reported per (rate, frame_ms), over all frames of all inputs and modes, as
+// JSON (stdout unless -o) and as a table on stderr:
+//   min, p50, p99, max - time of one frame,
+//   max_input          - the input of the slowest frame,
+//   spread             - max / min.
+// Times are TSC ticks, i.e., cycles at the nominal frequency, also reported;
+// on other than x86 the unit is nanoseconds.
+//
+// Built with -DWEBRTC_VAD_WCET (make wcet builds and runs both), the VAD runs
+// the same path for every frame, see kVadBoundedTime in vad_core.hpp, and
+// the spread shrinks to what is left: the speech and noise updates of the
+// model and the remaining short branches.
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_signals.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const char* const kInputs[] = {"silence", "noise", "speech", "clipped", "recorded"};
+static const int kRates[] = {8000, 16000, 32000, 48000};
+static const int kFrameMs[] = {10, 20, 30};
+static const int kInputSeconds = 10;
+
+struct Options {
+    int repetitions = 7;
+    vector<string> inputs;
+    string wav_path = "../examples/wave_data/wave_1.wav";
+    string output_path;
+};
+
+struct Result {
+    int rate;
+    int frame_ms;
+    vector<double> ticks;
+    double max = 0;
+    string max_input;
+};
+
+static inline uint64_t Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+#else
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+static const char* TickUnit() {
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
+}
+
+// Ticks per nanosecond, measured against the steady clock.
+static double TicksPerNanosecond() {
+    auto start = chrono::steady_clock::now();
+    uint64_t ticks = Ticks();
+    this_thread::sleep_for(chrono::milliseconds(50));
+    uint64_t elapsed_ticks = Ticks() - ticks;
+    return elapsed_ticks / (double)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start)
+                               .count();
+}
+
+// Times every frame of |audio| in |mode|, adding the fastest of |repetitions|
+// runs of each to |result|. The state before every frame is recorded in a
+// first pass, and the repetitions are separate passes over all frames, so a
+// burst of noise on the machine only hits one run of a frame.
+static bool Measure(const vector<int16_t>& audio, const string& input, int mode, int repetitions, Result* result) {
+    VadInst* handle = WebRtcVad_Create();
+    if (handle == nullptr || WebRtcVad_Init(handle) != 0 || WebRtcVad_set_mode(handle, mode) != 0) {
+        WebRtcVad_Free(handle);
+        return false;
+    }
+    VadInstT* self = reinterpret_cast<VadInstT*>(handle);
+    const size_t frame_length = (size_t)result->rate / 1000 * result->frame_ms;
+    const size_t num_frames = audio.size() / frame_length;
+    bool ok = true;
+    vector<VadInstT> states(num_frames);
+    for (size_t i = 0; i < num_frames; i++) {
+        states[i] = *self;
+        ok = WebRtcVad_Process(handle, result->rate, &audio[i * frame_length], frame_length) >= 0 && ok;
+    }
+    vector<double> best(num_frames);
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        for (size_t i = 0; i < num_frames; i++) {
+            *self = states[i];
+            uint64_t start = Ticks();
+            WebRtcVad_Process(handle, result->rate, &audio[i * frame_length], frame_length);
+            double ticks = (double)(Ticks() - start);
+            best[i] = repetition == 0 || ticks < best[i] ? ticks : best[i];
+        }
+    }
+    for (double ticks : best) {
+        result->ticks.push_back(ticks);
+        if (ticks > result->max) {
+            result->max = ticks;
+            result->max_input = input;
+        }
+    }
+    WebRtcVad_Free(handle);
+    return ok;
+}
+
+static double Percentile(vector<double> values, double p) {
+    size_t index = min(values.size() - 1, (size_t)(p * values.size()));
+    nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static vector<string> Split(const char* list) {
+    vector<string> items;
+    string item;
+    for (const char* p = list;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0') {
+                return items;
+            }
+        } else {
+            item += *p;
+        }
+    }
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            options->repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            options->inputs = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options->wav_path = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    if (options->inputs.empty()) {
+        options->inputs.assign(begin(kInputs), end(kInputs));
+    }
+    for (const string& input : options->inputs) {
+        if (find(begin(kInputs), end(kInputs), input) == end(kInputs)) {
+            return false;
+        }
+    }
+    return options->repetitions > 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-r repetitions] [-i silence,noise,speech,clipped,recorded] [-w file.wav]\n"
+                "       [-o results.json]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE* file = stdout;
+    if (!options.output_path.empty()) {
+        file = fopen(options.output_path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "vad_wcet: cannot write %s\n", options.output_path.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifdef WEBRTC_VAD_WCET
+    const char* build = "wcet";
+#else
+    const char* build = "default";
+#endif
+    const char* unit = TickUnit();
+    double ticks_per_ns = TicksPerNanosecond();
+    fprintf(file,
+            "{\n  \"version\": 1,\n  \"compiler\": \"%s\",\n  \"build\": \"%s\",\n  \"unit\": \"%s\",\n"
+            "  \"ticks_per_ns\": %.3f,\n  \"repetitions\": %d,\n  \"results\": [\n",
+            __VERSION__, build, unit, ticks_per_ns, options.repetitions);
+    fprintf(stderr, "%s build\n%-6s %-5s %9s %9s %9s %9s %-9s %7s  (%s, %.3f per ns)\n", build, "rate", "ms", "min",
+            "p50", "p99", "max", "input", "spread", unit, ticks_per_ns);
+    bool first = true;
+    bool ok = true;
+    for (int rate : kRates) {
+        vector<vector<int16_t>> inputs;
+        for (const string& input : options.inputs) {
+            inputs.push_back(input == "recorded" ? bench::LoadRecorded(options.wav_path, rate, kInputSeconds)
+                                                 : bench::Synthesize(input, rate, kInputSeconds));
+            if (inputs.back().empty()) {
+                fprintf(stderr, "vad_wcet: cannot load %s, skipping it\n", input.c_str());
+                ok = false;
+            }
+        }
+        for (int frame_ms : kFrameMs) {
+            Result result = {rate, frame_ms, {}, 0, ""};
+            for (size_t i = 0; i < inputs.size(); i++) {
+                for (int mode = 0; mode < 4; mode++) {
+                    ok = Measure(inputs[i], options.inputs[i], mode, options.repetitions, &result) && ok;
+                }
+            }
+            if (result.ticks.empty()) {
+                continue;
+            }
+            double min_ticks = *min_element(result.ticks.begin(), result.ticks.end());
+            double p50 = Percentile(result.ticks, 0.5);
+            double p99 = Percentile(result.ticks, 0.99);
+            double spread = min_ticks > 0 ? result.max / min_ticks : 0;
+            fprintf(stderr, "%-6d %-5d %9.0f %9.0f %9.0f %9.0f %-9s %7.2f\n", rate, frame_ms, min_ticks, p50, p99,
+                    result.max, result.max_input.c_str(), spread);
+            fprintf(file,
+                    "%s    {\"rate\": %d, \"frame_ms\": %d, \"frames\": %zu, \"min\": %.0f, \"p50\": %.0f, "
+                    "\"p99\": %.0f, \"max\": %.0f, \"max_input\": \"%s\", \"spread\": %.3f}",
+                    first ? "" : ",\n", rate, frame_ms, result.ticks.size(), min_ticks, p50, p99, result.max,
+                    result.max_input.c_str(), spread);
+            first = false;
+        }
+    }
+    fprintf(file, "\n  ]\n}\n");
+    ok = fflush(file) == 0 && (file == stdout || fclose(file) == 0) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,118 @@
+#include <coroutine>
+#include <deque>
+#include <iostream>
+#include <span>
+#include <vector>
+
+#include "webrtc/vad/vad_coro.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+// Chunks of audio arriving for one stream, e.g., from the network. Read()
+// completes immediately while chunks are queued and suspends otherwise, until
+// the event loop delivers the next chunk.
+class ChunkSource {
+public:
+    struct ReadAwaiter {
+        ChunkSource* source;
+
+        bool await_ready() { return !source->chunks_.empty() || source->closed_; }
+        void await_suspend(coroutine_handle<> reader) { source->reader_ = reader; }
+        span<const int16_t> await_resume() {
+            if (source->chunks_.empty()) {
+                return {};
+            }
+            source->current_ = move(source->chunks_.front());
+            source->chunks_.pop_front();
+            return source->current_;
+        }
+    };
+
+    ReadAwaiter Read() { return ReadAwaiter{this}; }
+
+    void Deliver(vector<int16_t> chunk) {
+        chunks_.push_back(move(chunk));
+        Wake();
+    }
+
+    void Close() {
+        closed_ = true;
+        Wake();
+    }
+
+private:
+    void Wake() {
+        if (reader_) {
+            exchange(reader_, nullptr).resume();
+        }
+    }
+
+    deque<vector<int16_t>> chunks_;
+    vector<int16_t> current_;
+    coroutine_handle<> reader_;
+    bool closed_ = false;
+};
+
+// Fire-and-forget coroutine, started eagerly.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+Detached PrintSegments(Vad& vad, ChunkSource& source, size_t stream) {
+    auto segments = VadSegments(vad, source, 16000, 160);
+    while (const span<const VadSegmentEvent>* batch = co_await segments.Next()) {
+        for (const VadSegmentEvent& event : *batch) {
+            if (stream == 0) {
+                printf("%s at %.2f s\n", event.type == VadSegmentEvent::kSpeechStart ? "speech" : "silence",
+                       event.frame * 0.01);
+            }
+        }
+    }
+}
+
+int main() {
+    string file_path = "wave_data/wave_1.wav";
+    const size_t kNumStreams = 100;
+    FILE* f;
+    int16_t buf[800];
+    size_t nread;
+
+    f = fopen(file_path.c_str(), "rb");
+    if (f == nullptr) {
+        printf("open %s failed", file_path.c_str());
+        return EXIT_FAILURE;
+    }
+    fseek(f, 44, SEEK_SET);
+
+    vector<unique_ptr<Vad>> vads;
+    vector<unique_ptr<ChunkSource>> sources;
+    for (size_t s = 0; s < kNumStreams; s++) {
+        vads.emplace_back(new Vad(Vad::kVadAggressive));
+        if (!vads.back()->Init()) {
+            return EXIT_FAILURE;
+        }
+        sources.emplace_back(new ChunkSource());
+        PrintSegments(*vads[s], *sources[s], s);
+    }
+
+    // A single-threaded event loop delivering 50 ms bursts, which are not
+    // aligned with the 10 ms frames, to every stream in turn.
+    while ((nread = fread(buf, sizeof(int16_t), 800, f)) > 0) {
+        for (size_t s = 0; s < kNumStreams; s++) {
+            sources[s]->Deliver(vector<int16_t>(buf, buf + nread));
+        }
+    }
+    for (size_t s = 0; s < kNumStreams; s++) {
+        sources[s]->Close();
+    }
+    fclose(f);
+    return EXIT_SUCCESS;
+}
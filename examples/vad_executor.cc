@@ -0,0 +1,75 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "webrtc/vad/vad_executor.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+int main() {
+    string file_path = "wave_data/wave_1.wav";
+    const size_t kNumStreams = 64;
+    const size_t kFrameLength = 160;
+    FILE* f;
+    vector<int16_t> audio;
+    int16_t buf[kFrameLength];
+
+    f = fopen(file_path.c_str(), "rb");
+    if (f == nullptr) {
+        printf("open %s failed", file_path.c_str());
+        return EXIT_FAILURE;
+    }
+    fseek(f, 44, SEEK_SET);
+    while (fread(buf, sizeof(int16_t), kFrameLength, f) == kFrameLength) {
+        audio.insert(audio.end(), buf, buf + kFrameLength);
+    }
+    fclose(f);
+    size_t num_frames = audio.size() / kFrameLength;
+
+    // Reference decisions of a single stream processed serially.
+    vector<int> expected;
+    Vad vad(Vad::kVadAggressive);
+    if (!vad.Init()) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < num_frames; i++) {
+        expected.push_back(vad.IsSpeech(&audio[i * kFrameLength], kFrameLength, 16000));
+    }
+
+    // Every stream gets the same audio, with stream |s| starting |s| frames
+    // later, interleaved frame by frame as a media server would.
+    vector<vector<int>> decisions(kNumStreams, vector<int>(num_frames, Vad::kError));
+    size_t mismatches = 0;
+    auto start = chrono::steady_clock::now();
+    {
+        VadExecutor executor(thread::hardware_concurrency());
+        vector<VadExecutor::Stream*> streams;
+        for (size_t s = 0; s < kNumStreams; s++) {
+            streams.push_back(executor.AddStream(Vad::kVadAggressive, 16000,
+                                                 [&decisions, s](uint64_t sequence, Vad::Activity activity) {
+                                                     decisions[s][sequence] = activity;
+                                                 }));
+        }
+        for (size_t i = 0; i < num_frames + kNumStreams; i++) {
+            for (size_t s = 0; s < kNumStreams; s++) {
+                if (i >= s && i - s < num_frames) {
+                    executor.Submit(streams[s], &audio[(i - s) * kFrameLength], kFrameLength);
+                }
+            }
+        }
+        executor.Drain();
+        printf("workers: %zu\n", executor.num_workers());
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    for (size_t s = 0; s < kNumStreams; s++) {
+        for (size_t i = 0; i < num_frames; i++) {
+            mismatches += decisions[s][i] != expected[i];
+        }
+    }
+    printf("frames: %zu, mismatches: %zu, %.0f frames/s\n", kNumStreams * num_frames, mismatches,
+           kNumStreams * num_frames / seconds);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
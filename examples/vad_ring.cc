@@ -0,0 +1,80 @@
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "webrtc/vad/vad_ring.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+int main() {
+    string file_path = "wave_data/wave_1.wav";
+    FILE* f;
+    char buf[320];
+    atomic<bool> capture_done(false);
+    atomic<bool> vad_done(false);
+    atomic<bool> failed(false);
+
+    unique_ptr<VadRingProcessor<64, 160>> processor(new VadRingProcessor<64, 160>(Vad::kVadAggressive, 16000));
+    if (!processor->Init()) {
+        return EXIT_FAILURE;
+    }
+
+    f = fopen(file_path.c_str(), "rb");
+    if (f == nullptr) {
+        printf("open %s failed", file_path.c_str());
+        return EXIT_FAILURE;
+    }
+    fseek(f, 44, SEEK_SET);
+
+    // Stands in for the audio callback: fills ring slots in place. A real
+    // callback would drop the frame instead of yielding when the ring is full.
+    thread capture([&] {
+        while (!failed && fread(buf, 1, sizeof(buf), f) == sizeof(buf)) {
+            int16_t* samples;
+            while ((samples = processor->BeginFrame()) == nullptr && !failed) {
+                this_thread::yield();
+            }
+            if (samples == nullptr) {
+                break;
+            }
+            memcpy(samples, buf, sizeof(buf));
+            processor->PublishFrame(160);
+        }
+        capture_done = true;
+    });
+
+    thread vad([&] {
+        // Poll() stops at a full decision ring, so keep polling until the
+        // frames published before |capture_done| are all processed.
+        while (!failed && (!capture_done || processor->HasFrames())) {
+            if (processor->Poll() == 0) {
+                this_thread::yield();
+            }
+        }
+        vad_done = true;
+    });
+
+    VadDecision decision;
+    while (!failed) {
+        bool done = vad_done;
+        while (processor->decisions().TryPop(&decision)) {
+            if (decision.activity == Vad::kError) {
+                printf("vad process failed");
+                failed = true;
+                break;
+            }
+            printf("%d", decision.activity > 0 ? 1 : 0);
+        }
+        if (done) {
+            break;
+        }
+        this_thread::yield();
+    }
+    printf("\n");
+    capture.join();
+    vad.join();
+    fclose(f);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
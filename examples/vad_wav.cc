@@ -0,0 +1,34 @@
+#include <string>
+
+#include "webrtc/common_audio/wav_reader.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+int main(int argc, char** argv) {
+    string file_path = argc > 1 ? argv[1] : "wave_data/wave_1.wav";
+    WavReader reader;
+    if (!reader.Open(file_path.c_str())) {
+        return EXIT_FAILURE;
+    }
+
+    Vad vad(Vad::kVadAggressive);
+    if (!vad.Init()) {
+        return EXIT_FAILURE;
+    }
+
+    // 10 ms frames, read in place for mono 16-bit files.
+    const int sample_rate = reader.sample_rate();
+    const size_t frame_length = sample_rate / 100;
+    int16_t buffer[480];
+    for (size_t i = 0; i + frame_length <= reader.num_samples(); i += frame_length) {
+        int ret = vad.IsSpeech(reader.GetFrame(i, frame_length, buffer), frame_length, sample_rate);
+        if (ret == Vad::kError) {
+            printf("vad process failed");
+            break;
+        }
+        printf("%d", ret > 0 ? 1 : 0);
+    }
+    printf("\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,264 @@
+#ifndef WEBRTC_COMMON_AUDIO_WAV_READER_HPP
+#define WEBRTC_COMMON_AUDIO_WAV_READER_HPP
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "webrtc/g711/g711.hpp"
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+// Memory-mapped reader of WAVE files for the VAD.
+//
+// Open() maps the file, walks its RIFF chunks for "fmt " and "data" (skipping
+// LIST, fact and any other chunk) and checks that the sample rate is one
+// WebRtcVad_Process() supports. Integer PCM of 8 to 32 bits, 32-bit float,
+// A-law and u-law, plain or WAVE_FORMAT_EXTENSIBLE, with any number of
+// channels are understood.
+//
+// Mono 16-bit PCM, the common case, is read in place: samples() points into
+// the mapping and GetFrame() returns pointers into it, without a copy. Other
+// formats are converted to mono 16-bit frame by frame in GetFrame().
+//
+//   WavReader reader;
+//   if (!reader.Open("speech.wav")) { ... }
+//   int16_t buffer[480];
+//   size_t frame_length = reader.sample_rate() / 100;
+//   for (size_t i = 0; i + frame_length <= reader.num_samples(); i += frame_length) {
+//       vad.IsSpeech(reader.GetFrame(i, frame_length, buffer), frame_length, reader.sample_rate());
+//   }
+class WavReader {
+public:
+    enum Format { kPcm, kFloat, kAlaw, kMulaw };
+
+    WavReader()
+        : mapping_(nullptr),
+          mapping_size_(0),
+          data_(nullptr),
+          num_samples_(0),
+          format_(kPcm),
+          sample_rate_(0),
+          num_channels_(0),
+          bytes_per_sample_(0) {}
+
+    WavReader(const WavReader&) = delete;
+    WavReader& operator=(const WavReader&) = delete;
+
+    ~WavReader() { Close(); }
+
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "Open %s failed.\n", path);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 12) {
+            fprintf(stderr, "Read %s failed.\n", path);
+            close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            fprintf(stderr, "Map %s failed.\n", path);
+            return false;
+        }
+        mapping_ = static_cast<const uint8_t*>(mapping);
+        mapping_size_ = (size_t)st.st_size;
+        madvise(mapping, mapping_size_, MADV_SEQUENTIAL);
+
+        if (!ParseChunks()) {
+            fprintf(stderr, "%s is not a supported WAVE file.\n", path);
+            Close();
+            return false;
+        }
+        if (WebRtcVad_ValidRateAndFrameLength(sample_rate_, (size_t)(sample_rate_ / 100)) != 0) {
+            fprintf(stderr, "Sample rate %d Hz of %s is not supported by the VAD.\n", sample_rate_, path);
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (mapping_ != nullptr) {
+            munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+        }
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+        data_ = nullptr;
+        num_samples_ = 0;
+    }
+
+    int sample_rate() const { return sample_rate_; }
+    int num_channels() const { return num_channels_; }
+    Format format() const { return format_; }
+    int bits_per_sample() const { return bytes_per_sample_ * 8; }
+
+    // Number of samples per channel.
+    size_t num_samples() const { return num_samples_; }
+
+    // The samples in place, if the file is mono 16-bit PCM, or nullptr.
+    const int16_t* samples() const { return IsInPlace() ? reinterpret_cast<const int16_t*>(data_) : nullptr; }
+
+    // Returns |length| mono 16-bit samples starting at sample |offset|, which
+    // must lie within the file. Points into the mapping for mono 16-bit PCM;
+    // otherwise the samples are converted, channels averaged, into |buffer|,
+    // which must hold |length| samples, and |buffer| is returned.
+    const int16_t* GetFrame(size_t offset, size_t length, int16_t* buffer) const {
+        if (IsInPlace()) {
+            return reinterpret_cast<const int16_t*>(data_) + offset;
+        }
+        const size_t frame_size = (size_t)bytes_per_sample_ * num_channels_;
+        const uint8_t* p = data_ + offset * frame_size;
+        for (size_t i = 0; i < length; i++) {
+            int32_t sum = 0;
+            for (int c = 0; c < num_channels_; c++) {
+                sum += DecodeSample(p);
+                p += bytes_per_sample_;
+            }
+            buffer[i] = (int16_t)(sum / num_channels_);
+        }
+        return buffer;
+    }
+
+private:
+    static const uint16_t kFormatPcm = 1;
+    static const uint16_t kFormatFloat = 3;
+    static const uint16_t kFormatAlaw = 6;
+    static const uint16_t kFormatMulaw = 7;
+    static const uint16_t kFormatExtensible = 0xFFFE;
+
+    static uint16_t ReadLe16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+    static uint32_t ReadLe32(const uint8_t* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    bool IsInPlace() const {
+        return format_ == kPcm && bytes_per_sample_ == 2 && num_channels_ == 1 &&
+               ((uintptr_t)data_ & (sizeof(int16_t) - 1)) == 0;
+    }
+
+    // Walks the RIFF chunks for "fmt " and "data". A data chunk that claims to
+    // extend past the end of the file, as left by interrupted recordings, is
+    // truncated to the file.
+    bool ParseChunks() {
+        const uint8_t* end = mapping_ + mapping_size_;
+        if (memcmp(mapping_, "RIFF", 4) != 0 || memcmp(mapping_ + 8, "WAVE", 4) != 0) {
+            return false;
+        }
+        bool have_format = false;
+        const uint8_t* p = mapping_ + 12;
+        while (end - p >= 8) {
+            const uint8_t* chunk = p + 8;
+            size_t chunk_size = ReadLe32(p + 4);
+            size_t available = (size_t)(end - chunk);
+            if (memcmp(p, "fmt ", 4) == 0) {
+                if (chunk_size > available || !ParseFormat(chunk, chunk_size)) {
+                    return false;
+                }
+                have_format = true;
+            } else if (memcmp(p, "data", 4) == 0) {
+                if (!have_format) {
+                    return false;
+                }
+                data_ = chunk;
+                num_samples_ = (chunk_size < available ? chunk_size : available) /
+                               ((size_t)bytes_per_sample_ * num_channels_);
+                return true;
+            }
+            if (chunk_size > available) {
+                return false;
+            }
+            // Chunks are padded to an even size.
+            p = chunk + chunk_size + (chunk_size & 1);
+        }
+        return false;
+    }
+
+    bool ParseFormat(const uint8_t* chunk, size_t size) {
+        if (size < 16) {
+            return false;
+        }
+        uint16_t format_tag = ReadLe16(chunk);
+        num_channels_ = ReadLe16(chunk + 2);
+        sample_rate_ = (int)ReadLe32(chunk + 4);
+        uint16_t block_align = ReadLe16(chunk + 12);
+        uint16_t bits_per_sample = ReadLe16(chunk + 14);
+        if (format_tag == kFormatExtensible) {
+            // The format tag is the start of the sub-format GUID.
+            if (size < 40) {
+                return false;
+            }
+            format_tag = ReadLe16(chunk + 24);
+        }
+
+        bytes_per_sample_ = bits_per_sample / 8;
+        if (num_channels_ == 0 || bits_per_sample % 8 != 0 || block_align != bytes_per_sample_ * num_channels_) {
+            return false;
+        }
+        switch (format_tag) {
+            case kFormatPcm:
+                format_ = kPcm;
+                return bytes_per_sample_ >= 1 && bytes_per_sample_ <= 4;
+            case kFormatFloat:
+                format_ = kFloat;
+                return bytes_per_sample_ == 4;
+            case kFormatAlaw:
+                format_ = kAlaw;
+                return bytes_per_sample_ == 1;
+            case kFormatMulaw:
+                format_ = kMulaw;
+                return bytes_per_sample_ == 1;
+            default:
+                return false;
+        }
+    }
+
+    // Returns the sample at |p| as 16-bit PCM.
+    int16_t DecodeSample(const uint8_t* p) const {
+        switch (format_) {
+            case kAlaw:
+                return AlawToLinear(*p);
+            case kMulaw:
+                return UlawToLinear(*p);
+            case kFloat: {
+                float value;
+                memcpy(&value, p, sizeof(value));
+                value *= 32768.0f;
+                if (value >= 32767.0f) {
+                    return 32767;
+                }
+                if (value <= -32768.0f) {
+                    return -32768;
+                }
+                return value == value ? (int16_t)value : 0;
+            }
+            default:
+                // Integer PCM; 8-bit samples are unsigned, wider ones signed and
+                // truncated to their 16 most significant bits.
+                if (bytes_per_sample_ == 1) {
+                    return (int16_t)((*p - 128) << 8);
+                }
+                return (int16_t)ReadLe16(p + bytes_per_sample_ - 2);
+        }
+    }
+
+    const uint8_t* mapping_;
+    size_t mapping_size_;
+    const uint8_t* data_;
+    size_t num_samples_;
+    Format format_;
+    int sample_rate_;
+    int num_channels_;
+    int bytes_per_sample_;
+};
+}  // namespace webrtc
+#endif
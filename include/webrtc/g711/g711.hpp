@@ -0,0 +1,84 @@
+#ifndef WEBRTC_G711_G711_HPP
+#define WEBRTC_G711_G711_HPP
+#include <stddef.h>
+#include <stdint.h>
+
+// G.711 A-law and u-law decoding, as used by RTP payload types 8 (PCMA) and
+// 0 (PCMU) and by WAVE files of format 6 and 7.
+namespace webrtc {
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Decodes |len| A-law encoded bytes.
+//
+// - encoded [i] : A-law encoded data.
+// - len     [i] : Number of bytes in |encoded|.
+// - decoded [o] : Decoded samples, |len| of them.
+//
+// returns       : Number of samples in |decoded|.
+size_t WebRtcG711_DecodeA(const uint8_t* encoded, size_t len, int16_t* decoded);
+
+// Decodes |len| u-law encoded bytes.
+//
+// - encoded [i] : u-law encoded data.
+// - len     [i] : Number of bytes in |encoded|.
+// - decoded [o] : Decoded samples, |len| of them.
+//
+// returns       : Number of samples in |decoded|.
+size_t WebRtcG711_DecodeU(const uint8_t* encoded, size_t len, int16_t* decoded);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Even bits of A-law bytes are inverted on the line.
+static const uint8_t kG711AlawAmiMask = 0x55;
+static const int kG711UlawBias = 0x84;
+
+// Returns the linear value of an A-law byte.
+static inline int16_t AlawToLinear(uint8_t alaw) {
+    int i;
+    int seg;
+
+    alaw ^= kG711AlawAmiMask;
+    i = ((alaw & 0x0F) << 4);
+    seg = (((int)alaw & 0x70) >> 4);
+    if (seg) {
+        i = (i + 0x108) << (seg - 1);
+    } else {
+        i += 8;
+    }
+    return (int16_t)((alaw & 0x80) ? i : -i);
+}
+
+// Returns the linear value of a u-law byte.
+static inline int16_t UlawToLinear(uint8_t ulaw) {
+    int t;
+
+    // Complement to obtain normal u-law value.
+    ulaw = ~ulaw;
+    // Extract and bias the quantization bits. Then shift up by the segment
+    // number and subtract out the bias.
+    t = (((ulaw & 0x0F) << 3) + kG711UlawBias) << (((int)ulaw & 0x70) >> 4);
+    return (int16_t)((ulaw & 0x80) ? (kG711UlawBias - t) : (t - kG711UlawBias));
+}
+
+inline size_t WebRtcG711_DecodeA(const uint8_t* encoded, size_t len, int16_t* decoded) {
+    size_t n;
+    for (n = 0; n < len; n++) {
+        decoded[n] = AlawToLinear(encoded[n]);
+    }
+    return len;
+}
+
+inline size_t WebRtcG711_DecodeU(const uint8_t* encoded, size_t len, int16_t* decoded) {
+    size_t n;
+    for (n = 0; n < len; n++) {
+        decoded[n] = UlawToLinear(encoded[n]);
+    }
+    return len;
+}
+}  // namespace webrtc
+#endif
@@ -19,6 +19,7 @@ int16_t WebRtcSpl_GetScalingSquare(int16_t* in_vector, size_t in_vector_length,
 // Divisions. Implementations collected in division_operations.c and
 // descriptions at bottom of this file.
 int32_t WebRtcSpl_DivW32W16(int32_t num, int16_t den);
+int32_t WebRtcSpl_DivW32W16FixedLatency(int32_t num, int16_t den);
 // End: Divisions.
 
 int32_t WebRtcSpl_Energy(int16_t* vector, size_t vector_length, int* scale_factor);
@@ -73,6 +74,44 @@ inline int32_t WebRtcSpl_DivW32W16(int32_t num, int16_t den) {
     }
 }
 
+// Same result as WebRtcSpl_DivW32W16(), from a reciprocal of |den| refined
+// by a fixed number of Newton-Raphson iterations, without branches. It
+// executes the same instructions for every input, unlike hardware dividers
+// that terminate early on small operands.
+//
+// |den| is normalized to D in [0.5, 1) and 1 / D is seeded with the linear
+// approximation 48 / 17 - 32 / 17 * D, good to 4 bits, and refined to 30
+// bits by three iterations in Q30. The quotient it gives is the true one or
+// one less, which one step on the remainder corrects; checked for every
+// |den| with the largest |num|.
+inline int32_t WebRtcSpl_DivW32W16FixedLatency(int32_t num, int16_t den) {
+    // All ones for negative operands.
+    const uint32_t num_sign = (uint32_t)(num >> 31);
+    const uint32_t den_sign = (uint32_t)(den >> 15);
+    const uint32_t n = ((uint32_t)num ^ num_sign) - num_sign;
+    uint32_t d = ((uint32_t)(int32_t)den ^ den_sign) - den_sign;
+    const uint32_t zero = 0 - (uint32_t)(d == 0);
+    d |= zero & 1;
+
+    // |d| <= 2^15, so |shifts| >= 16 and |dn| = D in Q16.
+    const int shifts = WebRtcSpl_CountLeadingZeros32(d);
+    const uint64_t dn = (uint64_t)d << (shifts - 16);
+    uint64_t x = 3031741620u - ((2021161081u * dn) >> 16);  // Q30
+    int i;
+    for (i = 0; i < 3; i++) {
+        // x * (2 - D * x), with 2 - D * x in Q46 and then Q31.
+        const uint64_t e = ((uint64_t)1 << 47) - dn * x;
+        x = (x * (e >> 15)) >> 31;
+    }
+    uint32_t q = (uint32_t)(((uint64_t)n * x) >> (62 - shifts));
+    const uint32_t short_by_one = 0 - (uint32_t)(n - q * d >= d);
+    q += short_by_one & 1;
+
+    q = (q ^ (num_sign ^ den_sign)) - (num_sign ^ den_sign);
+    // Guard against division with 0
+    return (int32_t)((q & ~zero) | (0x7FFFFFFF & zero));
+}
+
 inline int32_t WebRtcSpl_Energy(int16_t* vector, size_t vector_length, int* scale_factor) {
     int32_t en = 0;
     size_t i;
@@ -1,8 +1,15 @@
 #ifndef WEBRTC_VAD_VAD_HPP
 #define WEBRTC_VAD_VAD_HPP
+#include <stdio.h>
+
 #include <exception>
 #include <memory>
+#include <vector>
 
+#include "webrtc/vad/vad_activity.hpp"
+#include "webrtc/vad/vad_analysis.hpp"
+#include "webrtc/vad/vad_model_profile.hpp"
+#include "webrtc/vad/vad_state.hpp"
 #include "webrtc/vad/webrtc_vad.hpp"
 
 namespace webrtc {
@@ -11,18 +18,25 @@ public:
     enum Aggressiveness { kVadNormal = 0, kVadLowBitrate = 1, kVadAggressive = 2, kVadVeryAggressive = 3 };
 
     enum Activity { kPassive = 0, kActive = 1, kError = -1 };
-    explicit Vad(Aggressiveness aggressiveness) : handle_(nullptr), aggressiveness_(aggressiveness) {}
+    explicit Vad(Aggressiveness aggressiveness) : handle_(nullptr), aggressiveness_(aggressiveness), frame_ms_(0) {}
 
     Activity IsSpeech(const int16_t* audio, size_t num_samples, int sample_rate_hz) {
-        int ret = WebRtcVad_Process(handle_, sample_rate_hz, audio, num_samples);
-        switch (ret) {
-            case 0:
-                return kPassive;
-            case 1:
-                return kActive;
-            default:
-                return kError;
-        }
+        return Track(WebRtcVad_Process(handle_, sample_rate_hz, audio, num_samples), num_samples, sample_rate_hz);
+    }
+
+    // Like IsSpeech(), and also returns the features and the likelihood ratio
+    // behind the decision in |analysis|, see WebRtcVad_ProcessWithAnalysis().
+    Activity IsSpeech(const int16_t* audio, size_t num_samples, int sample_rate_hz, VadFrameAnalysis* analysis) {
+        return Track(WebRtcVad_ProcessWithAnalysis(handle_, sample_rate_hz, audio, num_samples, analysis), num_samples,
+                     sample_rate_hz);
+    }
+
+    // Like IsSpeech(), and also calls the hooks of the trace policy |trace|,
+    // see WebRtcVad_ProcessTraced().
+    template <typename Trace>
+    Activity IsSpeech(const int16_t* audio, size_t num_samples, int sample_rate_hz, Trace& trace) {
+        return Track(WebRtcVad_ProcessTraced(handle_, sample_rate_hz, audio, num_samples, trace), num_samples,
+                     sample_rate_hz);
     }
 
     bool Init() {
@@ -42,11 +56,158 @@ public:
         return true;
     }
 
+    // Like Init(), but starts from an adapted model, see
+    // WebRtcVad_InitWithProfile().
+    bool Init(const VadModelProfile& profile) {
+        Reset();
+        if (handle_ == nullptr) {
+            printf("Create vad handle failed.\n");
+            return false;
+        }
+        if (WebRtcVad_InitWithProfile(handle_, &profile) == -1) {
+            printf("Init vad handle failed.\n");
+            return false;
+        }
+        if (WebRtcVad_set_mode(handle_, aggressiveness_) == -1) {
+            printf("Set vad mode failed.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Enables or disables the cascade pre-screen, see
+    // WebRtcVad_set_cascade(). Init() turns it off again.
+    bool SetCascade(bool enable) {
+        if (WebRtcVad_set_cascade(handle_, enable ? 1 : 0) == -1) {
+            printf("Set vad cascade failed.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Enables or disables the lite mode, see WebRtcVad_set_lite(). The model
+    // starts over; Init() turns it off again.
+    bool SetLite(bool enable) {
+        if (WebRtcVad_set_lite(handle_, enable ? 1 : 0) == -1) {
+            printf("Set vad lite failed.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Advances over a gap of |num_frames| lost frames without processing
+    // audio, see WebRtcVad_AdvanceGap(). The aggregates count the frames at the
+    // length of the last frame of IsSpeech(), see
+    // WebRtcVad_UpdateSpeechActivityGap(); before the first one, they skip it.
+    bool AdvanceGap(size_t num_frames) {
+        if (speech_activity_ && frame_ms_ > 0 &&
+            WebRtcVad_UpdateSpeechActivityGap(speech_activity_.get(), handle_, num_frames, frame_ms_) == -1) {
+            printf("Advance vad gap failed.\n");
+            return false;
+        }
+        if (WebRtcVad_AdvanceGap(handle_, num_frames) == -1) {
+            printf("Advance vad gap failed.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Keeps rolling aggregates of the decisions of IsSpeech() over the last
+    // |window_ms|, see vad_activity.hpp; 0 stops them. Reset(), and with it
+    // Init(), starts them over; Rehydrate() and Restore() keep them.
+    bool SetSpeechActivityWindow(int window_ms) {
+        if (window_ms == 0) {
+            speech_activity_.reset();
+            return true;
+        }
+        std::unique_ptr<VadSpeechActivity> activity(new VadSpeechActivity);
+        if (WebRtcVad_InitSpeechActivity(activity.get(), window_ms) == -1) {
+            printf("Set vad activity window failed.\n");
+            return false;
+        }
+        speech_activity_ = std::move(activity);
+        return true;
+    }
+
+    // The aggregates, or nullptr unless SetSpeechActivityWindow() was called.
+    const VadSpeechActivity* speech_activity() const { return speech_activity_.get(); }
+
+    // Noise floor and SNR of the stream, see WebRtcVad_GetNoiseEstimate().
+    bool GetNoiseEstimate(VadNoiseEstimate* estimate) const {
+        return WebRtcVad_GetNoiseEstimate(handle_, estimate) == 0;
+    }
+
+    bool CaptureProfile(VadModelProfile* profile) const { return WebRtcVad_CaptureProfile(handle_, profile) == 0; }
+
+    // Counters of the instance, see WebRtcVad_GetStats(). False unless built
+    // with WEBRTC_VAD_STATS.
+    bool GetStats(VadCounters* counters) const { return WebRtcVad_GetStats(handle_, counters) == 0; }
+
     void Reset() {
-        if (handle_) {
-            WebRtcVad_Free(handle_);
+        NewHandle();
+        frame_ms_ = 0;
+        if (speech_activity_) {
+            WebRtcVad_InitSpeechActivity(speech_activity_.get(), (int)speech_activity_->window_ms);
         }
-        handle_ = WebRtcVad_Create();
+    }
+
+    // Hibernates the instance into |blob| and releases its state. IsSpeech()
+    // fails until Rehydrate() is called.
+    bool Hibernate(std::vector<uint8_t>* blob) {
+        blob->resize(WebRtcVad_HibernateMaxSize());
+        size_t length = WebRtcVad_Hibernate(handle_, blob->data(), blob->size());
+        if (length == 0) {
+            printf("Hibernate vad handle failed.\n");
+            blob->clear();
+            return false;
+        }
+        blob->resize(length);
+        WebRtcVad_Free(handle_);
+        handle_ = nullptr;
+        return true;
+    }
+
+    // Restores the state hibernated by Hibernate(). The aggregates of
+    // SetSpeechActivityWindow() are not part of |blob|: they stay with the
+    // object and go on from where they were.
+    bool Rehydrate(const std::vector<uint8_t>& blob) {
+        NewHandle();
+        if (handle_ == nullptr) {
+            printf("Create vad handle failed.\n");
+            return false;
+        }
+        if (WebRtcVad_Rehydrate(handle_, blob.data(), blob.size()) == -1) {
+            printf("Rehydrate vad handle failed.\n");
+            return false;
+        }
+        return true;
+    }
+
+    // Writes a versioned, portable snapshot of the instance to |snapshot|, e.g.,
+    // to migrate the stream to another worker.
+    bool Snapshot(std::vector<uint8_t>* snapshot) const {
+        snapshot->resize(WebRtcVad_SnapshotSize());
+        if (WebRtcVad_Snapshot(handle_, snapshot->data(), snapshot->size()) == 0) {
+            printf("Snapshot vad handle failed.\n");
+            snapshot->clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Continues from a snapshot written by Snapshot(). As with Rehydrate(), the
+    // aggregates of this object go on; they do not move with the snapshot.
+    bool Restore(const std::vector<uint8_t>& snapshot) {
+        NewHandle();
+        if (handle_ == nullptr) {
+            printf("Create vad handle failed.\n");
+            return false;
+        }
+        if (WebRtcVad_Restore(handle_, snapshot.data(), snapshot.size()) == -1) {
+            printf("Restore vad handle failed.\n");
+            return false;
+        }
+        return true;
     }
 
     ~Vad() { WebRtcVad_Free(handle_); }
@@ -54,8 +215,32 @@ public:
     void set_aggressiveness(Vad::Aggressiveness aggressiveness) { aggressiveness_ = aggressiveness; }
 
 private:
+    // Replaces the instance with a new, uninitialized one.
+    void NewHandle() {
+        if (handle_) {
+            WebRtcVad_Free(handle_);
+        }
+        handle_ = WebRtcVad_Create();
+    }
+
+    // Maps the result |ret| of a frame of |num_samples| at |sample_rate_hz| to
+    // an Activity, adding it to the aggregates if they are kept.
+    Activity Track(int ret, size_t num_samples, int sample_rate_hz) {
+        if (ret < 0) {
+            return kError;
+        }
+        frame_ms_ = (int)(num_samples * 1000 / (size_t)sample_rate_hz);
+        if (speech_activity_) {
+            WebRtcVad_UpdateSpeechActivity(speech_activity_.get(), ret, frame_ms_);
+        }
+        return ret == 1 ? kActive : kPassive;
+    }
+
     VadInst* handle_;
     Aggressiveness aggressiveness_;
+    std::unique_ptr<VadSpeechActivity> speech_activity_;
+    // Length of the last frame of IsSpeech(), 0 before the first one.
+    int frame_ms_;
 };
 }  // namespace webrtc
 #endif
\ No newline at end of file
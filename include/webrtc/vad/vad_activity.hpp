@@ -0,0 +1,288 @@
+#ifndef WEBRTC_VAD_VAD_ACTIVITY_HPP
+#define WEBRTC_VAD_VAD_ACTIVITY_HPP
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+
+// Noise floor and SNR of a stream, read from what the VAD already tracks, so
+// that AGC, noise suppression and QoS analytics do not need to estimate them
+// again. All levels are 10 * log10(energy) of a band of the 8 kHz signal in
+// Q4, the unit of the features (see WebRtcVad_CalculateFeatures()).
+typedef struct {
+    // Bands in use: kNumChannels, or kNumLiteChannels in the lite mode; the
+    // entries of the others are 0.
+    int num_channels;
+    // Smoothed minimum of the band energy over the last 100 frames, see
+    // WebRtcVad_FindMinimum().
+    int16_t noise_floor[kNumChannels];
+    // Means of the noise and speech models of the band, each the weighted
+    // mean of its two Gaussians.
+    int16_t noise_level[kNumChannels];
+    int16_t speech_level[kNumChannels];
+    // speech_level - noise_level, in dB in Q4.
+    int16_t snr[kNumChannels];
+    // Average of |snr| over the bands, weighted like the global test.
+    int16_t total_snr;
+} VadNoiseEstimate;
+
+// Rolling speech-activity aggregates of a stream, updated with the decision
+// of every frame in O(1). Time is kept in 10 ms slots, so the window may be
+// up to kVadActivityMaxWindowMs whatever the frame length.
+static const int kVadActivitySlotMs = 10;
+static const int kVadActivityMaxWindowMs = 60000;
+static const size_t kVadActivitySlots = (size_t)(kVadActivityMaxWindowMs / kVadActivitySlotMs);
+static const size_t kVadActivityWords = (kVadActivitySlots + 63) / 64;
+
+typedef struct {
+    // Since WebRtcVad_InitSpeechActivity().
+    uint64_t duration_ms;
+    uint64_t speech_ms;
+    // Runs of active frames.
+    uint64_t talk_spurts;
+    // Length of the talk spurt in progress, 0 outside of one.
+    uint64_t current_spurt_ms;
+
+    // Over the last |window_ms|, or |duration_ms| until the window is full.
+    uint32_t window_ms;
+    uint32_t window_filled_ms;
+    uint32_t window_speech_ms;
+    // Talk spurts that started in the window.
+    uint32_t window_talk_spurts;
+
+    // Ring of |window_ms| / kVadActivitySlotMs slots: whether each slot was
+    // speech, and whether a talk spurt started in it.
+    size_t next_slot;
+    uint64_t speech_slots[kVadActivityWords];
+    uint64_t onset_slots[kVadActivityWords];
+} VadSpeechActivity;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Reads the noise floor and SNR estimate of a VAD instance. The levels follow
+// the adapted model, so they settle within the first seconds of a stream;
+// until then, the speech levels are those of the generic start model.
+//
+// - handle   [i] : Initialized VAD instance.
+// - estimate [o] : Noise floor and SNR per band.
+//
+// returns        : 0 - (OK),
+//                 -1 - (null pointer or uninitialized instance).
+int WebRtcVad_GetNoiseEstimate(const VadInst* handle, VadNoiseEstimate* estimate);
+
+// Starts the aggregates over.
+//
+// - activity  [o] : Aggregates to initialize.
+// - window_ms [i] : Length of the rolling window, a multiple of
+//                   kVadActivitySlotMs up to kVadActivityMaxWindowMs.
+//
+// returns         : 0 - (OK),
+//                  -1 - (null pointer or invalid window).
+int WebRtcVad_InitSpeechActivity(VadSpeechActivity* activity, int window_ms);
+
+// Adds the decision of a frame.
+//
+// - activity [i/o] : Initialized aggregates.
+// - vad      [i]   : Decision of the frame, as returned by WebRtcVad_Process().
+// - frame_ms [i]   : Length of the frame, a multiple of kVadActivitySlotMs.
+//
+// returns          : 0 - (OK),
+//                   -1 - (null pointer or invalid frame length).
+int WebRtcVad_UpdateSpeechActivity(VadSpeechActivity* activity, int vad, int frame_ms);
+
+// Adds a gap of |num_frames| frames that |handle| is about to be advanced over
+// by WebRtcVad_AdvanceGap(), so that the window keeps covering wall time: the
+// frames still in the hangover of speech before the gap count as speech, the
+// others as non-speech. The cost is bounded whatever the length of the gap.
+//
+// - activity   [i/o] : Initialized aggregates.
+// - handle     [i]   : Initialized VAD instance, before WebRtcVad_AdvanceGap().
+// - num_frames [i]   : Number of frames in the gap.
+// - frame_ms   [i]   : Length of the frames, a multiple of kVadActivitySlotMs.
+//
+// returns            : 0 - (OK),
+//                     -1 - (null pointer, uninitialized instance or invalid
+//                           frame length).
+int WebRtcVad_UpdateSpeechActivityGap(VadSpeechActivity* activity, const VadInst* handle, size_t num_frames,
+                                      int frame_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Weighted mean of the two Gaussians of |channel| in |means| (Q7), in Q4.
+static inline int16_t VadModelLevel(const int16_t* means, const int16_t* weights, int channel) {
+    int32_t sum = 0;
+    int32_t total_weight = 0;
+    int k;
+    for (k = 0; k < kNumGaussians; k++) {
+        sum += weights[channel + k * kNumChannels] * means[channel + k * kNumChannels];
+        total_weight += weights[channel + k * kNumChannels];
+    }
+    // Q7 to Q4.
+    total_weight <<= 3;
+    return (int16_t)(sum >= 0 ? (sum + total_weight / 2) / total_weight : (sum - total_weight / 2) / total_weight);
+}
+
+inline int WebRtcVad_GetNoiseEstimate(const VadInst* handle, VadNoiseEstimate* estimate) {
+    const VadInstT* self = (const VadInstT*)handle;
+    const int16_t* spectrum_weight;
+    const int16_t* noise_data_weights;
+    const int16_t* speech_data_weights;
+    int32_t weighted_snr = 0;
+    int32_t total_weight = 0;
+    int channel;
+
+    if (handle == NULL || estimate == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+
+    spectrum_weight = self->lite ? kLiteSpectrumWeight : kSpectrumWeight;
+    noise_data_weights = self->lite ? kLiteNoiseDataWeights : kNoiseDataWeights;
+    speech_data_weights = self->lite ? kLiteSpeechDataWeights : kSpeechDataWeights;
+    memset(estimate, 0, sizeof(*estimate));
+    estimate->num_channels = self->lite ? kNumLiteChannels : kNumChannels;
+    for (channel = 0; channel < estimate->num_channels; channel++) {
+        estimate->noise_floor[channel] = self->mean_value[channel];
+        estimate->noise_level[channel] = VadModelLevel(self->noise_means, noise_data_weights, channel);
+        estimate->speech_level[channel] = VadModelLevel(self->speech_means, speech_data_weights, channel);
+        estimate->snr[channel] = (int16_t)(estimate->speech_level[channel] - estimate->noise_level[channel]);
+        weighted_snr += spectrum_weight[channel] * estimate->snr[channel];
+        total_weight += spectrum_weight[channel];
+    }
+    estimate->total_snr = (int16_t)(weighted_snr / total_weight);
+    return 0;
+}
+
+inline int WebRtcVad_InitSpeechActivity(VadSpeechActivity* activity, int window_ms) {
+    if (activity == NULL) {
+        return -1;
+    }
+    if (window_ms <= 0 || window_ms > kVadActivityMaxWindowMs || window_ms % kVadActivitySlotMs != 0) {
+        return -1;
+    }
+    memset(activity, 0, sizeof(*activity));
+    activity->window_ms = (uint32_t)window_ms;
+    return 0;
+}
+
+// Moves the ring of |activity| on by one slot, dropping the oldest slot once
+// the window is full.
+static inline void VadPushActivitySlot(VadSpeechActivity* activity, int speech, int onset) {
+    const size_t word = activity->next_slot >> 6;
+    const uint64_t bit = (uint64_t)1 << (activity->next_slot & 63);
+
+    if (activity->window_filled_ms == activity->window_ms) {
+        activity->window_speech_ms -= (activity->speech_slots[word] & bit) ? kVadActivitySlotMs : 0;
+        activity->window_talk_spurts -= (activity->onset_slots[word] & bit) ? 1 : 0;
+    } else {
+        activity->window_filled_ms += kVadActivitySlotMs;
+    }
+    activity->speech_slots[word] = speech ? activity->speech_slots[word] | bit : activity->speech_slots[word] & ~bit;
+    activity->onset_slots[word] = onset ? activity->onset_slots[word] | bit : activity->onset_slots[word] & ~bit;
+    activity->window_speech_ms += speech ? kVadActivitySlotMs : 0;
+    activity->window_talk_spurts += onset ? 1 : 0;
+    activity->next_slot++;
+    if (activity->next_slot * kVadActivitySlotMs == activity->window_ms) {
+        activity->next_slot = 0;
+    }
+}
+
+inline int WebRtcVad_UpdateSpeechActivity(VadSpeechActivity* activity, int vad, int frame_ms) {
+    const int speech = vad > 0;
+    int onset;
+    int slot;
+
+    if (activity == NULL || activity->window_ms == 0) {
+        return -1;
+    }
+    if (frame_ms <= 0 || frame_ms % kVadActivitySlotMs != 0) {
+        return -1;
+    }
+
+    onset = speech && activity->current_spurt_ms == 0;
+    for (slot = 0; slot < frame_ms; slot += kVadActivitySlotMs) {
+        VadPushActivitySlot(activity, speech, onset && slot == 0);
+    }
+    activity->duration_ms += (uint64_t)frame_ms;
+    activity->talk_spurts += onset ? 1 : 0;
+    if (speech) {
+        activity->speech_ms += (uint64_t)frame_ms;
+        activity->current_spurt_ms += (uint64_t)frame_ms;
+    } else {
+        activity->current_spurt_ms = 0;
+    }
+    return 0;
+}
+
+// Moves the ring of |activity| on by |num_slots| slots without onsets. Past
+// the window, only the position of the ring changes.
+static inline void VadPushActivitySlots(VadSpeechActivity* activity, int speech, uint64_t num_slots) {
+    const uint64_t window_slots = activity->window_ms / kVadActivitySlotMs;
+    const uint64_t pushed = num_slots < window_slots ? num_slots : window_slots;
+    uint64_t i;
+
+    for (i = 0; i < pushed; i++) {
+        VadPushActivitySlot(activity, speech, 0);
+    }
+    activity->next_slot = (size_t)((activity->next_slot + (num_slots - pushed) % window_slots) % window_slots);
+}
+
+inline int WebRtcVad_UpdateSpeechActivityGap(VadSpeechActivity* activity, const VadInst* handle, size_t num_frames,
+                                             int frame_ms) {
+    const VadInstT* self = (const VadInstT*)handle;
+    uint64_t speech_frames;
+    uint64_t ms;
+
+    if (activity == NULL || activity->window_ms == 0 || handle == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+    if (frame_ms <= 0 || frame_ms % kVadActivitySlotMs != 0) {
+        return -1;
+    }
+
+    // Frame i of the gap, from 1, is in the hangover while
+    // |over_hang| - (i - 1) > 0, see WebRtcVad_AdvanceGapCore().
+    speech_frames = self->over_hang > 0 ? (uint64_t)self->over_hang : 0;
+    if (speech_frames > num_frames) {
+        speech_frames = num_frames;
+    }
+    if (speech_frames > 0) {
+        ms = speech_frames * (uint64_t)frame_ms;
+        if (activity->current_spurt_ms == 0) {
+            VadPushActivitySlot(activity, 1, 1);
+            VadPushActivitySlots(activity, 1, ms / kVadActivitySlotMs - 1);
+            activity->talk_spurts++;
+        } else {
+            VadPushActivitySlots(activity, 1, ms / kVadActivitySlotMs);
+        }
+        activity->duration_ms += ms;
+        activity->speech_ms += ms;
+        activity->current_spurt_ms += ms;
+    }
+    if (num_frames > speech_frames) {
+        ms = ((uint64_t)num_frames - speech_frames) * (uint64_t)frame_ms;
+        VadPushActivitySlots(activity, 0, ms / kVadActivitySlotMs);
+        activity->duration_ms += ms;
+        activity->current_spurt_ms = 0;
+    }
+    return 0;
+}
+
+// Fraction of the window that was speech, 0 before the first frame.
+static inline double WebRtcVad_WindowSpeechRatio(const VadSpeechActivity* activity) {
+    return activity->window_filled_ms > 0 ? (double)activity->window_speech_ms / activity->window_filled_ms : 0.0;
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,84 @@
+#ifndef WEBRTC_VAD_VAD_ANALYSIS_HPP
+#define WEBRTC_VAD_VAD_ANALYSIS_HPP
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+
+// What the VAD saw in one frame, for callers that want more than the binary
+// decision, e.g., to train a classifier on the features or to threshold the
+// likelihood ratio themselves.
+typedef struct {
+    // Log energy per sub-band (channel) in Q4, see WebRtcVad_CalculateFeatures().
+    // In the lite mode, the |kNumLiteChannels| first ones, the others are 0.
+    int16_t features[kNumChannels];
+    int16_t total_power;
+    // Spectrum-weighted sum of the per-channel log2 likelihood ratios of
+    // speech over noise, i.e., the statistic of the global test. Positive
+    // values favor speech. Zero for frames below |kMinEnergy|, which are not
+    // scored.
+    int32_t sum_log_likelihood_ratios;
+    // Decision before hangover is folded in: 0 - noise, 1 - speech, 2 and
+    // above - speech held by the hangover.
+    int vad;
+} VadFrameAnalysis;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Like WebRtcVad_Process(), and makes the same decision and state update, but
+// also returns the features and the likelihood ratio behind the decision.
+//
+// - handle       [i/o] : VAD Instance. Needs to be initialized by
+//                        WebRtcVad_Init() before call.
+// - fs           [i]   : Sampling frequency (Hz): 8000, 16000, 32000 or 48000.
+// - audio_frame  [i]   : Audio frame buffer.
+// - frame_length [i]   : Length of audio frame buffer in number of samples.
+// - analysis     [o]   : Features and scores of the frame.
+//
+// returns              : 1 - (Active Voice),
+//                        0 - (Non-active Voice),
+//                       -1 - (Error)
+int WebRtcVad_ProcessWithAnalysis(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length,
+                                  VadFrameAnalysis* analysis);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Trace policy that fills |analysis| from the view of the frame, so that
+// WebRtcVad_ProcessWithAnalysis() runs the pipeline of WebRtcVad_Process().
+struct VadAnalysisTrace {
+    static const bool kEnabled = true;
+    VadFrameAnalysis* analysis;
+    void OnFeatures(const VadTraceView&) {}
+    void OnLikelihood(const VadTraceView&) {}
+    void OnFrame(const VadTraceView& view) {
+        memcpy(analysis->features, view.features, sizeof(analysis->features));
+        analysis->total_power = view.total_power;
+        analysis->sum_log_likelihood_ratios = view.sum_log_likelihood_ratios;
+        analysis->vad = view.vad;
+    }
+};
+
+inline int WebRtcVad_ProcessWithAnalysis(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length,
+                                         VadFrameAnalysis* analysis) {
+    VadAnalysisTrace trace = {analysis};
+    if (analysis == NULL) {
+        return -1;
+    }
+#ifdef WEBRTC_VAD_STATS
+    const uint64_t start_ns = VadStatsNow();
+    int vad = WebRtcVad_ProcessTraced(handle, fs, audio_frame, frame_length, trace);
+    VadStatsRecordProcessed(handle, vad, start_ns);
+    return vad;
+#else
+    return WebRtcVad_ProcessTraced(handle, fs, audio_frame, frame_length, trace);
+#endif
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,104 @@
+#ifndef WEBRTC_VAD_VAD_CHUNKED_HPP
+#define WEBRTC_VAD_VAD_CHUNKED_HPP
+#include <stddef.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "webrtc/vad/vad.hpp"
+
+namespace webrtc {
+// Offline processing of one long recording on several threads.
+//
+// The VAD's state (filters, GMM, minimum tracker) depends on all prior audio,
+// so a recording can't be split exactly. VadProcessChunked() splits the
+// |num_frames| frames of |audio| into |num_chunks| consecutive chunks, each
+// run by its own thread on its own instance. Every chunk but the first starts
+// |warmup_frames| frames early, discarding the decisions over that overlap, to
+// let its instance adapt to the audio before its own frames are decided. The
+// decisions of the chunks are stitched into |decisions|, which must hold
+// |num_frames| entries.
+//
+// The result is only approximately the serial one. The filters and the
+// minimum tracker forget their start within a second, but the GMM adapts
+// over minutes, so a chunk's decisions keep differing from the serial ones
+// in a small fraction of frames until its model has converged to the serial
+// run's. Longer warm-ups shrink that fraction; VadCompareChunked() measures
+// it, to choose |warmup_frames| for a corpus.
+//
+// Returns false if an instance can't be initialized or a frame fails.
+inline bool VadProcessChunked(Vad::Aggressiveness aggressiveness, const int16_t* audio, size_t num_frames,
+                              size_t frame_length, int sample_rate_hz, size_t num_chunks, size_t warmup_frames,
+                              Vad::Activity* decisions) {
+    if (num_chunks == 0) {
+        num_chunks = 1;
+    }
+    if (num_chunks > num_frames) {
+        num_chunks = num_frames > 0 ? num_frames : 1;
+    }
+    std::vector<std::thread> threads;
+    std::vector<char> ok(num_chunks, 0);
+
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+        threads.emplace_back([=, &ok] {
+            size_t begin = num_frames * chunk / num_chunks;
+            size_t end = num_frames * (chunk + 1) / num_chunks;
+            size_t warmup_begin = begin > warmup_frames ? begin - warmup_frames : 0;
+            Vad vad(aggressiveness);
+            if (!vad.Init()) {
+                return;
+            }
+            for (size_t i = warmup_begin; i < end; i++) {
+                Vad::Activity activity = vad.IsSpeech(&audio[i * frame_length], frame_length, sample_rate_hz);
+                if (activity == Vad::kError) {
+                    return;
+                }
+                if (i >= begin) {
+                    decisions[i] = activity;
+                }
+            }
+            ok[chunk] = 1;
+        });
+    }
+    bool result = true;
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+        threads[chunk].join();
+        result = result && ok[chunk];
+    }
+    return result;
+}
+
+// Divergence of chunked decisions from serial ones, per chunk.
+struct VadChunkDivergence {
+    size_t begin;       // First frame of the chunk.
+    size_t length;      // Frames in the chunk.
+    size_t mismatches;  // Frames of the chunk whose decisions differ.
+};
+
+// Compares |chunked| decisions, as computed by VadProcessChunked() with
+// |num_chunks| chunks, with |serial| ones, and fills |divergence| with one
+// entry per chunk. Returns the total number of mismatching frames.
+inline size_t VadCompareChunked(const Vad::Activity* serial, const Vad::Activity* chunked, size_t num_frames,
+                                size_t num_chunks, std::vector<VadChunkDivergence>* divergence) {
+    size_t total = 0;
+    if (num_chunks == 0) {
+        num_chunks = 1;
+    }
+    if (num_chunks > num_frames) {
+        num_chunks = num_frames > 0 ? num_frames : 1;
+    }
+    divergence->assign(num_chunks, VadChunkDivergence{0, 0, 0});
+    for (size_t chunk = 0; chunk < num_chunks; chunk++) {
+        VadChunkDivergence& entry = (*divergence)[chunk];
+        entry.begin = num_frames * chunk / num_chunks;
+        entry.length = num_frames * (chunk + 1) / num_chunks - entry.begin;
+        for (size_t i = entry.begin; i < entry.begin + entry.length; i++) {
+            entry.mismatches += serial[i] != chunked[i];
+        }
+        total += entry.mismatches;
+    }
+    return total;
+}
+}  // namespace webrtc
+#endif
@@ -1,15 +1,19 @@
 #ifndef WEBRTC_VAD_VAD_CORE_HPP
 #define WEBRTC_VAD_VAD_CORE_HPP
 #include "webrtc/singal_processing/singal_processing_library.hpp"
+#include "webrtc/vad/vad_perf.hpp"
+#include "webrtc/vad/vad_stats.hpp"
+#include "webrtc/vad/vad_trace.hpp"
 
 namespace webrtc {
 
 // Use a single enum to avoid deprecated enum-enum conversion warning
 enum VadConstants {
-    kNumChannels = 6,    // Number of frequency bands (named channels).
-    kNumGaussians = 2,   // Number of Gaussians per channel in the GMM.
+    kNumChannels = 6,      // Number of frequency bands (named channels).
+    kNumLiteChannels = 3,  // Number of frequency bands in the lite mode.
+    kNumGaussians = 2,     // Number of Gaussians per channel in the GMM.
     kTableSize = kNumChannels * kNumGaussians,
-    kMinEnergy = 10      // Minimum energy required to trigger audio signal.
+    kMinEnergy = 10        // Minimum energy required to trigger audio signal.
 };
 
 typedef struct VadInstT_ {
@@ -36,8 +40,23 @@ typedef struct VadInstT_ {
     int16_t over_hang_max_2[3];
     int16_t individual[3];
     int16_t total[3];
+    // Cascade pre-screen, see WebRtcVad_CascadeGate(): enabled (1) or not (0),
+    // and the tracked floor of the input level, mean square in Q4.
+    int16_t cascade;
+    int32_t cascade_floor;
+    // Lite mode, see WebRtcVad_set_lite_core(): the model has the
+    // |kNumLiteChannels| first channels of the tables above (1) or all of them
+    // (0).
+    int16_t lite;
 
     int init_flag;
+#ifdef WEBRTC_VAD_STATS
+    // Not part of the processing state, see vad_stats.hpp.
+    VadCounters stats;
+    // Whether the last frame skipped the GMM for its low energy. Counted in
+    // |stats| only by the callers that record the frame itself.
+    int low_energy;
+#endif
 } VadInstT;
 
 // Initializes the core VAD component. The default aggressiveness mode is
@@ -68,6 +87,36 @@ int WebRtcVad_InitCore(VadInstT* self);
 
 int WebRtcVad_set_mode_core(VadInstT* self, int mode);
 
+// Switches between the full model of |kNumChannels| sub-bands and the lite
+// model of |kNumLiteChannels|, see WebRtcVad_CalculateLiteFeatures(). The
+// models do not carry over, so the filter states, the GMM and the minimum
+// tracker start over as in WebRtcVad_InitCore(); the mode and the cascade
+// setting are kept.
+//
+// - self [i/o] : Initialized instance.
+// - lite [i]   : 1 - lite model, 0 - full model.
+//
+// returns      : 0 (OK), -1 (invalid |lite|).
+int WebRtcVad_set_lite_core(VadInstT* self, int lite);
+
+// Advances |self| over a gap of |num_frames| frames without audio, e.g., lost
+// or concealed packets, in O(kNumChannels) whatever the length of the gap:
+// - the minimum tracker ages by |num_frames|, dropping the values that pass
+//   the age of 100 frames, as if the frames brought no new minima,
+// - |frame_counter| advances by |num_frames|,
+// - the hangover runs down as over non-speech frames,
+// - the filter and resampler states are reset, the state their response to
+//   the audio before the gap decays towards over silence.
+// The GMM and the smoothed minima are not updated, since nothing is observed.
+//
+// - self       [i/o] : Initialized instance.
+// - num_frames [i]   : Number of frames in the gap.
+//
+// returns            : The decision of the last frame of the gap, 0 or, while
+//                      the hangover lasts, 2 + the remaining hangover; 0 for
+//                      an empty gap.
+int WebRtcVad_AdvanceGapCore(VadInstT* self, size_t num_frames);
+
 /****************************************************************************
  * WebRtcVad_CalcVad48khz(...)
  * WebRtcVad_CalcVad32khz(...)
@@ -93,6 +142,17 @@ int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame, size_t f
 int WebRtcVad_CalcVad16khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length);
 int WebRtcVad_CalcVad8khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length);
 
+// Like the functions above, and also calls the hooks of |trace| for the
+// frame, see vad_trace.hpp.
+template <typename Trace>
+int WebRtcVad_CalcVad48khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length, Trace& trace);
+template <typename Trace>
+int WebRtcVad_CalcVad32khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length, Trace& trace);
+template <typename Trace>
+int WebRtcVad_CalcVad16khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length, Trace& trace);
+template <typename Trace>
+int WebRtcVad_CalcVad8khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length, Trace& trace);
+
 // Downsamples the signal by a factor 2, eg. 32->16 or 16->8.
 //
 // Inputs:
@@ -124,6 +184,43 @@ void WebRtcVad_Downsampling(const int16_t* signal_in, int16_t* signal_out, int32
 //                      : Smoothed minimum value for a moving window.
 int16_t WebRtcVad_FindMinimum(VadInstT* handle, int16_t feature_value, int channel);
 
+// Cheap pre-screen of the raw input frame for the cascade mode. In one pass
+// over |frame| it computes the peak and the mean square of the samples and
+// tracks their floor. Gates the frame if it is dither of about an LSB, or if it
+// is quiet and within 3 dB of the floor, e.g., digital silence or comfort noise
+// on hold or mute.
+//
+// Inputs:
+//      - frame         : Input frame, at any rate.
+//      - frame_length  : Number of input samples.
+//
+// Input & Output:
+//      - self          : State information of the VAD, |cascade_floor| is
+//                        updated.
+//
+// Returns:
+//                      : 1 - the frame may skip the feature extraction,
+//                        0 - it needs the full pipeline.
+int WebRtcVad_CascadeGate(VadInstT* self, const int16_t* frame, size_t frame_length);
+
+// Decides a frame gated by WebRtcVad_CascadeGate() without extracting its
+// features: the filter states are reset, as after a long silence, and the
+// frame is scored like one below |kMinEnergy|, with the features of digital
+// silence. Such frames do not update the model or the minimum tracker, and
+// only count down the hangover.
+//
+// Inputs:
+//      - frame_length  : Number of samples of the frame at 8 kHz.
+//      - trace         : Trace policy, see vad_trace.hpp.
+//
+// Input & Output:
+//      - self          : State information of the VAD.
+//
+// Returns:
+//                      : VAD decision, as WebRtcVad_CalcVad8khz().
+template <typename Trace>
+int WebRtcVad_CalcVadGatedTraced(VadInstT* self, size_t frame_length, Trace& trace);
+
 // Allpass filter coefficients, upper and lower, in Q13.
 // Upper: 0.64, Lower: 0.17.
 static const int16_t kAllPassCoefsQ13[2] = {5243, 1392};  // Q13.
@@ -157,12 +254,71 @@ inline void WebRtcVad_Downsampling(const int16_t* signal_in, int16_t* signal_out
     filter_state[1] = tmp32_2;
 }
 
+#ifdef WEBRTC_VAD_WCET
+// The aging and insertion of WebRtcVad_FindMinimum() on the 16 |age| and
+// |smallest_values| of a channel, with the same result and a fixed sequence
+// of instructions instead of shift loops that depend on the data.
+//
+// The reference walks the slots once and, when it removes a value of age 100,
+// shifts the rest down and steps over the value that moved into the slot, so
+// that value does not age. Removals therefore never hit two neighbors, and in
+// a run of values of age 100 every other one goes. Each removal appends a
+// filler of value 10000 and age 101, which ages too unless the walk steps
+// over it.
+static inline void WebRtcVad_UpdateMinimaBranchFree(int16_t* age, int16_t* smallest_values, int16_t feature_value) {
+    uint32_t removed = 0;
+    uint32_t previous = 0;
+    int num_removed = 0;
+    int position = 0;
+    int destination = 0;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        previous = (uint32_t)(age[i] == 100) & ~previous;
+        removed |= previous << i;
+        num_removed += (int)previous;
+    }
+    const uint32_t stepped_over = removed << 1;
+    // Compacts in place, |destination| <= |i|. A removed value is overwritten
+    // by the next one.
+    for (i = 0; i < 16; i++) {
+        int16_t value = smallest_values[i];
+        int16_t value_age = (int16_t)(age[i] + 1 - (int)((stepped_over >> i) & 1));
+        smallest_values[destination] = value;
+        age[destination] = value_age;
+        destination += 1 - (int)((removed >> i) & 1);
+    }
+    // The first filler is stepped over if the last slot was removed.
+    const int first_filler = 16 - num_removed;
+    const int16_t first_filler_age = (int16_t)(102 - (int)(removed >> 15));
+    for (i = 0; i < 16; i++) {
+        const int filler = i >= first_filler;
+        smallest_values[i] = filler ? 10000 : smallest_values[i];
+        age[i] = filler ? (i == first_filler ? first_filler_age : 102) : age[i];
+    }
+
+    // The slots are sorted, so the new value goes after all values not larger
+    // than it, if any are larger.
+    for (i = 0; i < 16; i++) {
+        position += smallest_values[i] <= feature_value;
+    }
+    for (i = 15; i > 0; i--) {
+        const int shift = i > position;
+        smallest_values[i] = shift ? smallest_values[i - 1] : smallest_values[i];
+        age[i] = shift ? age[i - 1] : age[i];
+    }
+    for (i = 0; i < 16; i++) {
+        const int insert = i == position;
+        smallest_values[i] = insert ? feature_value : smallest_values[i];
+        age[i] = insert ? 1 : age[i];
+    }
+}
+#endif
+
 // Inserts |feature_value| into |low_value_vector|, if it is one of the 16
 // smallest values the last 100 frames. Then calculates and returns the median
 // of the five smallest values.
 inline int16_t WebRtcVad_FindMinimum(VadInstT* self, int16_t feature_value, int channel) {
-    int i = 0, j = 0;
-    int position = -1;
     // Offset to beginning of the 16 minimum values in memory.
     const int offset = (channel << 4);
     int16_t current_median = 1600;
@@ -175,6 +331,12 @@ inline int16_t WebRtcVad_FindMinimum(VadInstT* self, int16_t feature_value, int
 
     RTC_DCHECK_LT(channel, kNumChannels);
 
+#ifdef WEBRTC_VAD_WCET
+    WebRtcVad_UpdateMinimaBranchFree(age, smallest_values, feature_value);
+#else
+    int i = 0, j = 0;
+    int position = -1;
+
     // Each value in |smallest_values| is getting 1 loop older. Update |age|, and
     // remove old values.
     for (i = 0; i < 16; i++) {
@@ -254,6 +416,7 @@ inline int16_t WebRtcVad_FindMinimum(VadInstT* self, int16_t feature_value, int
         smallest_values[position] = feature_value;
         age[position] = 1;
     }
+#endif
 
     // Get |current_median|.
     if (self->frame_counter > 2) {
@@ -300,6 +463,26 @@ inline int16_t WebRtcVad_FindMinimum(VadInstT* self, int16_t feature_value, int
 //                        exact. It is only used in a comparison.)
 int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in, size_t data_length, int16_t* features);
 
+// Like WebRtcVad_CalculateFeatures(), for the lite mode: the split filter tree
+// stops after the second split, and the log energies of the
+// |kNumLiteChannels| = 3 bands
+//        0 Hz - 1000 Hz
+//        1000 Hz - 2000 Hz
+//        2000 Hz - 4000 Hz
+// are written to |features|. The middle band is channel 3 of the full mode.
+// The others are offset to about the logarithmic sum of the full-mode
+// features of their bands, so that the lite GMM can be derived from the full
+// one.
+//
+// - self         [i/o] : State information of the VAD.
+// - data_in      [i]   : Input audio data, for feature extraction.
+// - data_length  [i]   : Audio data size, in number of samples.
+// - features     [o]   : 10 * log10(energy in each frequency band), Q4.
+// - returns            : Total energy of the signal, as
+//                        WebRtcVad_CalculateFeatures().
+int16_t WebRtcVad_CalculateLiteFeatures(VadInstT* self, const int16_t* data_in, size_t data_length,
+                                        int16_t* features);
+
 // Constants used in LogOfEnergy().
 static const int16_t kLogConst = 24660;          // 160*log10(2) in Q9.
 static const int16_t kLogEnergyIntPart = 14336;  // 14 in Q10
@@ -314,6 +497,9 @@ static const int16_t kAllPassCoefsQ15[2] = {20972, 5571};
 
 // Adjustment for division with two in SplitFilter.
 static const int16_t kOffsetVector[6] = {368, 368, 272, 176, 176, 176};
+// The same for the bands of WebRtcVad_CalculateLiteFeatures(): each split
+// halves the energy of the sum of its two outputs, 48 in Q4.
+static const int16_t kLiteOffsetVector[kNumLiteChannels] = {224, 176, 128};
 
 // High pass filtering, with a cut-off frequency at 80 Hz, if the |data_in| is
 // sampled at 500 Hz.
@@ -605,6 +791,47 @@ inline int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_i
 
     return total_energy;
 }
+
+inline int16_t WebRtcVad_CalculateLiteFeatures(VadInstT* self, const int16_t* data_in, size_t data_length,
+                                               int16_t* features) {
+    int16_t total_energy = 0;
+    // As in WebRtcVad_CalculateFeatures(), at most 120 samples after the first
+    // split and 60 after the second.
+    int16_t hp_120[120], lp_120[120];
+    int16_t hp_60[60], lp_60[60];
+    size_t length = data_length >> 1;
+
+    RTC_DCHECK_LE(data_length, 240);
+
+    // Split at 2000 Hz and downsample.
+    SplitFilter(data_in, data_length, &self->upper_state[0], &self->lower_state[0], hp_120, lp_120);
+
+    // Energy in 2000 Hz - 4000 Hz.
+    LogOfEnergy(hp_120, length, kLiteOffsetVector[2], &total_energy, &features[2]);
+
+    // For the lower band (0 Hz - 2000 Hz) split at 1000 Hz and downsample, with
+    // the filter states of the same split in WebRtcVad_CalculateFeatures().
+    SplitFilter(lp_120, length, &self->upper_state[2], &self->lower_state[2], hp_60, lp_60);
+
+    // Energy in 1000 Hz - 2000 Hz and 0 Hz - 1000 Hz.
+    length >>= 1;
+    LogOfEnergy(hp_60, length, kLiteOffsetVector[1], &total_energy, &features[1]);
+    LogOfEnergy(lp_60, length, kLiteOffsetVector[0], &total_energy, &features[0]);
+
+    return total_energy;
+}
+
+// Writes the features of digital silence, in the mode of |self|, to the
+// |kNumChannels| values of |features|: the band offsets, and 0 for the
+// channels the lite mode does not use.
+static inline void WebRtcVad_SilenceFeatures(const VadInstT* self, int16_t* features) {
+    if (self->lite) {
+        memset(features, 0, kNumChannels * sizeof(*features));
+        memcpy(features, kLiteOffsetVector, sizeof(kLiteOffsetVector));
+    } else {
+        memcpy(features, kOffsetVector, sizeof(kOffsetVector));
+    }
+}
 }  // namespace webrtc
 
 #include <string.h>
@@ -640,6 +867,27 @@ static const int16_t kSpeechDataMeans[kTableSize] = {8306, 10085, 10078, 11823,
 static const int16_t kNoiseDataStds[kTableSize] = {378, 1064, 493, 582, 688, 593, 474, 697, 475, 688, 421, 455};
 // Stds for the two Gaussians for the six channels (speech)
 static const int16_t kSpeechDataStds[kTableSize] = {555, 505, 567, 524, 585, 1231, 509, 828, 492, 1540, 1079, 850};
+// Upper limit of the noise means in dB, one more for the second Gaussian.
+static const int16_t kMaximumNoiseMean[kNumChannels] = {72, 71, 70, 69, 68, 67};
+
+// The same for the lite mode, derived from the tables above: the model of
+// channel 1 is that of channel 3, and the bands of channels 0 and 2 merge
+// channels 0 to 2 and 4 to 5, respectively. Their means are the logarithmic
+// sums of the merged means, their weights and stds the averages, and their
+// limits are raised by 10 * log10(number of merged bands). The spectrum
+// weights are summed, so that the global thresholds keep their scale. The
+// tables keep the layout of the full ones, channels 3 to 5 are unused.
+static const int16_t kLiteSpectrumWeight[kNumChannels] = {24, 12, 30, 0, 0, 0};
+static const int16_t kLiteMinimumDifference[kNumChannels] = {544, 576, 576, 0, 0, 0};
+static const int16_t kLiteMaximumSpeech[kNumChannels] = {12131, 11520, 11905, 0, 0, 0};
+static const int16_t kLiteMaximumNoise[kNumChannels] = {9827, 8832, 9089, 0, 0, 0};
+static const int16_t kLiteMaximumNoiseMean[kNumChannels] = {77, 69, 71, 0, 0, 0};
+static const int16_t kLiteNoiseDataWeights[kTableSize] = {56, 66, 39, 0, 0, 0, 72, 62, 89, 0, 0, 0};
+static const int16_t kLiteSpeechDataWeights[kTableSize] = {58, 87, 48, 0, 0, 0, 70, 41, 80, 0, 0, 0};
+static const int16_t kLiteNoiseDataMeans[kTableSize] = {7318, 6715, 6772, 0, 0, 0, 8125, 7266, 5168, 0, 0, 0};
+static const int16_t kLiteSpeechDataMeans[kTableSize] = {10478, 11823, 11843, 0, 0, 0, 10969, 7581, 8320, 0, 0, 0};
+static const int16_t kLiteNoiseDataStds[kTableSize] = {645, 582, 640, 0, 0, 0, 549, 688, 438, 0, 0, 0};
+static const int16_t kLiteSpeechDataStds[kTableSize] = {542, 524, 908, 0, 0, 0, 610, 1540, 964, 0, 0, 0};
 
 // Constants used in GmmProbability().
 //
@@ -653,6 +901,21 @@ static const int16_t kMinStd = 384;
 static const short kDefaultMode = 0;
 static const int kInitCheck = 42;
 
+// Constants used in WebRtcVad_CascadeGate().
+//
+// Frames with a larger peak always run the full pipeline. Up to it, the sum
+// of squares of the longest frame, 1440 samples, fits in 32 bits.
+static const int32_t kCascadePeakMax = 255;
+// Mean square in Q4 up to which frames are gated whatever the floor, dither
+// of about an LSB.
+static const int32_t kCascadeLevelMin = 2 << 4;
+// Mean square in Q4 above which frames are never gated, about -66 dBFS. Also
+// the initial floor.
+static const int32_t kCascadeLevelMax = 256 << 4;
+// The floor follows drops of the level at once and rises by 1 / 2^8 of the
+// difference per frame, over seconds.
+static const int kCascadeFloorRiseShift = 8;
+
 // Constants used in WebRtcVad_set_mode_core().
 //
 // Thresholds for different frame lengths (10 ms, 20 ms and 30 ms).
@@ -705,6 +968,65 @@ static inline int32_t RTC_NO_SANITIZE("signed-integer-overflow") OverflowingMulS
     return a * b;
 }
 
+#ifdef WEBRTC_VAD_WCET
+// Built for a bounded worst-case execution time, GmmProbability() scores and
+// updates the model for every frame and masks the results of frames at or
+// below |kMinEnergy|, instead of skipping the work. The path is bounded, not
+// fixed: the choice between the noise and speech model updates, the sign
+// tests before the divisions, the separation of models closer than
+// |minimum_difference|, the maximum speech and noise clamps, the exp() branch
+// of WebRtcVad_GaussianProbability() and the |energy| != 0 test of
+// LogOfEnergy() still depend on the data, each with bounded work on either
+// side.
+static const bool kVadBoundedTime = true;
+#else
+static const bool kVadBoundedTime = false;
+#endif
+
+// The fields of the model GmmProbability() updates.
+typedef struct {
+    int16_t noise_means[kTableSize];
+    int16_t speech_means[kTableSize];
+    int16_t noise_stds[kTableSize];
+    int16_t speech_stds[kTableSize];
+    int32_t frame_counter;
+    int16_t index_vector[16 * kNumChannels];
+    int16_t low_value_vector[16 * kNumChannels];
+    int16_t mean_value[kNumChannels];
+} VadModelUpdate;
+
+static inline void SaveModelUpdate(const VadInstT* self, VadModelUpdate* saved) {
+    memcpy(saved->noise_means, self->noise_means, sizeof(saved->noise_means));
+    memcpy(saved->speech_means, self->speech_means, sizeof(saved->speech_means));
+    memcpy(saved->noise_stds, self->noise_stds, sizeof(saved->noise_stds));
+    memcpy(saved->speech_stds, self->speech_stds, sizeof(saved->speech_stds));
+    saved->frame_counter = self->frame_counter;
+    memcpy(saved->index_vector, self->index_vector, sizeof(saved->index_vector));
+    memcpy(saved->low_value_vector, self->low_value_vector, sizeof(saved->low_value_vector));
+    memcpy(saved->mean_value, self->mean_value, sizeof(saved->mean_value));
+}
+
+static inline void SelectInt16(int16_t* values, const int16_t* saved, size_t length, int16_t mask) {
+    size_t i;
+    for (i = 0; i < length; i++) {
+        values[i] = (int16_t)((values[i] & mask) | (saved[i] & ~mask));
+    }
+}
+
+// Keeps the update of the model since SaveModelUpdate() if |keep|, or restores
+// |saved|, with the same instructions either way.
+static inline void MaskModelUpdate(VadInstT* self, const VadModelUpdate* saved, int keep) {
+    const int16_t mask = (int16_t)-keep;
+    SelectInt16(self->noise_means, saved->noise_means, kTableSize, mask);
+    SelectInt16(self->speech_means, saved->speech_means, kTableSize, mask);
+    SelectInt16(self->noise_stds, saved->noise_stds, kTableSize, mask);
+    SelectInt16(self->speech_stds, saved->speech_stds, kTableSize, mask);
+    self->frame_counter = (self->frame_counter & (int32_t)mask) | (saved->frame_counter & ~(int32_t)mask);
+    SelectInt16(self->index_vector, saved->index_vector, 16 * kNumChannels, mask);
+    SelectInt16(self->low_value_vector, saved->low_value_vector, 16 * kNumChannels, mask);
+    SelectInt16(self->mean_value, saved->mean_value, kNumChannels, mask);
+}
+
 // Calculates the probabilities for both speech and background noise using
 // Gaussian Mixture Models (GMM). A hypothesis-test is performed to decide which
 // type of signal is most probable.
@@ -715,8 +1037,16 @@ static inline int32_t RTC_NO_SANITIZE("signed-integer-overflow") OverflowingMulS
 // - total_power    [i]   : Total power in audio frame.
 // - frame_length   [i]   : Number of input samples
 //
+// - trace          [i/o] : Trace policy, see vad_trace.hpp.
+//
 // - returns              : the VAD decision (0 - noise, 1 - speech).
-static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_power, size_t frame_length) {
+//
+// With |kLite|, the model has the |kNumLiteChannels| channels of the lite
+// mode, with the kLite* tables, and |features| comes from
+// WebRtcVad_CalculateLiteFeatures().
+template <bool kLite, typename Trace>
+static int16_t GmmProbabilityTraced(VadInstT* self, int16_t* features, int16_t total_power, size_t frame_length,
+                                    Trace& trace) {
     int channel, k;
     int16_t feature_minimum;
     int16_t h0, h1;
@@ -735,9 +1065,18 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
     int32_t h0_test, h1_test;
     int32_t tmp1_s32, tmp2_s32;
     int32_t sum_log_likelihood_ratios = 0;
+    int16_t log_likelihood_ratios[kNumChannels] = {0};  // Only kept for |trace|.
     int32_t noise_global_mean, speech_global_mean;
     int32_t noise_probability[kNumGaussians], speech_probability[kNumGaussians];
     int16_t overhead1, overhead2, individualTest, totalTest;
+    const int num_channels = kLite ? kNumLiteChannels : kNumChannels;
+    const int16_t* spectrum_weight = kLite ? kLiteSpectrumWeight : kSpectrumWeight;
+    const int16_t* noise_data_weights = kLite ? kLiteNoiseDataWeights : kNoiseDataWeights;
+    const int16_t* speech_data_weights = kLite ? kLiteSpeechDataWeights : kSpeechDataWeights;
+    const int16_t* minimum_difference = kLite ? kLiteMinimumDifference : kMinimumDifference;
+    const int16_t* maximum_speech = kLite ? kLiteMaximumSpeech : kMaximumSpeech;
+    const int16_t* maximum_noise = kLite ? kLiteMaximumNoise : kMaximumNoise;
+    const int16_t* maximum_noise_mean = kLite ? kLiteMaximumNoiseMean : kMaximumNoiseMean;
 
     // Set various thresholds based on frame lengths (80, 160 or 240 samples).
     if (frame_length == 80) {
@@ -757,7 +1096,14 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
         totalTest = self->total[2];
     }
 
-    if (total_power > kMinEnergy) {
+#ifdef WEBRTC_VAD_STATS
+    self->low_energy = total_power <= kMinEnergy;
+#endif
+    VadModelUpdate saved;
+    if (kVadBoundedTime) {
+        SaveModelUpdate(self, &saved);
+    }
+    if (total_power > kMinEnergy || kVadBoundedTime) {
         // The signal power of current frame is large enough for processing. The
         // processing consists of two parts:
         // 1) Calculating the likelihood of speech and thereby a VAD decision.
@@ -769,7 +1115,7 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
         //
         // We combine a global LRT with local tests, for each frequency sub-band,
         // here defined as |channel|.
-        for (channel = 0; channel < kNumChannels; channel++) {
+        for (channel = 0; channel < num_channels; channel++) {
             // For each channel we model the probability with a GMM consisting of
             // |kNumGaussians|, with different means and standard deviations depending
             // on H0 or H1.
@@ -781,14 +1127,14 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
                 // Value given in Q27 = Q7 * Q20.
                 tmp1_s32 = WebRtcVad_GaussianProbability(features[channel], self->noise_means[gaussian],
                                                          self->noise_stds[gaussian], &deltaN[gaussian]);
-                noise_probability[k] = kNoiseDataWeights[gaussian] * tmp1_s32;
+                noise_probability[k] = noise_data_weights[gaussian] * tmp1_s32;
                 h0_test += noise_probability[k];  // Q27
 
                 // Probability under H1, that is, probability of frame being speech.
                 // Value given in Q27 = Q7 * Q20.
                 tmp1_s32 = WebRtcVad_GaussianProbability(features[channel], self->speech_means[gaussian],
                                                          self->speech_stds[gaussian], &deltaS[gaussian]);
-                speech_probability[k] = kSpeechDataWeights[gaussian] * tmp1_s32;
+                speech_probability[k] = speech_data_weights[gaussian] * tmp1_s32;
                 h1_test += speech_probability[k];  // Q27
             }
 
@@ -814,10 +1160,13 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
                 shifts_h1 = 31;
             }
             log_likelihood_ratio = shifts_h0 - shifts_h1;
+            if (Trace::kEnabled) {
+                log_likelihood_ratios[channel] = log_likelihood_ratio;
+            }
 
             // Update |sum_log_likelihood_ratios| with spectrum weighting. This is
             // used for the global VAD decision.
-            sum_log_likelihood_ratios += (int32_t)(log_likelihood_ratio * kSpectrumWeight[channel]);
+            sum_log_likelihood_ratios += (int32_t)(log_likelihood_ratio * spectrum_weight[channel]);
 
             // Local VAD decision.
             if ((log_likelihood_ratio * 4) > individualTest) {
@@ -828,11 +1177,17 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
             // hard coded number of Gaussians set to two. Find a way to generalize.
             // Calculate local noise probabilities used later when updating the GMM.
             h0 = (int16_t)(h0_test >> 12);  // Q15
-            if (h0 > 0) {
+            if (kVadBoundedTime) {
+                // Divide unconditionally and select the result.
+                tmp1_s32 = (noise_probability[0] & 0xFFFFF000) << 2;             // Q29
+                tmp_s16 = (int16_t)WebRtcVad_DivW32W16(tmp1_s32, h0 > 0 ? h0 : 1);  // Q14
+                ngprvec[channel] = h0 > 0 ? tmp_s16 : 16384;
+                ngprvec[channel + kNumChannels] = h0 > 0 ? 16384 - tmp_s16 : 0;
+            } else if (h0 > 0) {
                 // High probability of noise. Assign conditional probabilities for each
                 // Gaussian in the GMM.
                 tmp1_s32 = (noise_probability[0] & 0xFFFFF000) << 2;            // Q29
-                ngprvec[channel] = (int16_t)WebRtcSpl_DivW32W16(tmp1_s32, h0);  // Q14
+                ngprvec[channel] = (int16_t)WebRtcVad_DivW32W16(tmp1_s32, h0);  // Q14
                 ngprvec[channel + kNumChannels] = 16384 - ngprvec[channel];
             } else {
                 // Low noise probability. Assign conditional probability 1 to the first
@@ -842,26 +1197,37 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
 
             // Calculate local speech probabilities used later when updating the GMM.
             h1 = (int16_t)(h1_test >> 12);  // Q15
-            if (h1 > 0) {
+            if (kVadBoundedTime) {
+                tmp1_s32 = (speech_probability[0] & 0xFFFFF000) << 2;            // Q29
+                tmp_s16 = (int16_t)WebRtcVad_DivW32W16(tmp1_s32, h1 > 0 ? h1 : 1);  // Q14
+                sgprvec[channel] = h1 > 0 ? tmp_s16 : 0;
+                sgprvec[channel + kNumChannels] = h1 > 0 ? 16384 - tmp_s16 : 0;
+            } else if (h1 > 0) {
                 // High probability of speech. Assign conditional probabilities for each
                 // Gaussian in the GMM. Otherwise use the initialized values, i.e., 0.
                 tmp1_s32 = (speech_probability[0] & 0xFFFFF000) << 2;           // Q29
-                sgprvec[channel] = (int16_t)WebRtcSpl_DivW32W16(tmp1_s32, h1);  // Q14
+                sgprvec[channel] = (int16_t)WebRtcVad_DivW32W16(tmp1_s32, h1);  // Q14
                 sgprvec[channel + kNumChannels] = 16384 - sgprvec[channel];
             }
         }
 
         // Make a global VAD decision.
         vadflag |= (sum_log_likelihood_ratios >= totalTest);
+        if (Trace::kEnabled && total_power > kMinEnergy) {
+            const VadTraceView view = {self,    features,        total_power, log_likelihood_ratios,
+                                       sum_log_likelihood_ratios, vadflag, frame_length};
+            trace.OnLikelihood(view);
+        }
 
         // Update the model parameters.
+        WEBRTC_VAD_PERF_STAGE(kVadPerfUpdate);
         maxspe = 12800;
-        for (channel = 0; channel < kNumChannels; channel++) {
+        for (channel = 0; channel < num_channels; channel++) {
             // Get minimum value in past which is used for long term correction in Q4.
             feature_minimum = WebRtcVad_FindMinimum(self, features[channel], channel);
 
             // Compute the "global" mean, that is the sum of the two means weighted.
-            noise_global_mean = WeightedAverage(&self->noise_means[channel], 0, &kNoiseDataWeights[channel]);
+            noise_global_mean = WeightedAverage(&self->noise_means[channel], 0, &noise_data_weights[channel]);
             tmp1_s16 = (int16_t)(noise_global_mean >> 6);  // Q8
 
             for (k = 0; k < kNumGaussians; k++) {
@@ -896,7 +1262,7 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
                 if (nmk3 < tmp_s16) {
                     nmk3 = tmp_s16;
                 }
-                tmp_s16 = (int16_t)((72 + k - channel) << 7);
+                tmp_s16 = (int16_t)((maximum_noise_mean[channel] + k) << 7);
                 if (nmk3 > tmp_s16) {
                     nmk3 = tmp_s16;
                 }
@@ -940,9 +1306,9 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
 
                     // 0.1 * Q20 / Q7 = Q13.
                     if (tmp2_s32 > 0) {
-                        tmp_s16 = (int16_t)WebRtcSpl_DivW32W16(tmp2_s32, ssk * 10);
+                        tmp_s16 = (int16_t)WebRtcVad_DivW32W16(tmp2_s32, ssk * 10);
                     } else {
-                        tmp_s16 = (int16_t)WebRtcSpl_DivW32W16(-tmp2_s32, ssk * 10);
+                        tmp_s16 = (int16_t)WebRtcVad_DivW32W16(-tmp2_s32, ssk * 10);
                         tmp_s16 = -tmp_s16;
                     }
                     // Divide by 4 giving an update factor of 0.025 (= 0.1 / 4).
@@ -972,9 +1338,9 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
 
                     // Q20 / Q7 = Q13.
                     if (tmp1_s32 > 0) {
-                        tmp_s16 = (int16_t)WebRtcSpl_DivW32W16(tmp1_s32, nsk);
+                        tmp_s16 = (int16_t)WebRtcVad_DivW32W16(tmp1_s32, nsk);
                     } else {
-                        tmp_s16 = (int16_t)WebRtcSpl_DivW32W16(-tmp1_s32, nsk);
+                        tmp_s16 = (int16_t)WebRtcVad_DivW32W16(-tmp1_s32, nsk);
                         tmp_s16 = -tmp_s16;
                     }
                     tmp_s16 += 32;        // Rounding
@@ -988,16 +1354,16 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
 
             // Separate models if they are too close.
             // |noise_global_mean| in Q14 (= Q7 * Q7).
-            noise_global_mean = WeightedAverage(&self->noise_means[channel], 0, &kNoiseDataWeights[channel]);
+            noise_global_mean = WeightedAverage(&self->noise_means[channel], 0, &noise_data_weights[channel]);
 
             // |speech_global_mean| in Q14 (= Q7 * Q7).
-            speech_global_mean = WeightedAverage(&self->speech_means[channel], 0, &kSpeechDataWeights[channel]);
+            speech_global_mean = WeightedAverage(&self->speech_means[channel], 0, &speech_data_weights[channel]);
 
             // |diff| = "global" speech mean - "global" noise mean.
             // (Q14 >> 9) - (Q14 >> 9) = Q5.
             diff = (int16_t)(speech_global_mean >> 9) - (int16_t)(noise_global_mean >> 9);
-            if (diff < kMinimumDifference[channel]) {
-                tmp_s16 = kMinimumDifference[channel] - diff;
+            if (diff < minimum_difference[channel]) {
+                tmp_s16 = minimum_difference[channel] - diff;
 
                 // |tmp1_s16| = ~0.8 * (kMinimumDifference - diff) in Q7.
                 // |tmp2_s16| = ~0.2 * (kMinimumDifference - diff) in Q7.
@@ -1008,17 +1374,17 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
                 // |speech_global_mean|. Note that |self->speech_means[channel]| is
                 // changed after the call.
                 speech_global_mean =
-                    WeightedAverage(&self->speech_means[channel], tmp1_s16, &kSpeechDataWeights[channel]);
+                    WeightedAverage(&self->speech_means[channel], tmp1_s16, &speech_data_weights[channel]);
 
                 // Move Gaussian means for noise model by -|tmp2_s16| and update
                 // |noise_global_mean|. Note that |self->noise_means[channel]| is
                 // changed after the call.
                 noise_global_mean =
-                    WeightedAverage(&self->noise_means[channel], -tmp2_s16, &kNoiseDataWeights[channel]);
+                    WeightedAverage(&self->noise_means[channel], -tmp2_s16, &noise_data_weights[channel]);
             }
 
             // Control that the speech & noise means do not drift to much.
-            maxspe = kMaximumSpeech[channel];
+            maxspe = maximum_speech[channel];
             tmp2_s16 = (int16_t)(speech_global_mean >> 7);
             if (tmp2_s16 > maxspe) {
                 // Upper limit of speech model.
@@ -1030,8 +1396,8 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
             }
 
             tmp2_s16 = (int16_t)(noise_global_mean >> 7);
-            if (tmp2_s16 > kMaximumNoise[channel]) {
-                tmp2_s16 -= kMaximumNoise[channel];
+            if (tmp2_s16 > maximum_noise[channel]) {
+                tmp2_s16 -= maximum_noise[channel];
 
                 for (k = 0; k < kNumGaussians; k++) {
                     self->noise_means[channel + k * kNumChannels] -= tmp2_s16;
@@ -1040,6 +1406,12 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
         }
         self->frame_counter++;
     }
+    if (kVadBoundedTime) {
+        const int scored = total_power > kMinEnergy;
+        MaskModelUpdate(self, &saved, scored);
+        vadflag = (int16_t)(vadflag & -scored);
+        sum_log_likelihood_ratios &= -scored;
+    }
 
     // Smooth with respect to transition hysteresis.
     if (!vadflag) {
@@ -1057,16 +1429,26 @@ static int16_t GmmProbability(VadInstT* self, int16_t* features, int16_t total_p
             self->over_hang = overhead1;
         }
     }
+    if (Trace::kEnabled) {
+        const VadTraceView view = {self,
+                                   features,
+                                   total_power,
+                                   total_power > kMinEnergy ? log_likelihood_ratios : NULL,
+                                   sum_log_likelihood_ratios,
+                                   vadflag,
+                                   frame_length};
+        trace.OnFrame(view);
+    }
     return vadflag;
 }
 
-// Initialize the VAD. Set aggressiveness mode to default value.
-inline int WebRtcVad_InitCore(VadInstT* self) {
+// Initializes the processing state of the model selected by |self->lite|.
+static void InitModel(VadInstT* self) {
     int i;
-
-    if (self == NULL) {
-        return -1;
-    }
+    const int16_t* noise_means = self->lite ? kLiteNoiseDataMeans : kNoiseDataMeans;
+    const int16_t* speech_means = self->lite ? kLiteSpeechDataMeans : kSpeechDataMeans;
+    const int16_t* noise_stds = self->lite ? kLiteNoiseDataStds : kNoiseDataStds;
+    const int16_t* speech_stds = self->lite ? kLiteSpeechDataStds : kSpeechDataStds;
 
     // Initialization of general struct variables.
     self->vad = 1;  // Speech active (=1).
@@ -1082,10 +1464,10 @@ inline int WebRtcVad_InitCore(VadInstT* self) {
 
     // Read initial PDF parameters.
     for (i = 0; i < kTableSize; i++) {
-        self->noise_means[i] = kNoiseDataMeans[i];
-        self->speech_means[i] = kSpeechDataMeans[i];
-        self->noise_stds[i] = kNoiseDataStds[i];
-        self->speech_stds[i] = kSpeechDataStds[i];
+        self->noise_means[i] = noise_means[i];
+        self->speech_means[i] = speech_means[i];
+        self->noise_stds[i] = noise_stds[i];
+        self->speech_stds[i] = speech_stds[i];
     }
 
     // Initialize Index and Minimum value vectors.
@@ -1105,12 +1487,32 @@ inline int WebRtcVad_InitCore(VadInstT* self) {
     for (i = 0; i < kNumChannels; i++) {
         self->mean_value[i] = 1600;
     }
+}
+
+// Initialize the VAD. Set aggressiveness mode to default value.
+inline int WebRtcVad_InitCore(VadInstT* self) {
+    if (self == NULL) {
+        return -1;
+    }
+
+    // The full model by default.
+    self->lite = 0;
+    InitModel(self);
 
     // Set aggressiveness mode to default (=|kDefaultMode|).
     if (WebRtcVad_set_mode_core(self, kDefaultMode) != 0) {
         return -1;
     }
 
+    // The cascade pre-screen is off by default.
+    self->cascade = 0;
+    self->cascade_floor = kCascadeLevelMax;
+
+#ifdef WEBRTC_VAD_STATS
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->low_energy = 0;
+#endif
+
     self->init_flag = kInitCheck;
 
     return 0;
@@ -1157,10 +1559,134 @@ inline int WebRtcVad_set_mode_core(VadInstT* self, int mode) {
     return return_value;
 }
 
+inline int WebRtcVad_set_lite_core(VadInstT* self, int lite) {
+    if (lite != 0 && lite != 1) {
+        return -1;
+    }
+    self->lite = (int16_t)lite;
+    InitModel(self);
+    return 0;
+}
+
+// Frames after which the ages of the minima, int16_t, come back around.
+static const size_t kMinimaAgeCycle = 65536;
+
+// One frame of WebRtcVad_FindMinimum() in which no new minimum is found: every
+// slot ages, the fillers (age above 100) too, until its age wraps around to
+// 100 and it is dropped. The slot shifted into a dropped one is not aged in
+// that frame.
+static inline void WebRtcVad_AgeMinimaFrame(int16_t* age, int16_t* smallest_values) {
+    int i, j;
+
+    for (i = 0; i < 16; i++) {
+        if (age[i] != 100) {
+            age[i]++;
+        } else {
+            for (j = i; j < 15; j++) {
+                smallest_values[j] = smallest_values[j + 1];
+                age[j] = age[j + 1];
+            }
+            age[15] = 101;
+            smallest_values[15] = 10000;
+        }
+    }
+}
+
+// WebRtcVad_AgeMinimaFrame() |num_frames| times. Frames in which no slot is
+// at age 100 only add one to every age, so those runs are taken in one step.
+static inline void WebRtcVad_AgeMinimaFrames(int16_t* age, int16_t* smallest_values, size_t num_frames) {
+    int i;
+    size_t run;
+
+    while (num_frames > 0) {
+        run = kMinimaAgeCycle;
+        for (i = 0; i < 16; i++) {
+            // Frames until slot i is at age 100, modulo the wrap around.
+            if ((uint16_t)(100 - age[i]) < run) {
+                run = (uint16_t)(100 - age[i]);
+            }
+        }
+        if (run == 0) {
+            WebRtcVad_AgeMinimaFrame(age, smallest_values);
+            num_frames--;
+            continue;
+        }
+        if (run > num_frames) {
+            run = num_frames;
+        }
+        for (i = 0; i < 16; i++) {
+            age[i] = (int16_t)(age[i] + (int)run);
+        }
+        num_frames -= run;
+    }
+}
+
+// Ages the 16 minima of a channel by |num_frames| frames in which no new
+// minimum is found, with the same result as that many calls of
+// WebRtcVad_FindMinimum(), fillers and the ages of 0 after
+// WebRtcVad_InitCore() included. Each slot is dropped at most once per
+// kMinimaAgeCycle frames, so a cycle takes a few dozen steps; and once a
+// cycle leaves the minima as it found them, which happens within a few dozen
+// cycles, the rest of the gap is taken modulo kMinimaAgeCycle.
+static inline void WebRtcVad_AgeMinima(int16_t* age, int16_t* smallest_values, size_t num_frames) {
+    int16_t cycle_age[16];
+    int16_t cycle_values[16];
+
+    while (num_frames > kMinimaAgeCycle) {
+        memcpy(cycle_age, age, sizeof(cycle_age));
+        memcpy(cycle_values, smallest_values, sizeof(cycle_values));
+        WebRtcVad_AgeMinimaFrames(age, smallest_values, kMinimaAgeCycle);
+        num_frames -= kMinimaAgeCycle;
+        if (memcmp(cycle_age, age, sizeof(cycle_age)) == 0 &&
+            memcmp(cycle_values, smallest_values, sizeof(cycle_values)) == 0) {
+            num_frames %= kMinimaAgeCycle;
+        }
+    }
+    WebRtcVad_AgeMinimaFrames(age, smallest_values, num_frames);
+}
+
+inline int WebRtcVad_AdvanceGapCore(VadInstT* self, size_t num_frames) {
+    int channel;
+    int vad = 0;
+
+    if (num_frames == 0) {
+        return 0;
+    }
+
+    for (channel = 0; channel < kNumChannels; channel++) {
+        WebRtcVad_AgeMinima(&self->index_vector[channel << 4], &self->low_value_vector[channel << 4], num_frames);
+    }
+    if (num_frames < (size_t)(WEBRTC_SPL_WORD32_MAX - self->frame_counter)) {
+        self->frame_counter += (int32_t)num_frames;
+    } else {
+        self->frame_counter = WEBRTC_SPL_WORD32_MAX;
+    }
+
+    // Frame i of the gap, from 1, is in the hangover while
+    // |over_hang| - (i - 1) > 0.
+    if ((size_t)self->over_hang >= num_frames) {
+        vad = 2 + self->over_hang - (int)(num_frames - 1);
+        self->over_hang = (int16_t)(self->over_hang - num_frames);
+    } else {
+        self->over_hang = 0;
+    }
+    self->num_of_speech = 0;
+    self->vad = vad;
+
+    memset(self->downsampling_filter_states, 0, sizeof(self->downsampling_filter_states));
+    WebRtcSpl_ResetResample48khzTo8khz(&self->state_48_to_8);
+    memset(self->upper_state, 0, sizeof(self->upper_state));
+    memset(self->lower_state, 0, sizeof(self->lower_state));
+    memset(self->hp_filter_state, 0, sizeof(self->hp_filter_state));
+    return vad;
+}
+
 // Calculate VAD decision by first extracting feature values and then calculate
 // probability for both speech and background noise.
 
-inline int WebRtcVad_CalcVad48khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+template <typename Trace>
+inline int WebRtcVad_CalcVad48khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length,
+                                        Trace& trace) {
     int vad;
     size_t i;
     int16_t speech_nb[240];  // 30 ms in 8 kHz.
@@ -1171,17 +1697,20 @@ inline int WebRtcVad_CalcVad48khz(VadInstT* inst, const int16_t* speech_frame, s
     const size_t kFrameLen10ms8khz = 80;
     size_t num_10ms_frames = frame_length / kFrameLen10ms48khz;
 
+    WEBRTC_VAD_PERF_STAGE(kVadPerfResample);
     for (i = 0; i < num_10ms_frames; i++) {
         WebRtcSpl_Resample48khzTo8khz(speech_frame, &speech_nb[i * kFrameLen10ms8khz], &inst->state_48_to_8, tmp_mem);
     }
 
     // Do VAD on an 8 kHz signal
-    vad = WebRtcVad_CalcVad8khz(inst, speech_nb, frame_length / 6);
+    vad = WebRtcVad_CalcVad8khzTraced(inst, speech_nb, frame_length / 6, trace);
 
     return vad;
 }
 
-inline int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+template <typename Trace>
+inline int WebRtcVad_CalcVad32khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length,
+                                        Trace& trace) {
     size_t len;
     int vad;
     int16_t speechWB[480];  // Downsampled speech frame: 960 samples (30ms in SWB)
@@ -1189,6 +1718,7 @@ inline int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame, s
 
 
     // Downsample signal 32->16->8 before doing VAD
+    WEBRTC_VAD_PERF_STAGE(kVadPerfResample);
     WebRtcVad_Downsampling(speech_frame, speechWB, &(inst->downsampling_filter_states[2]), frame_length);
     len = frame_length / 2;
 
@@ -1196,35 +1726,128 @@ inline int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame, s
     len /= 2;
 
     // Do VAD on an 8 kHz signal
-    vad = WebRtcVad_CalcVad8khz(inst, speechNB, len);
+    vad = WebRtcVad_CalcVad8khzTraced(inst, speechNB, len, trace);
 
     return vad;
 }
 
-inline int WebRtcVad_CalcVad16khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+template <typename Trace>
+inline int WebRtcVad_CalcVad16khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length,
+                                        Trace& trace) {
     size_t len;
     int vad;
     int16_t speechNB[240];  // Downsampled speech frame: 480 samples (30ms in WB)
 
     // Wideband: Downsample signal before doing VAD
+    WEBRTC_VAD_PERF_STAGE(kVadPerfResample);
     WebRtcVad_Downsampling(speech_frame, speechNB, inst->downsampling_filter_states, frame_length);
 
     len = frame_length / 2;
-    vad = WebRtcVad_CalcVad8khz(inst, speechNB, len);
+    vad = WebRtcVad_CalcVad8khzTraced(inst, speechNB, len, trace);
 
     return vad;
 }
 
-inline int WebRtcVad_CalcVad8khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+template <typename Trace>
+inline int WebRtcVad_CalcVad8khzTraced(VadInstT* inst, const int16_t* speech_frame, size_t frame_length,
+                                       Trace& trace) {
     int16_t feature_vector[kNumChannels], total_power;
 
     // Get power in the bands
-    total_power = WebRtcVad_CalculateFeatures(inst, speech_frame, frame_length, feature_vector);
+    WEBRTC_VAD_PERF_STAGE(kVadPerfFeatures);
+    if (inst->lite) {
+        memset(feature_vector, 0, sizeof(feature_vector));
+        total_power = WebRtcVad_CalculateLiteFeatures(inst, speech_frame, frame_length, feature_vector);
+    } else {
+        total_power = WebRtcVad_CalculateFeatures(inst, speech_frame, frame_length, feature_vector);
+    }
+    if (Trace::kEnabled) {
+        const VadTraceView view = {inst, feature_vector, total_power, NULL, 0, 0, frame_length};
+        trace.OnFeatures(view);
+    }
 
     // Make a VAD
-    inst->vad = GmmProbability(inst, feature_vector, total_power, frame_length);
+    WEBRTC_VAD_PERF_STAGE(kVadPerfLikelihood);
+    if (inst->lite) {
+        inst->vad = GmmProbabilityTraced<true>(inst, feature_vector, total_power, frame_length, trace);
+    } else {
+        inst->vad = GmmProbabilityTraced<false>(inst, feature_vector, total_power, frame_length, trace);
+    }
+    WEBRTC_VAD_PERF_END();
 
     return inst->vad;
 }
+
+inline int WebRtcVad_CascadeGate(VadInstT* self, const int16_t* frame, size_t frame_length) {
+    int32_t peak = 0;
+    uint32_t energy = 0;
+    int32_t level;
+    size_t i;
+
+    // Loud frames wrap |energy| around, but fail on |peak| first.
+    for (i = 0; i < frame_length; i++) {
+        int32_t sample = frame[i];
+        int32_t magnitude = sample < 0 ? -sample : sample;
+        peak = magnitude > peak ? magnitude : peak;
+        energy += (uint32_t)(sample * sample);
+    }
+    if (peak > kCascadePeakMax) {
+        return 0;
+    }
+    level = (int32_t)((energy << 4) / frame_length);
+
+    int gated = level <= kCascadeLevelMin || (level <= kCascadeLevelMax && level <= 2 * self->cascade_floor);
+    if (level < self->cascade_floor) {
+        self->cascade_floor = level;
+    } else {
+        self->cascade_floor +=
+            (level - self->cascade_floor + (1 << kCascadeFloorRiseShift) - 1) >> kCascadeFloorRiseShift;
+    }
+    return gated;
+}
+
+template <typename Trace>
+inline int WebRtcVad_CalcVadGatedTraced(VadInstT* self, size_t frame_length, Trace& trace) {
+    int16_t feature_vector[kNumChannels];
+
+    memset(self->downsampling_filter_states, 0, sizeof(self->downsampling_filter_states));
+    WebRtcSpl_ResetResample48khzTo8khz(&self->state_48_to_8);
+    memset(self->upper_state, 0, sizeof(self->upper_state));
+    memset(self->lower_state, 0, sizeof(self->lower_state));
+    memset(self->hp_filter_state, 0, sizeof(self->hp_filter_state));
+
+    // WebRtcVad_CalculateFeatures() of digital silence.
+    WebRtcVad_SilenceFeatures(self, feature_vector);
+    if (Trace::kEnabled) {
+        const VadTraceView view = {self, feature_vector, 0, NULL, 0, 0, frame_length};
+        trace.OnFeatures(view);
+    }
+    if (self->lite) {
+        self->vad = GmmProbabilityTraced<true>(self, feature_vector, 0, frame_length, trace);
+    } else {
+        self->vad = GmmProbabilityTraced<false>(self, feature_vector, 0, frame_length, trace);
+    }
+    return self->vad;
+}
+
+inline int WebRtcVad_CalcVad48khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+    VadNoTrace trace;
+    return WebRtcVad_CalcVad48khzTraced(inst, speech_frame, frame_length, trace);
+}
+
+inline int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+    VadNoTrace trace;
+    return WebRtcVad_CalcVad32khzTraced(inst, speech_frame, frame_length, trace);
+}
+
+inline int WebRtcVad_CalcVad16khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+    VadNoTrace trace;
+    return WebRtcVad_CalcVad16khzTraced(inst, speech_frame, frame_length, trace);
+}
+
+inline int WebRtcVad_CalcVad8khz(VadInstT* inst, const int16_t* speech_frame, size_t frame_length) {
+    VadNoTrace trace;
+    return WebRtcVad_CalcVad8khzTraced(inst, speech_frame, frame_length, trace);
+}
 }  // namespace webrtc
 #endif
\ No newline at end of file
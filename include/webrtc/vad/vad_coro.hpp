@@ -0,0 +1,200 @@
+#ifndef WEBRTC_VAD_VAD_CORO_HPP
+#define WEBRTC_VAD_VAD_CORO_HPP
+// Coroutine interface to Vad.
+#if __cplusplus < 202002L
+#error "webrtc/vad/vad_coro.hpp requires C++20 (-std=c++20)."
+#endif
+#include <stdint.h>
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "webrtc/vad/vad.hpp"
+
+namespace webrtc {
+// An asynchronous generator: a coroutine that may co_await (e.g., on an audio
+// source) and co_yield values to a consumer, which in turn awaits Next().
+// Control passes between the two by symmetric transfer, so neither side
+// needs a thread of its own.
+//
+//   while (const T* value = co_await generator.Next()) { ... }
+//
+// |*value| is valid until the next call to Next().
+template <typename T>
+class VadAsyncGenerator {
+public:
+    struct promise_type;
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    struct promise_type {
+        std::optional<T> value;
+        std::coroutine_handle<> consumer;
+        std::exception_ptr exception;
+
+        // Resumes the consumer waiting in Next().
+        struct ResumeConsumer {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept { return handle.promise().consumer; }
+            void await_resume() noexcept {}
+        };
+
+        VadAsyncGenerator get_return_object() { return VadAsyncGenerator(Handle::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        ResumeConsumer final_suspend() noexcept {
+            value.reset();
+            return {};
+        }
+        ResumeConsumer yield_value(T next) {
+            value.emplace(std::move(next));
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    struct NextAwaiter {
+        Handle handle;
+
+        bool await_ready() noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+            handle.promise().consumer = consumer;
+            return handle;
+        }
+        // Returns nullptr once the generator has finished.
+        const T* await_resume() {
+            if (!handle) {
+                return nullptr;
+            }
+            if (handle.promise().exception) {
+                std::rethrow_exception(handle.promise().exception);
+            }
+            return handle.done() ? nullptr : &*handle.promise().value;
+        }
+    };
+
+    VadAsyncGenerator(VadAsyncGenerator&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    VadAsyncGenerator& operator=(VadAsyncGenerator&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~VadAsyncGenerator() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    NextAwaiter Next() { return NextAwaiter{handle_}; }
+
+private:
+    explicit VadAsyncGenerator(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+struct VadFrameEvent {
+    uint64_t frame;  // Index of the frame in the stream.
+    Vad::Activity activity;
+};
+
+struct VadSegmentEvent {
+    enum Type { kSpeechStart, kSpeechEnd };
+    Type type;
+    uint64_t frame;  // First frame of speech, or first frame after it.
+};
+
+// Runs |vad| over the audio produced by |source| and yields the decisions of
+// all whole frames available after each read, as one batch. |source| must
+// provide
+//
+//   Awaitable<std::span<const int16_t>> Read();
+//
+// which completes with the next chunk of samples, of any length, or with an
+// empty span at the end of the stream. Samples of a partial frame are carried
+// over to the next chunk. The coroutine suspends only in Read() and when
+// handing over a batch, so a burst of audio is drained in one resume. |vad|
+// and |source| must outlive the generator. If the VAD does not take
+// |frame_length| samples at |sample_rate_hz|, the generator yields a single
+// Vad::kError event and ends without reading |source|.
+template <typename Source>
+VadAsyncGenerator<std::span<const VadFrameEvent>> VadDecisions(Vad& vad, Source& source, int sample_rate_hz,
+                                                               size_t frame_length) {
+    std::vector<int16_t> carry;
+    std::vector<VadFrameEvent> events;
+    uint64_t frame = 0;
+
+    if (WebRtcVad_ValidRateAndFrameLength(sample_rate_hz, frame_length) != 0) {
+        events.push_back({0, Vad::kError});
+        co_yield std::span<const VadFrameEvent>(events);
+        co_return;
+    }
+    carry.reserve(frame_length);
+    while (true) {
+        std::span<const int16_t> chunk = co_await source.Read();
+        if (chunk.empty()) {
+            break;
+        }
+
+        events.clear();
+        if (!carry.empty()) {
+            size_t take = std::min(frame_length - carry.size(), chunk.size());
+            carry.insert(carry.end(), chunk.begin(), chunk.begin() + take);
+            chunk = chunk.subspan(take);
+            if (carry.size() == frame_length) {
+                events.push_back({frame++, vad.IsSpeech(carry.data(), frame_length, sample_rate_hz)});
+                carry.clear();
+            }
+        }
+        while (chunk.size() >= frame_length) {
+            events.push_back({frame++, vad.IsSpeech(chunk.data(), frame_length, sample_rate_hz)});
+            chunk = chunk.subspan(frame_length);
+        }
+        carry.insert(carry.end(), chunk.begin(), chunk.end());
+
+        if (!events.empty()) {
+            co_yield std::span<const VadFrameEvent>(events);
+        }
+    }
+}
+
+// Like VadDecisions(), but yields speech start and end events only. An open
+// speech segment is closed at the end of the stream.
+template <typename Source>
+VadAsyncGenerator<std::span<const VadSegmentEvent>> VadSegments(Vad& vad, Source& source, int sample_rate_hz,
+                                                                 size_t frame_length) {
+    VadAsyncGenerator<std::span<const VadFrameEvent>> decisions =
+        VadDecisions(vad, source, sample_rate_hz, frame_length);
+    std::vector<VadSegmentEvent> events;
+    bool in_speech = false;
+    uint64_t frames = 0;
+
+    while (const std::span<const VadFrameEvent>* batch = co_await decisions.Next()) {
+        events.clear();
+        for (const VadFrameEvent& event : *batch) {
+            bool speech = event.activity == Vad::kActive;
+            if (speech != in_speech) {
+                events.push_back({speech ? VadSegmentEvent::kSpeechStart : VadSegmentEvent::kSpeechEnd, event.frame});
+                in_speech = speech;
+            }
+            frames = event.frame + 1;
+        }
+        if (!events.empty()) {
+            co_yield std::span<const VadSegmentEvent>(events);
+        }
+    }
+    if (in_speech) {
+        events.assign(1, {VadSegmentEvent::kSpeechEnd, frames});
+        co_yield std::span<const VadSegmentEvent>(events);
+    }
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,638 @@
+#ifndef WEBRTC_VAD_VAD_EXECUTOR_HPP
+#define WEBRTC_VAD_VAD_EXECUTOR_HPP
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <semaphore.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "webrtc/vad/vad.hpp"
+
+namespace webrtc {
+// Runs many VAD streams on a fixed pool of worker threads.
+//
+// Every stream has a home worker. Frames submitted to a stream are queued on
+// the stream itself, and the stream (not the frame) is scheduled on its home
+// worker when it goes from idle to busy. A worker processes a stream's frames
+// in submission order, so a stream is only ever run by one worker at a time
+// and its decisions are reported in order. Idle workers steal streams from
+// the back of busy workers' deques; a stolen stream moves home to the thief,
+// which keeps each instance hot in one core's cache.
+//
+// Submit() never blocks: it copies the frame into a buffer recycled from the
+// stream's free list, links it with one atomic exchange and, only on the idle
+// to busy transition, pushes the stream onto the home worker's lock-free inbox
+// and, if the worker sleeps, posts its semaphore. Buffers are only allocated
+// while more frames of a stream are in flight than ever before.
+//
+// Decisions are delivered through the stream's callback, on the worker
+// thread that processed the frame.
+//
+// With SetOverloadBudget(), an overload controller trades the quality of
+// lower-priority streams for bounded latency when the workers fall behind:
+// see Degradation for the steps a stream goes through.
+class VadExecutor {
+    // Frames hold up to 30 ms at 48 kHz.
+    static const size_t kMaxFrameSamples = 1440;
+
+    struct FrameLink {
+        std::atomic<FrameLink*> next{nullptr};
+    };
+
+    struct Frame : FrameLink {
+        uint64_t sequence = 0;
+        size_t num_samples = 0;
+        Frame* next_free = nullptr;  // Link in a stream's free lists.
+        int16_t audio[kMaxFrameSamples];
+    };
+
+public:
+    // |sequence| counts the frames submitted to |stream|, starting at 0.
+    typedef std::function<void(uint64_t sequence, Vad::Activity activity)> Callback;
+
+    class Stream;
+
+    // Steps of degradation under overload. Each step includes the previous
+    // ones.
+    enum Degradation {
+        kFullQuality = 0,  // Every frame is processed as submitted.
+        kLongFrames = 1,   // Queued frames are merged into calls of up to 30 ms.
+        kLite = 2,         // Frames go to a lite instance with the cascade on.
+        kHold = 3          // Frames are not processed, the last decision is repeated.
+    };
+
+    // Stream priorities are 0 (degraded first) to kNumPriorities - 1.
+    static const int kNumPriorities = 4;
+    // The overload level at which every stream holds its decisions.
+    static const int kMaxOverloadLevel = kNumPriorities * kHold;
+    // Ticks under half the budget before the overload level falls by one.
+    static const uint64_t kRecoveryTicks = 50;
+
+    // Creates |num_workers| worker threads, at least one. If |pin_workers| is
+    // set, worker i is pinned to CPU i (Linux only).
+    explicit VadExecutor(size_t num_workers, bool pin_workers = false)
+        : stop_(false),
+          outstanding_(0),
+          next_home_(0),
+          tick_ns_(0),
+          budget_ns_(0),
+          next_tick_ns_(0),
+          busy_ns_(0),
+          overload_level_(0),
+          calm_ticks_(0) {
+        if (num_workers == 0) {
+            num_workers = 1;
+        }
+        for (size_t i = 0; i < num_workers; i++) {
+            workers_.emplace_back(new Worker());
+        }
+        for (size_t i = 0; i < num_workers; i++) {
+            workers_[i]->thread = std::thread(&VadExecutor::Run, this, i);
+#ifdef __linux__
+            if (pin_workers) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(i % CPU_SETSIZE, &cpus);
+                pthread_setaffinity_np(workers_[i]->thread.native_handle(), sizeof(cpus), &cpus);
+            }
+#else
+            (void)pin_workers;
+#endif
+        }
+    }
+
+    // Processes all submitted frames, then joins the workers.
+    ~VadExecutor() {
+        Drain();
+        stop_.store(true);
+        for (auto& worker : workers_) {
+            sem_post(&worker->wakeup);
+        }
+        for (auto& worker : workers_) {
+            worker->thread.join();
+        }
+    }
+
+    VadExecutor(const VadExecutor&) = delete;
+    VadExecutor& operator=(const VadExecutor&) = delete;
+
+    size_t num_workers() const { return workers_.size(); }
+
+    // Adds a stream of |sample_rate_hz| audio with |priority|, see
+    // kNumPriorities. Returns nullptr if the priority is out of range or the
+    // VAD could not be initialized. The stream is owned by the executor.
+    Stream* AddStream(Vad::Aggressiveness aggressiveness, int sample_rate_hz, Callback callback, int priority = 0) {
+        if (priority < 0 || priority >= kNumPriorities) {
+            return nullptr;
+        }
+        std::unique_ptr<Stream> stream(new Stream(aggressiveness, sample_rate_hz, std::move(callback), priority));
+        if (!stream->vad_.Init()) {
+            return nullptr;
+        }
+        stream->home_.store(next_home_.fetch_add(1) % workers_.size());
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        streams_.push_back(std::move(stream));
+        return streams_.back().get();
+    }
+
+    // Waits until all frames of |stream| have been processed and destroys it.
+    // No frames may be submitted to |stream| concurrently.
+    void RemoveStream(Stream* stream) {
+        while (stream->pending_.load() != 0) {
+            std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        for (auto it = streams_.begin(); it != streams_.end(); ++it) {
+            if (it->get() == stream) {
+                streams_.erase(it);
+                return;
+            }
+        }
+    }
+
+    // Queues a copy of |audio| for processing. Frames of one stream must be
+    // submitted by one thread at a time, or ordering between threads is
+    // arbitrary. Returns false if |num_samples| is not a valid frame length
+    // for the stream's sample rate.
+    bool Submit(Stream* stream, const int16_t* audio, size_t num_samples) {
+        if (audio == nullptr || WebRtcVad_ValidRateAndFrameLength(stream->sample_rate_hz_, num_samples) != 0) {
+            return false;
+        }
+        Frame* frame = stream->Allocate();
+        memcpy(frame->audio, audio, num_samples * sizeof(int16_t));
+        frame->num_samples = num_samples;
+        frame->sequence = stream->next_sequence_++;
+
+        outstanding_.fetch_add(1);
+        stream->Push(frame);
+        // |pending_| is only incremented after the frame is linked, so a
+        // worker that observes a non-zero count always finds a frame.
+        if (stream->pending_.fetch_add(1) == 0) {
+            Schedule(stream);
+        }
+        return true;
+    }
+
+    // Blocks until every frame submitted so far has been processed.
+    void Drain() {
+        std::unique_lock<std::mutex> lock(drain_mutex_);
+        drained_.wait(lock, [this] { return outstanding_.load() == 0; });
+    }
+
+    // Enables the overload controller. Every |tick_ns| of wall time, the time
+    // the workers spent processing frames in the tick is compared with
+    // |budget_ns|, which should be below num_workers() * |tick_ns| since a
+    // saturated pool cannot spend more. Over budget, the overload level rises
+    // by one per tick; at level L a stream of priority P is degraded by
+    // L - kHold * P steps, so every priority goes through all steps before
+    // the next one is touched. Under half the budget for kRecoveryTicks ticks
+    // in a row, the level falls by one. A |tick_ns| of 0 disables the
+    // controller and restores full quality.
+    void SetOverloadBudget(uint64_t tick_ns, uint64_t budget_ns) {
+        std::lock_guard<std::mutex> lock(overload_mutex_);
+        budget_ns_.store(budget_ns);
+        next_tick_ns_.store(Now() + tick_ns);
+        busy_ns_.store(0);
+        calm_ticks_ = 0;
+        if (tick_ns == 0) {
+            overload_level_.store(0);
+        }
+        tick_ns_.store(tick_ns);
+    }
+
+    // Current overload level, 0 (no degradation) to kMaxOverloadLevel.
+    int overload_level() const { return overload_level_.load(std::memory_order_relaxed); }
+
+    class Stream {
+    public:
+        ~Stream() {
+            FreeList(free_);
+            FreeList(returned_.load());
+        }
+
+        int sample_rate_hz() const { return sample_rate_hz_; }
+        int priority() const { return priority_; }
+        // The Degradation applied to the stream's most recent frames.
+        Degradation degradation() const { return (Degradation)degradation_.load(std::memory_order_relaxed); }
+
+    private:
+        friend class VadExecutor;
+
+        Stream(Vad::Aggressiveness aggressiveness, int sample_rate_hz, Callback callback, int priority)
+            : vad_(aggressiveness),
+              aggressiveness_(aggressiveness),
+              sample_rate_hz_(sample_rate_hz),
+              priority_(priority),
+              degradation_(kFullQuality),
+              last_activity_(Vad::kPassive),
+              callback_(std::move(callback)),
+              head_(&stub_),
+              tail_(&stub_),
+              pending_(0),
+              home_(0),
+              next_sequence_(0),
+              next_scheduled_(nullptr),
+              free_(nullptr),
+              returned_(nullptr),
+              vad_gap_(0),
+              lite_gap_(0) {}
+
+        static void FreeList(Frame* frame) {
+            while (frame != nullptr) {
+                Frame* next = frame->next_free;
+                delete frame;
+                frame = next;
+            }
+        }
+
+        // Takes a buffer for a frame, on the submitting thread. The frames
+        // returned by the worker are taken over all at once with an exchange,
+        // so neither side ever pops a shared list (no ABA).
+        Frame* Allocate() {
+            if (free_ == nullptr) {
+                free_ = returned_.exchange(nullptr, std::memory_order_acquire);
+                if (free_ == nullptr) {
+                    return new Frame;
+                }
+            }
+            Frame* frame = free_;
+            free_ = frame->next_free;
+            return frame;
+        }
+
+        // Hands a processed frame back to the submitting side, on the worker.
+        void Recycle(Frame* frame) {
+            Frame* top = returned_.load(std::memory_order_relaxed);
+            do {
+                frame->next_free = top;
+            } while (!returned_.compare_exchange_weak(top, frame, std::memory_order_release,
+                                                      std::memory_order_relaxed));
+        }
+
+        // Intrusive multi-producer single-consumer queue (D. Vyukov). Push()
+        // is wait-free, Pop() is only called by the worker owning the stream.
+        void Push(FrameLink* frame) {
+            frame->next.store(nullptr, std::memory_order_relaxed);
+            FrameLink* prev = head_.exchange(frame, std::memory_order_acq_rel);
+            prev->next.store(frame, std::memory_order_release);
+        }
+
+        // Returns nullptr if a concurrent Push() has not completed yet.
+        Frame* Pop() {
+            FrameLink* tail = tail_;
+            FrameLink* next = tail->next.load(std::memory_order_acquire);
+            if (tail == &stub_) {
+                if (next == nullptr) {
+                    return nullptr;
+                }
+                tail_ = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr) {
+                tail_ = next;
+                return static_cast<Frame*>(tail);
+            }
+            if (tail != head_.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            Push(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                tail_ = next;
+                return static_cast<Frame*>(tail);
+            }
+            return nullptr;
+        }
+
+        // The instance used from kLite on, created on first use so streams
+        // that never degrade do not pay for it. Falls back to |vad_| if it
+        // cannot be initialized.
+        Vad* LiteVad() {
+            if (!lite_vad_) {
+                std::unique_ptr<Vad> vad(new Vad(aggressiveness_));
+                if (!vad->Init() || !vad->SetLite(true) || !vad->SetCascade(true)) {
+                    return &vad_;
+                }
+                lite_vad_ = std::move(vad);
+            }
+            return lite_vad_.get();
+        }
+
+        // Counts |num_frames| frames as missed by the instances other than
+        // |used|, nullptr if none processed them.
+        void Skip(const Vad* used, size_t num_frames) {
+            if (used != &vad_) {
+                vad_gap_ += num_frames;
+            }
+            if (lite_vad_ && used != lite_vad_.get()) {
+                lite_gap_ += num_frames;
+            }
+        }
+
+        // Advances |vad| over the frames it missed while the stream was
+        // degraded past it or back, so it does not resume from the hangover,
+        // minima and filter states of before, see Vad::AdvanceGap().
+        void CatchUp(Vad* vad) {
+            uint64_t& gap = vad == &vad_ ? vad_gap_ : lite_gap_;
+            if (gap != 0) {
+                vad->AdvanceGap((size_t)gap);
+                gap = 0;
+            }
+        }
+
+        Vad vad_;
+        std::unique_ptr<Vad> lite_vad_;
+        const Vad::Aggressiveness aggressiveness_;
+        const int sample_rate_hz_;
+        const int priority_;
+        std::atomic<int> degradation_;
+        Vad::Activity last_activity_;  // Repeated by kHold.
+        Callback callback_;
+        FrameLink stub_;
+        std::atomic<FrameLink*> head_;
+        FrameLink* tail_;
+        // Number of submitted but unprocessed frames. The stream is queued on a
+        // worker exactly when this is non-zero.
+        std::atomic<uint64_t> pending_;
+        std::atomic<size_t> home_;
+        uint64_t next_sequence_;
+        Stream* next_scheduled_;  // Link in a worker's inbox.
+        // Free frame buffers: |free_| is owned by the submitting thread,
+        // |returned_| collects the buffers the worker is done with.
+        Frame* free_;
+        std::atomic<Frame*> returned_;
+        // Frames |vad_| and |lite_vad_| missed, see CatchUp().
+        uint64_t vad_gap_;
+        uint64_t lite_gap_;
+    };
+
+private:
+    // Frames processed per stream before the worker moves on to the next
+    // stream, to bound the latency other streams see.
+    static const uint64_t kMaxFramesPerTurn = 32;
+
+    struct Worker {
+        Worker() { sem_init(&wakeup, 0, 0); }
+        ~Worker() { sem_destroy(&wakeup); }
+
+        // Streams scheduled by submitting threads, as a lock-free stack.
+        std::atomic<Stream*> inbox{nullptr};
+        // Streams ready to run. The owner takes from the front, thieves from
+        // the back.
+        std::deque<Stream*> ready;
+        std::mutex mutex;  // Guards |ready| and |poked|.
+        // Posted by whoever clears |sleeping|, so a sleeping worker is woken
+        // without taking a lock. A stale post only causes one spurious loop.
+        sem_t wakeup;
+        std::atomic<bool> sleeping{false};
+        bool poked = false;  // Set by a peer with streams to steal.
+        std::thread thread;
+    };
+
+    static void Wake(Worker* worker) {
+        if (worker->sleeping.exchange(false)) {
+            sem_post(&worker->wakeup);
+        }
+    }
+
+    void Schedule(Stream* stream) {
+        Worker* worker = workers_[stream->home_.load()].get();
+        Stream* top = worker->inbox.load();
+        do {
+            stream->next_scheduled_ = top;
+        } while (!worker->inbox.compare_exchange_weak(top, stream));
+        Wake(worker);
+    }
+
+    // Moves the inbox of |worker| to the back of its ready deque, oldest
+    // first. Must hold |worker->mutex|.
+    void TakeInbox(Worker* worker) {
+        Stream* stream = worker->inbox.exchange(nullptr);
+        size_t first = worker->ready.size();
+        for (; stream != nullptr; stream = stream->next_scheduled_) {
+            worker->ready.insert(worker->ready.begin() + first, stream);
+        }
+    }
+
+    Stream* Next(size_t index) {
+        Worker* self = workers_[index].get();
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            TakeInbox(self);
+            if (!self->ready.empty()) {
+                Stream* stream = self->ready.front();
+                self->ready.pop_front();
+                if (!self->ready.empty()) {
+                    WakeIdlePeer(index);
+                }
+                return stream;
+            }
+        }
+        // Steal, starting with the next worker to spread thieves out.
+        for (size_t i = 1; i < workers_.size(); i++) {
+            Worker* victim = workers_[(index + i) % workers_.size()].get();
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            TakeInbox(victim);
+            if (!victim->ready.empty()) {
+                Stream* stream = victim->ready.back();
+                victim->ready.pop_back();
+                stream->home_.store(index);
+                return stream;
+            }
+        }
+        return nullptr;
+    }
+
+    void WakeIdlePeer(size_t index) {
+        for (size_t i = 1; i < workers_.size(); i++) {
+            Worker* peer = workers_[(index + i) % workers_.size()].get();
+            if (peer->sleeping.load()) {
+                {
+                    std::lock_guard<std::mutex> lock(peer->mutex);
+                    peer->poked = true;
+                }
+                Wake(peer);
+                return;
+            }
+        }
+    }
+
+    static uint64_t Now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    Degradation DegradationOf(const Stream* stream) const {
+        int steps = overload_level_.load(std::memory_order_relaxed) - kHold * stream->priority_;
+        return (Degradation)(steps < 0 ? 0 : steps > kHold ? kHold : steps);
+    }
+
+    // Charges |busy_ns| of processing to the current tick and, once the tick
+    // is over, moves the overload level. One worker evaluates each tick.
+    void UpdateOverload(uint64_t busy_ns, uint64_t now) {
+        busy_ns_.fetch_add(busy_ns);
+        if (now < next_tick_ns_.load() || !overload_mutex_.try_lock()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(overload_mutex_, std::adopt_lock);
+        uint64_t tick_ns = tick_ns_.load();
+        uint64_t next_tick_ns = next_tick_ns_.load();
+        if (tick_ns == 0 || now < next_tick_ns) {
+            return;
+        }
+        // Ticks without any processing are folded into this one.
+        uint64_t ticks = 1 + (now - next_tick_ns) / tick_ns;
+        next_tick_ns_.store(next_tick_ns + ticks * tick_ns);
+        uint64_t busy = busy_ns_.exchange(0);
+        uint64_t budget = budget_ns_.load() * ticks;
+        int level = overload_level_.load();
+        if (busy > budget) {
+            level = level < kMaxOverloadLevel ? level + 1 : level;
+            calm_ticks_ = 0;
+        } else if (busy * 2 < budget) {
+            for (calm_ticks_ += ticks; calm_ticks_ >= kRecoveryTicks && level > 0; calm_ticks_ -= kRecoveryTicks) {
+                level--;
+            }
+        } else {
+            calm_ticks_ = 0;
+        }
+        overload_level_.store(level);
+    }
+
+    // Processes up to |kMaxFramesPerTurn| frames of |stream| and requeues it if
+    // more are pending.
+    void Process(size_t index, Stream* stream) {
+        const bool controlled = tick_ns_.load(std::memory_order_relaxed) != 0;
+        const uint64_t start = controlled ? Now() : 0;
+        const Degradation degradation = controlled ? DegradationOf(stream) : kFullQuality;
+        stream->degradation_.store(degradation, std::memory_order_relaxed);
+        Vad* vad = degradation >= kLite ? stream->LiteVad() : &stream->vad_;
+        // Samples in a merged batch, 0 if frames are not merged.
+        const size_t max_samples =
+            degradation >= kLongFrames && degradation < kHold ? (size_t)stream->sample_rate_hz_ / 100 * 3 : 0;
+
+        uint64_t processed = 0;
+        Frame* next = nullptr;  // Popped but did not fit the previous batch.
+        while ((processed < kMaxFramesPerTurn || next != nullptr) && processed < stream->pending_.load()) {
+            Frame* frame = next != nullptr ? next : stream->Pop();
+            next = nullptr;
+            if (frame == nullptr) {
+                // Counted but not yet visible; cannot happen since |pending_| is
+                // incremented after linking, but stay safe.
+                std::this_thread::yield();
+                continue;
+            }
+            // From kLongFrames on, frames already queued behind |frame| are
+            // appended to it, up to 30 ms, and share one decision.
+            Frame* batch[3] = {frame};
+            size_t batch_size = 1;
+            while (max_samples != 0 && batch_size < 3 && processed + batch_size < stream->pending_.load()) {
+                Frame* queued = stream->Pop();
+                if (queued == nullptr) {
+                    break;
+                }
+                if (frame->num_samples + queued->num_samples > max_samples) {
+                    next = queued;
+                    break;
+                }
+                memcpy(frame->audio + frame->num_samples, queued->audio, queued->num_samples * sizeof(int16_t));
+                frame->num_samples += queued->num_samples;
+                batch[batch_size++] = queued;
+            }
+
+            Vad::Activity activity = stream->last_activity_;
+            if (degradation < kHold) {
+                stream->CatchUp(vad);
+                activity = vad->IsSpeech(frame->audio, frame->num_samples, stream->sample_rate_hz_);
+                if (activity != Vad::kError) {
+                    stream->last_activity_ = activity;
+                }
+            }
+            stream->Skip(degradation < kHold ? vad : nullptr, batch_size);
+            for (size_t i = 0; i < batch_size; i++) {
+                if (stream->callback_) {
+                    stream->callback_(batch[i]->sequence, activity);
+                }
+                stream->Recycle(batch[i]);
+            }
+            processed += batch_size;
+        }
+        if (controlled) {
+            uint64_t now = Now();
+            UpdateOverload(now - start, now);
+        }
+
+        bool more = stream->pending_.fetch_sub(processed) != processed;
+        if (outstanding_.fetch_sub(processed) == processed) {
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            drained_.notify_all();
+        }
+        if (more) {
+            Worker* self = workers_[index].get();
+            std::lock_guard<std::mutex> lock(self->mutex);
+            self->ready.push_back(stream);
+        }
+    }
+
+    void Run(size_t index) {
+        Worker* self = workers_[index].get();
+        while (true) {
+            Stream* stream = Next(index);
+            if (stream != nullptr) {
+                Process(index, stream);
+                continue;
+            }
+            // Submitters check |sleeping| after pushing to the inbox, so either
+            // they see it set and post the semaphore, or we see their push.
+            self->sleeping.store(true);
+            bool idle;
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                idle = self->inbox.load() == nullptr && self->ready.empty() && !self->poked && !stop_.load();
+                self->poked = false;
+            }
+            while (idle && sem_wait(&self->wakeup) != 0 && errno == EINTR) {
+            }
+            self->sleeping.store(false);
+            if (stop_.load() && self->inbox.load() == nullptr && self->ready.empty()) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> stop_;
+    std::atomic<uint64_t> outstanding_;
+    std::mutex drain_mutex_;
+    std::condition_variable drained_;
+    std::atomic<size_t> next_home_;
+    std::mutex streams_mutex_;
+    std::vector<std::unique_ptr<Stream>> streams_;
+    // Overload controller, see SetOverloadBudget(). |overload_mutex_| is held
+    // by the worker evaluating a tick and guards |calm_ticks_|.
+    std::mutex overload_mutex_;
+    std::atomic<uint64_t> tick_ns_;
+    std::atomic<uint64_t> budget_ns_;
+    std::atomic<uint64_t> next_tick_ns_;
+    std::atomic<uint64_t> busy_ns_;
+    std::atomic<int> overload_level_;
+    uint64_t calm_ticks_;
+};
+}  // namespace webrtc
+#endif
@@ -22,6 +22,16 @@ namespace webrtc {
 //    1 / |std| * exp(-(|input| - |mean|)^2 / (2 * |std|^2));
 int32_t WebRtcVad_GaussianProbability(int16_t input, int16_t mean, int16_t std, int16_t* delta);
 
+// The divisions of the model. Built with WEBRTC_VAD_WCET they take the same
+// time for every input, see WebRtcSpl_DivW32W16FixedLatency().
+static inline int32_t WebRtcVad_DivW32W16(int32_t num, int16_t den) {
+#ifdef WEBRTC_VAD_WCET
+    return WebRtcSpl_DivW32W16FixedLatency(num, den);
+#else
+    return WebRtcSpl_DivW32W16(num, den);
+#endif
+}
+
 static const int32_t kCompVar = 22005;
 static const int16_t kLog2Exp = 5909;  // log2(exp(1)) in Q12.
 
@@ -44,7 +54,7 @@ inline int32_t WebRtcVad_GaussianProbability(int16_t input, int16_t mean, int16_
     // 131072 = 1 in Q17, and (|std| >> 1) is for rounding instead of truncation.
     // Q-domain: Q17 / Q7 = Q10.
     tmp32 = (int32_t)131072 + (int32_t)(std >> 1);
-    inv_std = (int16_t)WebRtcSpl_DivW32W16(tmp32, std);
+    inv_std = (int16_t)WebRtcVad_DivW32W16(tmp32, std);
 
     // Calculate |inv_std2| = 1 / s^2, in Q14.
     tmp16 = (inv_std >> 2);  // Q10 -> Q8.
@@ -0,0 +1,203 @@
+#ifndef WEBRTC_VAD_VAD_MODEL_PROFILE_HPP
+#define WEBRTC_VAD_VAD_MODEL_PROFILE_HPP
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+
+// The adapted noise/speech model of a VAD instance. A profile captured from
+// an instance that has converged on a trunk or device class lets new
+// instances start from that model instead of the generic start values
+// (|kNoiseDataMeans| etc.) and skip the convergence period.
+typedef struct {
+    int16_t noise_means[kTableSize];
+    int16_t speech_means[kTableSize];
+    int16_t noise_stds[kTableSize];
+    int16_t speech_stds[kTableSize];
+    // Minimum tracker, see WebRtcVad_FindMinimum().
+    int16_t mean_value[kNumChannels];
+    int16_t low_value_vector[16 * kNumChannels];
+    int16_t index_vector[16 * kNumChannels];
+    int32_t frame_counter;
+} VadModelProfile;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Captures the adapted model of a running VAD instance. Profiles are of the
+// full model, which WebRtcVad_InitWithProfile() starts from; the model of an
+// instance in the lite mode (see WebRtcVad_set_lite()) has only
+// |kNumLiteChannels| channels and is not captured.
+//
+// - handle  [i] : Initialized VAD instance, not in the lite mode.
+// - profile [o] : Captured profile.
+//
+// returns       : 0 - (OK),
+//                -1 - (null pointer, uninitialized instance or lite mode).
+int WebRtcVad_CaptureProfile(const VadInst* handle, VadModelProfile* profile);
+
+// Averages |num_profiles| profiles, e.g., captured from several calls on the
+// same trunk, into |average|. Means, stds and |mean_value| are averaged
+// element-wise. The minimum tracker slots are averaged over the profiles in
+// which they are occupied, and re-sorted per channel.
+//
+// - profiles     [i] : Profiles to average.
+// - num_profiles [i] : Number of |profiles|, at least one.
+// - average      [o] : Averaged profile. May alias |profiles|.
+//
+// returns            : 0 - (OK),
+//                     -1 - (null pointer or no profiles).
+int WebRtcVad_AverageProfiles(const VadModelProfile* profiles, size_t num_profiles, VadModelProfile* average);
+
+// Initializes a VAD instance like WebRtcVad_Init(), but starts from the model
+// in |profile|. Filter states and hangover start from their defaults.
+//
+// - handle  [i/o] : Instance that should be initialized.
+// - profile [i]   : Profile to start from.
+//
+// returns         : 0 - (OK),
+//                  -1 - (null pointer or default mode could not be set).
+int WebRtcVad_InitWithProfile(VadInst* handle, const VadModelProfile* profile);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Value and age of a minimum tracker slot that is not occupied, as set by
+// WebRtcVad_InitCore().
+static const int16_t kEmptyLowValue = 10000;
+static const int16_t kEmptyAge = 0;
+
+inline int WebRtcVad_CaptureProfile(const VadInst* handle, VadModelProfile* profile) {
+    const VadInstT* self = (const VadInstT*)handle;
+
+    if (handle == NULL || profile == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck || self->lite) {
+        return -1;
+    }
+
+    memcpy(profile->noise_means, self->noise_means, sizeof(profile->noise_means));
+    memcpy(profile->speech_means, self->speech_means, sizeof(profile->speech_means));
+    memcpy(profile->noise_stds, self->noise_stds, sizeof(profile->noise_stds));
+    memcpy(profile->speech_stds, self->speech_stds, sizeof(profile->speech_stds));
+    memcpy(profile->mean_value, self->mean_value, sizeof(profile->mean_value));
+    memcpy(profile->low_value_vector, self->low_value_vector, sizeof(profile->low_value_vector));
+    memcpy(profile->index_vector, self->index_vector, sizeof(profile->index_vector));
+    profile->frame_counter = self->frame_counter;
+    return 0;
+}
+
+// Rounded average of |sum| over |count| values.
+static inline int16_t RoundedAverage(int64_t sum, size_t count) {
+    int64_t half = (int64_t)(count >> 1);
+    return (int16_t)(sum >= 0 ? (sum + half) / (int64_t)count : (sum - half) / (int64_t)count);
+}
+
+// Averages |num_profiles| arrays found at |offset| in each profile.
+static void AverageProfileMember(const VadModelProfile* profiles, size_t num_profiles, size_t offset, size_t length,
+                                 int16_t* average) {
+    size_t i, p;
+    for (i = 0; i < length; i++) {
+        int64_t sum = 0;
+        for (p = 0; p < num_profiles; p++) {
+            sum += ((const int16_t*)((const uint8_t*)&profiles[p] + offset))[i];
+        }
+        average[i] = RoundedAverage(sum, num_profiles);
+    }
+}
+
+inline int WebRtcVad_AverageProfiles(const VadModelProfile* profiles, size_t num_profiles, VadModelProfile* average) {
+    VadModelProfile result;
+    int64_t frame_sum = 0;
+    size_t i, j, p;
+
+    if (profiles == NULL || average == NULL || num_profiles == 0) {
+        return -1;
+    }
+
+    AverageProfileMember(profiles, num_profiles, offsetof(VadModelProfile, noise_means), kTableSize,
+                         result.noise_means);
+    AverageProfileMember(profiles, num_profiles, offsetof(VadModelProfile, speech_means), kTableSize,
+                         result.speech_means);
+    AverageProfileMember(profiles, num_profiles, offsetof(VadModelProfile, noise_stds), kTableSize, result.noise_stds);
+    AverageProfileMember(profiles, num_profiles, offsetof(VadModelProfile, speech_stds), kTableSize,
+                         result.speech_stds);
+    AverageProfileMember(profiles, num_profiles, offsetof(VadModelProfile, mean_value), kNumChannels,
+                         result.mean_value);
+
+    for (i = 0; i < 16 * kNumChannels; i++) {
+        int64_t value_sum = 0, age_sum = 0;
+        size_t occupied = 0;
+        for (p = 0; p < num_profiles; p++) {
+            if (profiles[p].low_value_vector[i] < kEmptyLowValue) {
+                value_sum += profiles[p].low_value_vector[i];
+                age_sum += profiles[p].index_vector[i];
+                occupied++;
+            }
+        }
+        if (occupied > 0) {
+            result.low_value_vector[i] = RoundedAverage(value_sum, occupied);
+            result.index_vector[i] = RoundedAverage(age_sum, occupied);
+        } else {
+            result.low_value_vector[i] = kEmptyLowValue;
+            result.index_vector[i] = kEmptyAge;
+        }
+    }
+
+    // WebRtcVad_FindMinimum() relies on sorted slots. Averages over different
+    // sets of profiles need not be, so insertion sort each channel.
+    for (i = 0; i < 16 * kNumChannels; i += 16) {
+        int16_t* values = &result.low_value_vector[i];
+        int16_t* ages = &result.index_vector[i];
+        for (j = 1; j < 16; j++) {
+            int16_t value = values[j], age = ages[j];
+            size_t k = j;
+            while (k > 0 && values[k - 1] > value) {
+                values[k] = values[k - 1];
+                ages[k] = ages[k - 1];
+                k--;
+            }
+            values[k] = value;
+            ages[k] = age;
+        }
+    }
+
+    for (p = 0; p < num_profiles; p++) {
+        frame_sum += profiles[p].frame_counter;
+    }
+    result.frame_counter = (int32_t)((frame_sum + (int64_t)(num_profiles >> 1)) / (int64_t)num_profiles);
+
+    *average = result;
+    return 0;
+}
+
+inline int WebRtcVad_InitWithProfile(VadInst* handle, const VadModelProfile* profile) {
+    VadInstT* self = (VadInstT*)handle;
+
+    if (profile == NULL) {
+        return -1;
+    }
+    if (WebRtcVad_InitCore(self) != 0) {
+        return -1;
+    }
+
+    memcpy(self->noise_means, profile->noise_means, sizeof(self->noise_means));
+    memcpy(self->speech_means, profile->speech_means, sizeof(self->speech_means));
+    memcpy(self->noise_stds, profile->noise_stds, sizeof(self->noise_stds));
+    memcpy(self->speech_stds, profile->speech_stds, sizeof(self->speech_stds));
+    memcpy(self->mean_value, profile->mean_value, sizeof(self->mean_value));
+    memcpy(self->low_value_vector, profile->low_value_vector, sizeof(self->low_value_vector));
+    memcpy(self->index_vector, profile->index_vector, sizeof(self->index_vector));
+    // A non-zero |frame_counter| makes WebRtcVad_FindMinimum() smooth from the
+    // profile's |mean_value| instead of resetting it to the default.
+    self->frame_counter = profile->frame_counter;
+    return 0;
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,330 @@
+#ifndef WEBRTC_VAD_VAD_PERF_HPP
+#define WEBRTC_VAD_VAD_PERF_HPP
+// Hardware counter profiling of the VAD pipeline by stage, compiled in with
+// -DWEBRTC_VAD_PERF. Without it, the stage marks in the pipeline expand to
+// nothing and WebRtcVad_GetPerfStats() returns -1.
+//
+// Every thread opens its own perf_event_open() counters, user space only, on
+// its first frame:
+//   cycles, instructions, branch-misses, L1D-misses (L1 data read misses)
+//   and LLC-misses (last level cache read misses).
+// The pipeline marks the start of each stage:
+//   resample   - 48, 32 or 16 to 8 kHz, WebRtcVad_CalcVad*khz(),
+//   features   - WebRtcVad_CalculateFeatures(),
+//   likelihood - the GMM likelihood ratio tests of GmmProbability(),
+//   update     - the model update, including WebRtcVad_FindMinimum(), and the
+//                hangover,
+// and the counters are read at every mark with rdpmc where the kernel allows
+// it (x86), otherwise with read(). Counters that cannot be opened, e.g.,
+// because of perf_event_paranoid or a virtual machine without a PMU, are
+// reported as unavailable; the wall time of each stage is always measured.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef WEBRTC_VAD_PERF
+#include <time.h>
+
+#include <mutex>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace webrtc {
+
+enum VadPerfStage { kVadPerfResample = 0, kVadPerfFeatures, kVadPerfLikelihood, kVadPerfUpdate, kVadPerfNumStages };
+
+enum VadPerfCounter {
+    kVadPerfCycles = 0,
+    kVadPerfInstructions,
+    kVadPerfBranchMisses,
+    kVadPerfL1dMisses,
+    kVadPerfLlcMisses,
+    kVadPerfNumCounters
+};
+
+static const char* const kVadPerfStageNames[kVadPerfNumStages] = {"resample", "features", "likelihood", "update"};
+static const char* const kVadPerfCounterNames[kVadPerfNumCounters] = {"cycles", "instructions", "branch-misses",
+                                                                      "L1D-misses", "LLC-misses"};
+
+typedef struct {
+    // Bit c is set if counter c could be opened by a thread that contributed.
+    uint32_t available;
+    uint64_t calls[kVadPerfNumStages];
+    uint64_t ns[kVadPerfNumStages];
+    uint64_t counts[kVadPerfNumStages][kVadPerfNumCounters];
+} VadPerfStats;
+
+static inline void VadPerfStatsAdd(const VadPerfStats* from, VadPerfStats* to) {
+    int s, c;
+    to->available |= from->available;
+    for (s = 0; s < kVadPerfNumStages; s++) {
+        to->calls[s] += from->calls[s];
+        to->ns[s] += from->ns[s];
+        for (c = 0; c < kVadPerfNumCounters; c++) {
+            to->counts[s][c] += from->counts[s][c];
+        }
+    }
+}
+
+#ifdef WEBRTC_VAD_PERF
+// The counters of one thread. The totals are added to the process totals when
+// the thread exits.
+class VadPerfThread {
+public:
+    VadPerfThread() {
+        memset(&stats_, 0, sizeof(stats_));
+        memset(start_, 0, sizeof(start_));
+        for (int c = 0; c < kVadPerfNumCounters; c++) {
+            fds_[c] = -1;
+            pages_[c] = nullptr;
+            Open(c);
+        }
+    }
+
+    ~VadPerfThread() {
+        {
+            std::lock_guard<std::mutex> lock(Mutex());
+            VadPerfStatsAdd(&stats_, &Exited());
+        }
+#ifdef __linux__
+        for (int c = 0; c < kVadPerfNumCounters; c++) {
+            if (pages_[c] != nullptr) {
+                munmap(pages_[c], sysconf(_SC_PAGESIZE));
+            }
+            if (fds_[c] >= 0) {
+                close(fds_[c]);
+            }
+        }
+#endif
+    }
+
+    static VadPerfThread* Local() {
+        thread_local VadPerfThread thread;
+        return &thread;
+    }
+
+    // Totals of the threads that have exited.
+    static VadPerfStats& Exited() {
+        static VadPerfStats exited;
+        return exited;
+    }
+
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // Charges everything since the previous mark to the current stage and
+    // starts |stage|, or no stage if negative.
+    void Enter(int stage) {
+        uint64_t now[kVadPerfNumCounters];
+        for (int c = 0; c < kVadPerfNumCounters; c++) {
+            now[c] = Read(c);
+        }
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        uint64_t now_ns = (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+
+        if (stage_ >= 0) {
+            stats_.ns[stage_] += now_ns - start_ns_;
+            for (int c = 0; c < kVadPerfNumCounters; c++) {
+                stats_.counts[stage_][c] += now[c] - start_[c];
+            }
+        }
+        if (stage >= 0) {
+            stats_.calls[stage]++;
+        }
+        stage_ = stage;
+        start_ns_ = now_ns;
+        memcpy(start_, now, sizeof(start_));
+    }
+
+    const VadPerfStats& stats() const { return stats_; }
+
+private:
+    void Open(int counter) {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        switch (counter) {
+            case kVadPerfCycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case kVadPerfInstructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case kVadPerfBranchMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case kVadPerfL1dMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            default:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+        }
+        // This thread, on any CPU.
+        fds_[counter] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds_[counter] < 0) {
+            return;
+        }
+        stats_.available |= 1u << counter;
+        // The first page tells whether rdpmc may be used and how.
+        void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds_[counter], 0);
+        if (page != MAP_FAILED) {
+            pages_[counter] = (struct perf_event_mmap_page*)page;
+        }
+#endif
+    }
+
+    uint64_t Read(int counter) const {
+#ifdef __linux__
+        if (fds_[counter] < 0) {
+            return 0;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        // The seqlock protocol of perf_event_mmap_page, see perf_event_open(2).
+        const volatile struct perf_event_mmap_page* page = pages_[counter];
+        if (page != nullptr) {
+            uint32_t sequence, index;
+            uint64_t count;
+            do {
+                sequence = page->lock;
+                __asm__ __volatile__("" ::: "memory");
+                index = page->index;
+                count = page->offset;
+                if (page->cap_user_rdpmc && index != 0) {
+                    uint32_t low, high;
+                    __asm__ __volatile__("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+                    int64_t pmc = (int64_t)(((uint64_t)high << 32) | low);
+                    // Sign extend the |pmc_width| bits of the counter.
+                    pmc <<= 64 - page->pmc_width;
+                    pmc >>= 64 - page->pmc_width;
+                    count += pmc;
+                }
+                __asm__ __volatile__("" ::: "memory");
+            } while (page->lock != sequence);
+            if (page->cap_user_rdpmc && index != 0) {
+                return count;
+            }
+        }
+#endif
+        uint64_t count = 0;
+        if (read(fds_[counter], &count, sizeof(count)) != sizeof(count)) {
+            return 0;
+        }
+        return count;
+#else
+        return 0;
+#endif
+    }
+
+    int fds_[kVadPerfNumCounters];
+#ifdef __linux__
+    struct perf_event_mmap_page* pages_[kVadPerfNumCounters];
+#else
+    void* pages_[kVadPerfNumCounters];
+#endif
+    int stage_ = -1;
+    uint64_t start_[kVadPerfNumCounters];
+    uint64_t start_ns_ = 0;
+    VadPerfStats stats_;
+};
+
+#define WEBRTC_VAD_PERF_STAGE(stage) VadPerfThread::Local()->Enter(stage)
+#define WEBRTC_VAD_PERF_END() VadPerfThread::Local()->Enter(-1)
+#else
+#define WEBRTC_VAD_PERF_STAGE(stage)
+#define WEBRTC_VAD_PERF_END()
+#endif
+
+// Totals by stage of the threads that have exited and the calling thread.
+// Threads still processing elsewhere are not included; join them first.
+//
+// - stats [o] : Totals.
+//
+// returns     : 0 - (OK),
+//              -1 - (null pointer or built without WEBRTC_VAD_PERF).
+inline int WebRtcVad_GetPerfStats(VadPerfStats* stats) {
+#ifdef WEBRTC_VAD_PERF
+    if (stats == NULL) {
+        return -1;
+    }
+    VadPerfThread* thread = VadPerfThread::Local();
+    std::lock_guard<std::mutex> lock(VadPerfThread::Mutex());
+    *stats = VadPerfThread::Exited();
+    VadPerfStatsAdd(&thread->stats(), stats);
+    return 0;
+#else
+    (void)stats;
+    return -1;
+#endif
+}
+
+// Prints |stats| as a table with one row per stage and a total, each counter
+// per call of the stage, and "n/a" for counters that were not available.
+inline void WebRtcVad_PrintPerfStats(FILE* file, const VadPerfStats* stats) {
+    VadPerfStats total;
+    int s, c;
+    memset(&total, 0, sizeof(total));
+    for (s = 0; s < kVadPerfNumStages; s++) {
+        total.ns[0] += stats->ns[s];
+        for (c = 0; c < kVadPerfNumCounters; c++) {
+            total.counts[0][c] += stats->counts[s][c];
+        }
+    }
+    // Every frame starts with the resample or, at 8 kHz, the features stage.
+    total.calls[0] = stats->calls[kVadPerfFeatures];
+
+    fprintf(file, "%-10s %10s %10s", "stage", "calls", "ns");
+    for (c = 0; c < kVadPerfNumCounters; c++) {
+        fprintf(file, " %13s", kVadPerfCounterNames[c]);
+    }
+    fprintf(file, " %6s\n", "IPC");
+    for (s = 0; s <= kVadPerfNumStages; s++) {
+        const bool is_total = s == kVadPerfNumStages;
+        const uint64_t calls = is_total ? total.calls[0] : stats->calls[s];
+        const uint64_t* counts = is_total ? total.counts[0] : stats->counts[s];
+        if (calls == 0) {
+            continue;
+        }
+        fprintf(file, "%-10s %10llu %10.1f", is_total ? "frame" : kVadPerfStageNames[s], (unsigned long long)calls,
+                (double)(is_total ? total.ns[0] : stats->ns[s]) / calls);
+        for (c = 0; c < kVadPerfNumCounters; c++) {
+            if (stats->available & (1u << c)) {
+                fprintf(file, " %13.1f", (double)counts[c] / calls);
+            } else {
+                fprintf(file, " %13s", "n/a");
+            }
+        }
+        const uint32_t ipc_counters = (1u << kVadPerfCycles) | (1u << kVadPerfInstructions);
+        if ((stats->available & ipc_counters) == ipc_counters && counts[kVadPerfCycles] > 0) {
+            fprintf(file, " %6.2f\n", (double)counts[kVadPerfInstructions] / counts[kVadPerfCycles]);
+        } else {
+            fprintf(file, " %6s\n", "n/a");
+        }
+    }
+    fprintf(file, "(per call of the stage, frame = per frame)\n");
+    if (stats->available == 0) {
+        fprintf(file,
+                "hardware counters unavailable: no PMU (e.g., in a virtual machine) or not permitted, see "
+                "/proc/sys/kernel/perf_event_paranoid\n");
+    }
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,205 @@
+#ifndef WEBRTC_VAD_VAD_RING_HPP
+#define WEBRTC_VAD_VAD_RING_HPP
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "webrtc/vad/vad.hpp"
+
+namespace webrtc {
+static const size_t kCacheLineSize = 64;
+
+// Lock-free single-producer/single-consumer ring of |kSlots| elements of type
+// |T|, |kSlots| a power of two. Neither side ever blocks or allocates, which
+// makes it safe to push from a real-time audio callback. The producer and
+// consumer indices live on separate cache lines, each side keeping a cached
+// copy of the other side's index so that the shared line is only read when
+// the ring looks full (producer) or empty (consumer).
+template <typename T, size_t kSlots>
+class SpscRing {
+    static_assert(kSlots >= 2 && (kSlots & (kSlots - 1)) == 0, "kSlots must be a power of two");
+
+public:
+    SpscRing() : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer side. Returns the slot to fill in place, or nullptr if the ring
+    // is full. The slot becomes visible to the consumer on Publish().
+    T* BeginWrite() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ == kSlots) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ == kSlots) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & (kSlots - 1)];
+    }
+
+    void Publish() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    bool TryPush(const T& value) {
+        T* slot = BeginWrite();
+        if (slot == nullptr) {
+            return false;
+        }
+        *slot = value;
+        Publish();
+        return true;
+    }
+
+    // Consumer side. Returns the oldest element, or nullptr if the ring is
+    // empty. The slot is handed back to the producer on Release().
+    const T* Front() {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == cached_head_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail == cached_head_) {
+                return nullptr;
+            }
+        }
+        return &slots_[tail & (kSlots - 1)];
+    }
+
+    void Release() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    bool TryPop(T* value) {
+        const T* slot = Front();
+        if (slot == nullptr) {
+            return false;
+        }
+        *value = *slot;
+        Release();
+        return true;
+    }
+
+    static constexpr size_t capacity() { return kSlots; }
+
+private:
+    // Written by the producer.
+    alignas(kCacheLineSize) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    // Written by the consumer.
+    alignas(kCacheLineSize) std::atomic<size_t> tail_;
+    size_t cached_head_;
+    alignas(kCacheLineSize) T slots_[kSlots];
+};
+
+// A frame of up to |kMaxSamples| samples, stored inline so that ring slots can
+// be written in place.
+template <size_t kMaxSamples>
+struct VadAudioFrame {
+    uint32_t num_samples;
+    int16_t samples[kMaxSamples];
+};
+
+struct VadDecision {
+    uint64_t sequence;  // Index of the frame in the ingest ring.
+    Vad::Activity activity;
+};
+
+// Connects a real-time capture thread to a VAD worker thread through two SPSC
+// rings: audio frames in, decisions out.
+//
+// Capture thread:
+//   int16_t* samples = processor.BeginFrame();
+//   if (samples != nullptr) { /* fill */ processor.PublishFrame(num_samples); }
+//
+// VAD thread:
+//   processor.Poll();
+//
+// Consumer of decisions (may be the capture thread or a third thread):
+//   VadDecision decision;
+//   while (processor.decisions().TryPop(&decision)) { ... }
+template <size_t kFrameSlots, size_t kMaxFrameSamples = 480, size_t kDecisionSlots = kFrameSlots>
+class VadRingProcessor {
+public:
+    typedef VadAudioFrame<kMaxFrameSamples> Frame;
+
+    VadRingProcessor(Vad::Aggressiveness aggressiveness, int sample_rate_hz)
+        : vad_(aggressiveness), sample_rate_hz_(sample_rate_hz), sequence_(0), dropped_frames_(0) {}
+
+    bool Init() { return vad_.Init(); }
+
+    // Capture thread. Returns the frame buffer to fill, or nullptr (and counts
+    // a dropped frame) if the VAD thread has fallen a whole ring behind.
+    int16_t* BeginFrame() {
+        Frame* frame = frames_.BeginWrite();
+        if (frame == nullptr) {
+            dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return frame->samples;
+    }
+
+    // Capture thread. Hands the frame filled after BeginFrame() to the VAD
+    // thread. Returns false, publishing nothing, if there is no frame to
+    // publish (the ring is full) or |num_samples| exceeds |kMaxFrameSamples|.
+    bool PublishFrame(size_t num_samples) {
+        if (num_samples > kMaxFrameSamples) {
+            return false;
+        }
+        Frame* frame = frames_.BeginWrite();
+        if (frame == nullptr) {
+            return false;
+        }
+        frame->num_samples = (uint32_t)num_samples;
+        frames_.Publish();
+        return true;
+    }
+
+    // Capture thread. Copies |num_samples| samples into the ring.
+    bool PushFrame(const int16_t* audio, size_t num_samples) {
+        if (num_samples > kMaxFrameSamples) {
+            return false;
+        }
+        int16_t* samples = BeginFrame();
+        if (samples == nullptr) {
+            return false;
+        }
+        memcpy(samples, audio, num_samples * sizeof(int16_t));
+        return PublishFrame(num_samples);
+    }
+
+    // VAD thread. Processes every available frame for which there is room in
+    // the decision ring. A full decision ring leaves frames queued, so a slow
+    // decision consumer shows up as dropped frames on the capture side rather
+    // than as lost decisions. Returns the number of frames processed.
+    size_t Poll() {
+        size_t processed = 0;
+        const Frame* frame;
+        VadDecision* decision;
+        while ((decision = decisions_.BeginWrite()) != nullptr && (frame = frames_.Front()) != nullptr) {
+            decision->sequence = sequence_++;
+            // The frames are written by the capture side; never read past one.
+            decision->activity = frame->num_samples <= kMaxFrameSamples
+                                     ? vad_.IsSpeech(frame->samples, frame->num_samples, sample_rate_hz_)
+                                     : Vad::kError;
+            frames_.Release();
+            decisions_.Publish();
+            processed++;
+        }
+        return processed;
+    }
+
+    // VAD thread. True while frames are waiting for Poll(), e.g., to drain the
+    // ring after the capture has stopped.
+    bool HasFrames() { return frames_.Front() != nullptr; }
+
+    SpscRing<VadDecision, kDecisionSlots>& decisions() { return decisions_; }
+
+    uint64_t dropped_frames() const { return dropped_frames_.load(std::memory_order_relaxed); }
+
+private:
+    Vad vad_;
+    const int sample_rate_hz_;
+    uint64_t sequence_;
+    std::atomic<uint64_t> dropped_frames_;
+    SpscRing<Frame, kFrameSlots> frames_;
+    SpscRing<VadDecision, kDecisionSlots> decisions_;
+};
+}  // namespace webrtc
+#endif
@@ -0,0 +1,424 @@
+#ifndef WEBRTC_VAD_VAD_STATE_HPP
+#define WEBRTC_VAD_VAD_STATE_HPP
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns an upper bound of the number of bytes WebRtcVad_Hibernate() writes.
+size_t WebRtcVad_HibernateMaxSize(void);
+
+// Hibernates a VAD instance into a compact blob. The blob holds the complete
+// processing state (filter states, GMM means and stds, minimum tracker, mode
+// thresholds and hangover counters), delta-encoded against the values set by
+// WebRtcVad_InitCore(). An instance that has seen little or no active audio
+// therefore hibernates into a handful of bytes. The instance itself is left
+// untouched and may be freed afterwards.
+//
+// - handle   [i] : Initialized VAD instance.
+// - blob     [o] : Output buffer.
+// - capacity [i] : Size of |blob| in bytes, at least
+//                  WebRtcVad_HibernateMaxSize() is always enough.
+//
+// returns        : Number of bytes written to |blob|,
+//                  0 - (null pointer, uninitialized instance or too small
+//                       |blob|).
+size_t WebRtcVad_Hibernate(const VadInst* handle, uint8_t* blob, size_t capacity);
+
+// Rehydrates a blob produced by WebRtcVad_Hibernate() into |handle|. The
+// instance does not need to be initialized beforehand. Processing continues
+// bit-exactly as if the hibernated instance had never been hibernated.
+//
+// - handle [o] : VAD instance, e.g., fresh from WebRtcVad_Create().
+// - blob   [i] : Hibernated state.
+// - length [i] : Size of |blob| in bytes.
+//
+// returns      : 0 - (OK),
+//               -1 - (null pointer or malformed blob).
+int WebRtcVad_Rehydrate(VadInst* handle, const uint8_t* blob, size_t length);
+
+// Returns the number of bytes WebRtcVad_Snapshot() writes.
+size_t WebRtcVad_SnapshotSize(void);
+
+// Writes a snapshot of the complete processing state of a VAD instance,
+// including the 48 to 8 kHz resampler and downsampling filter states. The
+// format is versioned and independent of host endianness and struct layout,
+// so the snapshot can be restored in another process or on another machine:
+//
+//   bytes 0-3 : "WVAD".
+//   bytes 4-5 : Format version |kVadSnapshotVersion|, little endian.
+//   bytes 6-7 : Payload size in bytes, little endian.
+//   payload   : The members listed in |kVadStateFields|, in that order, each
+//               element little endian at its natural width (2 or 4 bytes).
+//
+// - handle   [i] : Initialized VAD instance.
+// - buffer   [o] : Output buffer.
+// - capacity [i] : Size of |buffer| in bytes, at least
+//                  WebRtcVad_SnapshotSize().
+//
+// returns        : Number of bytes written to |buffer|,
+//                  0 - (null pointer, uninitialized instance or too small
+//                       |buffer|).
+size_t WebRtcVad_Snapshot(const VadInst* handle, uint8_t* buffer, size_t capacity);
+
+// Restores a snapshot written by WebRtcVad_Snapshot() into |handle|, which
+// does not need to be initialized beforehand. Processing continues
+// bit-exactly from where the snapshot was taken.
+//
+// - handle [o] : VAD instance, e.g., fresh from WebRtcVad_Create().
+// - buffer [i] : Snapshot.
+// - length [i] : Size of |buffer| in bytes.
+//
+// returns      : 0 - (OK),
+//               -1 - (null pointer, unknown version or malformed snapshot).
+int WebRtcVad_Restore(VadInst* handle, const uint8_t* buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+// Describes one serialized member of VadInstT. All members are arrays (or
+// scalars, |count| = 1) of 16 or 32 bit signed integers.
+typedef struct {
+    size_t offset;  // Byte offset in VadInstT.
+    size_t width;   // Size of one element in bytes, 2 or 4.
+    size_t count;   // Number of elements.
+    size_t row;     // If non-zero, elements are predicted from the previous
+                    // element within rows of |row| elements when
+                    // hibernating, otherwise from the WebRtcVad_InitCore()
+                    // value.
+} VadStateField;
+
+#define WEBRTC_VAD_STATE_FIELD(member, row) \
+    { offsetof(VadInstT, member), sizeof(((VadInstT*)0)->member[0]), arraysize(((VadInstT*)0)->member), row }
+
+RTC_COMPILE_ASSERT(sizeof(int) == sizeof(int32_t));
+
+// The processing state of VadInstT, i.e., everything but |init_flag|, in
+// serialization order.
+static const VadStateField kVadStateFields[] = {
+    {offsetof(VadInstT, vad), sizeof(int32_t), 1, 0},
+    WEBRTC_VAD_STATE_FIELD(downsampling_filter_states, 0),
+    WEBRTC_VAD_STATE_FIELD(state_48_to_8.S_48_24, 0),
+    WEBRTC_VAD_STATE_FIELD(state_48_to_8.S_24_24, 0),
+    WEBRTC_VAD_STATE_FIELD(state_48_to_8.S_24_16, 0),
+    WEBRTC_VAD_STATE_FIELD(state_48_to_8.S_16_8, 0),
+    WEBRTC_VAD_STATE_FIELD(noise_means, 0),
+    WEBRTC_VAD_STATE_FIELD(speech_means, 0),
+    WEBRTC_VAD_STATE_FIELD(noise_stds, 0),
+    WEBRTC_VAD_STATE_FIELD(speech_stds, 0),
+    {offsetof(VadInstT, frame_counter), sizeof(int32_t), 1, 0},
+    {offsetof(VadInstT, over_hang), sizeof(int16_t), 1, 0},
+    {offsetof(VadInstT, num_of_speech), sizeof(int16_t), 1, 0},
+    WEBRTC_VAD_STATE_FIELD(index_vector, 0),
+    // The 16 smallest values of each channel are sorted, hence small
+    // differences between neighbors.
+    WEBRTC_VAD_STATE_FIELD(low_value_vector, 16),
+    WEBRTC_VAD_STATE_FIELD(mean_value, 0),
+    WEBRTC_VAD_STATE_FIELD(upper_state, 0),
+    WEBRTC_VAD_STATE_FIELD(lower_state, 0),
+    WEBRTC_VAD_STATE_FIELD(hp_filter_state, 0),
+    WEBRTC_VAD_STATE_FIELD(over_hang_max_1, 0),
+    WEBRTC_VAD_STATE_FIELD(over_hang_max_2, 0),
+    WEBRTC_VAD_STATE_FIELD(individual, 0),
+    WEBRTC_VAD_STATE_FIELD(total, 0),
+    // Added in snapshot version 2. Hibernated blobs without them end before
+    // them, so they rehydrate to the WebRtcVad_InitCore() values.
+    {offsetof(VadInstT, cascade), sizeof(int16_t), 1, 0},
+    {offsetof(VadInstT, cascade_floor), sizeof(int32_t), 1, 0},
+    // Added in snapshot version 3.
+    {offsetof(VadInstT, lite), sizeof(int16_t), 1, 0},
+};
+static const size_t kVadStateFieldsSize = arraysize(kVadStateFields);
+// Fields of version 1 and 2 snapshots, the first ones of |kVadStateFields|.
+static const size_t kVadStateFieldsSizeV1 = kVadStateFieldsSize - 3;
+static const size_t kVadStateFieldsSizeV2 = kVadStateFieldsSize - 1;
+
+// Tag in the first byte of a hibernated blob.
+static const uint8_t kHibernateTag = 0xB7;
+// A varint of a 33 bit zigzag value needs at most 5 bytes.
+static const size_t kMaxVarintBytes = 5;
+
+// Reads element |i| of |field| in |self|, sign extended to 32 bits.
+static inline int32_t VadStateGet(const VadInstT* self, const VadStateField* field, size_t i) {
+    const uint8_t* base = (const uint8_t*)self + field->offset;
+    if (field->width == sizeof(int16_t)) {
+        return ((const int16_t*)base)[i];
+    }
+    return ((const int32_t*)base)[i];
+}
+
+// Writes element |i| of |field| in |self|, truncating |value| to the field
+// width.
+static inline void VadStateSet(VadInstT* self, const VadStateField* field, size_t i, int32_t value) {
+    uint8_t* base = (uint8_t*)self + field->offset;
+    if (field->width == sizeof(int16_t)) {
+        ((int16_t*)base)[i] = (int16_t)value;
+    } else {
+        ((int32_t*)base)[i] = value;
+    }
+}
+
+// Returns the value element |i| of |field| is predicted from, either the
+// previous element of the same row in |self| or the element in |defaults|.
+static inline int32_t VadStatePrediction(const VadInstT* self, const VadInstT* defaults, const VadStateField* field,
+                                         size_t i) {
+    if (field->row != 0 && (i % field->row) != 0) {
+        return VadStateGet(self, field, i - 1);
+    }
+    return VadStateGet(defaults, field, i);
+}
+
+// Appends |value| as a little endian base 128 varint. Returns the number of
+// bytes written, 0 if |capacity| is exceeded.
+static size_t VadWriteVarint(uint64_t value, uint8_t* out, size_t capacity) {
+    size_t n = 0;
+    do {
+        if (n == capacity) {
+            return 0;
+        }
+        out[n] = (uint8_t)(value & 0x7F);
+        value >>= 7;
+        if (value != 0) {
+            out[n] |= 0x80;
+        }
+        n++;
+    } while (value != 0);
+    return n;
+}
+
+// Reads a varint of at most |kMaxVarintBytes| bytes. Returns the number of
+// bytes read, 0 if malformed.
+static size_t VadReadVarint(const uint8_t* in, size_t length, uint64_t* value) {
+    size_t n = 0;
+    *value = 0;
+    while (n < length && n < kMaxVarintBytes) {
+        *value |= (uint64_t)(in[n] & 0x7F) << (7 * n);
+        if ((in[n++] & 0x80) == 0) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+// Zigzag maps signed deltas to unsigned values, small magnitudes to small
+// values: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+static inline uint64_t VadZigzagEncode(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+
+static inline int64_t VadZigzagDecode(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+inline size_t WebRtcVad_HibernateMaxSize(void) {
+    size_t elements = 0;
+    size_t i;
+    for (i = 0; i < kVadStateFieldsSize; i++) {
+        elements += kVadStateFields[i].count;
+    }
+    // Tag byte plus, in the worst case, one varint per element.
+    return 1 + elements * kMaxVarintBytes;
+}
+
+// The blob is the tag byte followed by one token per state element, in the
+// order of |kVadStateFields|. A token is the zigzag coded difference between
+// the element and its prediction. Runs of zero differences are coded as a
+// zero followed by the run length minus one.
+inline size_t WebRtcVad_Hibernate(const VadInst* handle, uint8_t* blob, size_t capacity) {
+    const VadInstT* self = (const VadInstT*)handle;
+    VadInstT defaults;
+    size_t length = 1;
+    size_t zero_run = 0;
+    size_t f, i, n;
+
+    if (handle == NULL || blob == NULL || capacity == 0) {
+        return 0;
+    }
+    if (self->init_flag != kInitCheck) {
+        return 0;
+    }
+    WebRtcVad_InitCore(&defaults);
+
+    blob[0] = kHibernateTag;
+    for (f = 0; f < kVadStateFieldsSize; f++) {
+        const VadStateField* field = &kVadStateFields[f];
+        for (i = 0; i < field->count; i++) {
+            int64_t delta = (int64_t)VadStateGet(self, field, i) - VadStatePrediction(self, &defaults, field, i);
+            if (delta == 0) {
+                zero_run++;
+                continue;
+            }
+            if (zero_run > 0) {
+                n = VadWriteVarint(0, &blob[length], capacity - length);
+                length += n;
+                if (n == 0 || (n = VadWriteVarint(zero_run - 1, &blob[length], capacity - length)) == 0) {
+                    return 0;
+                }
+                length += n;
+                zero_run = 0;
+            }
+            n = VadWriteVarint(VadZigzagEncode(delta), &blob[length], capacity - length);
+            if (n == 0) {
+                return 0;
+            }
+            length += n;
+        }
+    }
+    // A trailing run of zero differences is implied by the end of the blob.
+    return length;
+}
+
+inline int WebRtcVad_Rehydrate(VadInst* handle, const uint8_t* blob, size_t length) {
+    VadInstT* self = (VadInstT*)handle;
+    VadInstT defaults;
+    size_t pos = 1;
+    uint64_t zero_run = 0;
+    uint64_t token;
+    size_t f, i, n;
+
+    if (handle == NULL || blob == NULL || length == 0 || blob[0] != kHibernateTag) {
+        return -1;
+    }
+    WebRtcVad_InitCore(&defaults);
+    *self = defaults;
+    // Mark the instance as uninitialized until the whole blob has been read.
+    self->init_flag = 0;
+
+    for (f = 0; f < kVadStateFieldsSize; f++) {
+        const VadStateField* field = &kVadStateFields[f];
+        for (i = 0; i < field->count; i++) {
+            int64_t delta = 0;
+            if (zero_run > 0) {
+                zero_run--;
+            } else if (pos < length) {
+                n = VadReadVarint(&blob[pos], length - pos, &token);
+                if (n == 0) {
+                    return -1;
+                }
+                pos += n;
+                if (token == 0) {
+                    n = VadReadVarint(&blob[pos], length - pos, &zero_run);
+                    if (n == 0) {
+                        return -1;
+                    }
+                    pos += n;
+                } else {
+                    delta = VadZigzagDecode(token);
+                }
+            }
+            VadStateSet(self, field, i, (int32_t)(VadStatePrediction(self, &defaults, field, i) + delta));
+        }
+    }
+    if (pos != length || zero_run > 0) {
+        return -1;
+    }
+
+    self->init_flag = kInitCheck;
+    return 0;
+}
+
+static const uint8_t kVadSnapshotMagic[4] = {'W', 'V', 'A', 'D'};
+static const uint16_t kVadSnapshotVersion = 3;
+static const size_t kVadSnapshotHeaderSize = 8;
+
+// Payload size of a snapshot of the first |num_fields| of |kVadStateFields|.
+static size_t VadSnapshotPayloadSize(size_t num_fields = kVadStateFieldsSize) {
+    size_t size = 0;
+    size_t i;
+    for (i = 0; i < num_fields; i++) {
+        size += kVadStateFields[i].width * kVadStateFields[i].count;
+    }
+    return size;
+}
+
+inline size_t WebRtcVad_SnapshotSize(void) { return kVadSnapshotHeaderSize + VadSnapshotPayloadSize(); }
+
+inline size_t WebRtcVad_Snapshot(const VadInst* handle, uint8_t* buffer, size_t capacity) {
+    const VadInstT* self = (const VadInstT*)handle;
+    const size_t payload_size = VadSnapshotPayloadSize();
+    uint8_t* out = buffer + kVadSnapshotHeaderSize;
+    size_t f, i, b;
+
+    if (handle == NULL || buffer == NULL) {
+        return 0;
+    }
+    if (self->init_flag != kInitCheck) {
+        return 0;
+    }
+    if (capacity < kVadSnapshotHeaderSize + payload_size) {
+        return 0;
+    }
+
+    memcpy(buffer, kVadSnapshotMagic, sizeof(kVadSnapshotMagic));
+    buffer[4] = (uint8_t)(kVadSnapshotVersion & 0xFF);
+    buffer[5] = (uint8_t)(kVadSnapshotVersion >> 8);
+    buffer[6] = (uint8_t)(payload_size & 0xFF);
+    buffer[7] = (uint8_t)(payload_size >> 8);
+
+    for (f = 0; f < kVadStateFieldsSize; f++) {
+        const VadStateField* field = &kVadStateFields[f];
+        for (i = 0; i < field->count; i++) {
+            uint32_t value = (uint32_t)VadStateGet(self, field, i);
+            for (b = 0; b < field->width; b++) {
+                *out++ = (uint8_t)(value >> (8 * b));
+            }
+        }
+    }
+    return kVadSnapshotHeaderSize + payload_size;
+}
+
+inline int WebRtcVad_Restore(VadInst* handle, const uint8_t* buffer, size_t length) {
+    VadInstT* self = (VadInstT*)handle;
+    const uint8_t* in = buffer + kVadSnapshotHeaderSize;
+    size_t num_fields, payload_size;
+    size_t f, i, b;
+
+    if (handle == NULL || buffer == NULL || length < kVadSnapshotHeaderSize) {
+        return -1;
+    }
+    if (memcmp(buffer, kVadSnapshotMagic, sizeof(kVadSnapshotMagic)) != 0) {
+        return -1;
+    }
+    // Version 1 snapshots lack the cascade fields and version 2 ones the lite
+    // flag, which keep their WebRtcVad_InitCore() values.
+    switch (buffer[4] | (buffer[5] << 8)) {
+        case 1:
+            num_fields = kVadStateFieldsSizeV1;
+            break;
+        case 2:
+            num_fields = kVadStateFieldsSizeV2;
+            break;
+        case kVadSnapshotVersion:
+            num_fields = kVadStateFieldsSize;
+            break;
+        default:
+            return -1;
+    }
+    payload_size = VadSnapshotPayloadSize(num_fields);
+    if ((size_t)(buffer[6] | (buffer[7] << 8)) != payload_size || length != kVadSnapshotHeaderSize + payload_size) {
+        return -1;
+    }
+
+    if (WebRtcVad_InitCore(self) != 0) {
+        return -1;
+    }
+    for (f = 0; f < num_fields; f++) {
+        const VadStateField* field = &kVadStateFields[f];
+        for (i = 0; i < field->count; i++) {
+            uint32_t value = 0;
+            for (b = 0; b < field->width; b++) {
+                value |= (uint32_t)(*in++) << (8 * b);
+            }
+            // Sign extension of 16 bit members is done by the truncation in
+            // VadStateSet().
+            VadStateSet(self, field, i, (int32_t)value);
+        }
+    }
+    return 0;
+}
+}  // namespace webrtc
+#endif
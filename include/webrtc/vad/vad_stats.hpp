@@ -0,0 +1,272 @@
+#ifndef WEBRTC_VAD_VAD_STATS_HPP
+#define WEBRTC_VAD_VAD_STATS_HPP
+// Optional instrumentation of WebRtcVad_Process() and
+// WebRtcVad_ProcessWithAnalysis(), compiled in with -DWEBRTC_VAD_STATS. Without
+// it, the counters below are never touched and the snapshot functions return
+// -1.
+//
+// Every instance counts the frames it processed (VadCounters in VadInstT). In
+// addition, every thread counts the frames it processed over all instances,
+// and their latency in a log-linear histogram (VadStats). A thread only ever
+// writes its own counters, with plain relaxed stores, so recording takes no
+// locks and no atomic read-modify-writes. Snapshots read the counters of all
+// threads with relaxed loads: each counter is exact, but counters of a thread
+// that is processing a frame may be one frame apart.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef WEBRTC_VAD_STATS
+#include <time.h>
+
+#include <atomic>
+#endif
+
+#include "webrtc/singal_processing/singal_processing_library.hpp"
+
+namespace webrtc {
+
+// Histogram buckets below 2^|kVadLatencySubBucketBits| ns are 1 ns wide; above,
+// every power of two is split into 2^|kVadLatencySubBucketBits| buckets, so a
+// bucket is at most 12.5% wide. The last bucket also holds everything from
+// 2^|kVadLatencyMaxBits| ns (about 4.3 s) up.
+static const int kVadLatencySubBucketBits = 3;
+static const int kVadLatencyMaxBits = 32;
+static const size_t kVadLatencyBuckets = (size_t)(kVadLatencyMaxBits - kVadLatencySubBucketBits + 1)
+                                         << kVadLatencySubBucketBits;
+
+typedef struct {
+    uint64_t frames;         // Frames processed without error.
+    uint64_t speech_frames;  // Frames reported as active voice.
+    // Frames with a total power of at most |kMinEnergy|, which skip the GMM.
+    uint64_t low_energy_frames;
+    uint64_t errors;  // Calls that returned -1.
+} VadCounters;
+
+typedef struct {
+    VadCounters counters;
+    // Sum of the latencies of all |counters.frames|, for the mean.
+    uint64_t latency_ns_total;
+    // Number of frames per latency bucket, see WebRtcVad_LatencyBucket().
+    uint64_t latency[kVadLatencyBuckets];
+} VadStats;
+
+// Returns the histogram bucket of a latency of |ns| nanoseconds.
+static inline size_t WebRtcVad_LatencyBucket(uint64_t ns) {
+    const uint64_t sub_buckets = (uint64_t)1 << kVadLatencySubBucketBits;
+    if (ns < sub_buckets) {
+        return (size_t)ns;
+    }
+    if ((ns >> kVadLatencyMaxBits) != 0) {
+        return kVadLatencyBuckets - 1;
+    }
+    int msb = 31 - WebRtcSpl_CountLeadingZeros32((uint32_t)ns);
+    int shift = msb - kVadLatencySubBucketBits;
+    return ((size_t)(shift + 1) << kVadLatencySubBucketBits) + (size_t)((ns >> shift) & (sub_buckets - 1));
+}
+
+// Returns the smallest latency in nanoseconds that falls into |bucket|.
+static inline uint64_t WebRtcVad_LatencyBucketStart(size_t bucket) {
+    const uint64_t sub_buckets = (uint64_t)1 << kVadLatencySubBucketBits;
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    int shift = (int)(bucket >> kVadLatencySubBucketBits) - 1;
+    return (sub_buckets + (bucket & (sub_buckets - 1))) << shift;
+}
+
+// Returns an upper bound of the |fraction| quantile of the latencies in
+// |stats|, e.g., 0.99 for p99, in nanoseconds: the end of the bucket that
+// holds it. 0 if |stats| holds no frames.
+static inline uint64_t WebRtcVad_LatencyQuantile(const VadStats* stats, double fraction) {
+    uint64_t total = 0;
+    size_t i;
+    for (i = 0; i < kVadLatencyBuckets; i++) {
+        total += stats->latency[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(fraction * (double)total);
+    uint64_t seen = 0;
+    for (i = 0; i + 1 < kVadLatencyBuckets; i++) {
+        seen += stats->latency[i];
+        if (seen > rank) {
+            break;
+        }
+    }
+    return i + 1 < kVadLatencyBuckets ? WebRtcVad_LatencyBucketStart(i + 1) - 1 : UINT64_MAX;
+}
+
+#ifdef WEBRTC_VAD_STATS
+// The counters of one thread. Nodes are linked into a global list and never
+// freed; the node of a thread that exits is handed to the next new thread, so
+// totals never go backwards and thread churn does not grow the list.
+struct VadThreadStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> speech_frames{0};
+    std::atomic<uint64_t> low_energy_frames{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> latency_ns_total{0};
+    std::atomic<uint64_t> latency[kVadLatencyBuckets];
+    std::atomic<bool> in_use{true};
+    VadThreadStats* next = nullptr;
+
+    VadThreadStats() {
+        for (std::atomic<uint64_t>& bucket : latency) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+inline std::atomic<VadThreadStats*>& VadThreadStatsList() {
+    static std::atomic<VadThreadStats*> head{nullptr};
+    return head;
+}
+
+static inline void VadStatsAdd(const VadThreadStats* thread, VadStats* stats) {
+    stats->counters.frames += thread->frames.load(std::memory_order_relaxed);
+    stats->counters.speech_frames += thread->speech_frames.load(std::memory_order_relaxed);
+    stats->counters.low_energy_frames += thread->low_energy_frames.load(std::memory_order_relaxed);
+    stats->counters.errors += thread->errors.load(std::memory_order_relaxed);
+    stats->latency_ns_total += thread->latency_ns_total.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kVadLatencyBuckets; i++) {
+        stats->latency[i] += thread->latency[i].load(std::memory_order_relaxed);
+    }
+}
+
+// The node of the calling thread, and what it had counted before the thread
+// claimed it. Releases the node when the thread exits.
+struct VadThreadStatsOwner {
+    VadThreadStats* node = nullptr;
+    VadStats base;
+    ~VadThreadStatsOwner() {
+        if (node != nullptr) {
+            node->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+// Returns the owner of the calling thread's node, claiming a released node or
+// linking a new one on first use.
+inline VadThreadStatsOwner* VadThreadStatsLocalOwner() {
+    thread_local VadThreadStatsOwner owner;
+    if (owner.node != nullptr) {
+        return &owner;
+    }
+    memset(&owner.base, 0, sizeof(owner.base));
+    std::atomic<VadThreadStats*>& head = VadThreadStatsList();
+    for (VadThreadStats* node = head.load(std::memory_order_acquire); node != nullptr; node = node->next) {
+        bool in_use = false;
+        if (node->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire)) {
+            VadStatsAdd(node, &owner.base);
+            owner.node = node;
+            return &owner;
+        }
+    }
+    VadThreadStats* node = new VadThreadStats();
+    node->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    owner.node = node;
+    return &owner;
+}
+
+static inline VadThreadStats* VadThreadStatsLocal() { return VadThreadStatsLocalOwner()->node; }
+
+// Increments a counter only the calling thread writes.
+static inline void VadStatsIncrement(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline uint64_t VadStatsNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+// Records a frame that started at |start_ns| and returned |vad|, in
+// |instance|, if not NULL, and in the calling thread's counters.
+static inline void VadStatsRecordFrame(VadCounters* instance, int vad, uint64_t start_ns) {
+    uint64_t latency_ns = VadStatsNow() - start_ns;
+    VadThreadStats* thread = VadThreadStatsLocal();
+    if (vad < 0) {
+        if (instance != NULL) {
+            instance->errors++;
+        }
+        VadStatsIncrement(&thread->errors, 1);
+        return;
+    }
+    if (instance != NULL) {
+        instance->frames++;
+        instance->speech_frames += vad > 0;
+    }
+    VadStatsIncrement(&thread->frames, 1);
+    VadStatsIncrement(&thread->speech_frames, vad > 0);
+    VadStatsIncrement(&thread->latency_ns_total, latency_ns);
+    VadStatsIncrement(&thread->latency[WebRtcVad_LatencyBucket(latency_ns)], 1);
+}
+
+// Records a frame that skipped the GMM for its low energy.
+static inline void VadStatsRecordLowEnergy(VadCounters* instance) {
+    instance->low_energy_frames++;
+    VadStatsIncrement(&VadThreadStatsLocal()->low_energy_frames, 1);
+}
+#endif
+
+// Snapshot of the counters and latency histogram of the calling thread, over
+// all instances it ran since it started.
+//
+// - stats [o] : Snapshot.
+//
+// returns     : 0 - (OK),
+//              -1 - (null pointer or built without WEBRTC_VAD_STATS).
+inline int WebRtcVad_GetThreadStats(VadStats* stats) {
+#ifdef WEBRTC_VAD_STATS
+    if (stats == NULL) {
+        return -1;
+    }
+    const VadThreadStatsOwner* owner = VadThreadStatsLocalOwner();
+    memset(stats, 0, sizeof(*stats));
+    VadStatsAdd(owner->node, stats);
+    stats->counters.frames -= owner->base.counters.frames;
+    stats->counters.speech_frames -= owner->base.counters.speech_frames;
+    stats->counters.low_energy_frames -= owner->base.counters.low_energy_frames;
+    stats->counters.errors -= owner->base.counters.errors;
+    stats->latency_ns_total -= owner->base.latency_ns_total;
+    for (size_t i = 0; i < kVadLatencyBuckets; i++) {
+        stats->latency[i] -= owner->base.latency[i];
+    }
+    return 0;
+#else
+    (void)stats;
+    return -1;
+#endif
+}
+
+// Snapshot of the counters and latency histogram of the whole process: the
+// sum over all threads, including threads that have exited. Lock-free; may
+// be called from any thread at any time.
+//
+// - stats [o] : Snapshot.
+//
+// returns     : 0 - (OK),
+//              -1 - (null pointer or built without WEBRTC_VAD_STATS).
+inline int WebRtcVad_GetProcessStats(VadStats* stats) {
+#ifdef WEBRTC_VAD_STATS
+    if (stats == NULL) {
+        return -1;
+    }
+    memset(stats, 0, sizeof(*stats));
+    for (VadThreadStats* node = VadThreadStatsList().load(std::memory_order_acquire); node != nullptr;
+         node = node->next) {
+        VadStatsAdd(node, stats);
+    }
+    return 0;
+#else
+    (void)stats;
+    return -1;
+#endif
+}
+}  // namespace webrtc
+#endif
@@ -0,0 +1,60 @@
+#ifndef WEBRTC_VAD_VAD_TRACE_HPP
+#define WEBRTC_VAD_VAD_TRACE_HPP
+// Per-frame trace hooks of the VAD pipeline.
+//
+// WebRtcVad_ProcessTraced() and the WebRtcVad_CalcVad*khzTraced() functions
+// take a trace policy, an object with the member functions
+//
+//   void OnFeatures(const VadTraceView& view);
+//   void OnLikelihood(const VadTraceView& view);
+//   void OnFrame(const VadTraceView& view);
+//
+// and a static member |kEnabled|. They are called at these points of
+// WebRtcVad_CalcVad8khz() and GmmProbability():
+//   OnFeatures   - after WebRtcVad_CalculateFeatures(): |features| and
+//                  |total_power|,
+//   OnLikelihood - after the likelihood ratio tests, before the model
+//                  update, for frames above |kMinEnergy| only: also
+//                  |log_likelihood_ratios|, |sum_log_likelihood_ratios| and
+//                  the decision before hangover in |vad|,
+//   OnFrame      - after the model update and the hangover: |vad| is the
+//                  final decision and |state| holds the updated means, stds,
+//                  |over_hang| and |num_of_speech|.
+// Pointers in the view are valid during the call only. The plain functions,
+// e.g., WebRtcVad_CalcVad8khz(), use VadNoTrace, whose empty hooks inline
+// away; per-channel ratios are only collected if |kEnabled| is set.
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace webrtc {
+struct VadInstT_;
+
+typedef struct {
+    // The instance, as of the hook.
+    const struct VadInstT_* state;
+    // Log energy per sub-band in Q4, |kNumChannels| values. The lite mode uses
+    // the first |kNumLiteChannels|, the others are 0.
+    const int16_t* features;
+    int16_t total_power;
+    // Per-channel log2 likelihood ratios of speech over noise, |kNumChannels|
+    // values. NULL before OnLikelihood() and for frames that are not scored.
+    const int16_t* log_likelihood_ratios;
+    int32_t sum_log_likelihood_ratios;
+    // The decision: 0 - noise, 1 - speech, 2 and above - speech held by the
+    // hangover (OnFrame() only).
+    int vad;
+    // Samples of the frame at 8 kHz.
+    size_t frame_length;
+} VadTraceView;
+
+// The default policy: no tracing.
+struct VadNoTrace {
+    static const bool kEnabled = false;
+    void OnFeatures(const VadTraceView&) {}
+    void OnLikelihood(const VadTraceView&) {}
+    void OnFrame(const VadTraceView&) {}
+};
+}  // namespace webrtc
+#endif
@@ -0,0 +1,225 @@
+#ifndef WEBRTC_VAD_VAD_TRACE_WRITER_HPP
+#define WEBRTC_VAD_VAD_TRACE_WRITER_HPP
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "webrtc/vad/vad_trace.hpp"
+#include "webrtc/vad/webrtc_vad.hpp"
+
+namespace webrtc {
+// Binary trace of the features and model state of every frame, written by the
+// VadTraceWriter trace policy and read by vad_trace -d.
+//
+// Layout, all integers little-endian:
+//
+//   header   "VADT", version (16), record size (16), sample rate (32),
+//            mode (16), frame ms (16)
+//   record   frame (64), decision (8), decision before hangover (8, -1 if
+//            the frame was not scored), over_hang (16), num_of_speech (16),
+//            total_power (16), features (6 x 16), log likelihood ratios
+//            (6 x 16, 0 if not scored), sum of the weighted ratios (32),
+//            noise_means, speech_means, noise_stds, speech_stds (12 x 16
+//            each)
+//
+// Records have a fixed size, so the number of frames follows from the file
+// size and record i is at kVadTraceHeaderSize + i * kVadTraceRecordSize.
+// Readers skip fields past the record size they know.
+static const char kVadTraceMagic[4] = {'V', 'A', 'D', 'T'};
+static const uint16_t kVadTraceVersion = 1;
+static const size_t kVadTraceHeaderSize = 16;
+static const size_t kVadTraceRecordSize = 16 + 2 * kNumChannels * 2 + 4 + 4 * kTableSize * 2;
+// Records buffered between writes: 140 kB, one write per 10 s of 10 ms frames.
+static const size_t kVadTraceBufferedRecords = 1024;
+
+static inline void VadTraceWriteLe(uint64_t value, size_t size, uint8_t** p) {
+    for (size_t i = 0; i < size; i++) {
+        (*p)[i] = (uint8_t)(value >> (8 * i));
+    }
+    *p += size;
+}
+
+// Trace policy that streams one record per frame to a file.
+//
+//   VadTraceWriter writer;
+//   if (!writer.Open("speech.vadt", 16000, 10, 2)) { ... }
+//   for (...) WebRtcVad_ProcessTraced(handle, 16000, frame, 160, writer);
+//   if (!writer.Close()) { ... }
+//
+// Records are serialized into a buffer and written in large blocks, so
+// tracing costs a copy of the state per frame and no system call.
+class VadTraceWriter {
+public:
+    static const bool kEnabled = true;
+
+    VadTraceWriter() : file_(nullptr), num_frames_(0), scored_(false), raw_vad_(-1), ok_(false) {}
+
+    VadTraceWriter(const VadTraceWriter&) = delete;
+    VadTraceWriter& operator=(const VadTraceWriter&) = delete;
+
+    ~VadTraceWriter() {
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+    }
+
+    // Creates the trace at |path| for frames of |frame_ms| at |sample_rate_hz|
+    // processed in |mode|; the last three are only recorded in the header.
+    bool Open(const char* path, int sample_rate_hz, int frame_ms, int mode) {
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+        file_ = fopen(path, "wb");
+        if (file_ == nullptr) {
+            fprintf(stderr, "Open %s failed.\n", path);
+            ok_ = false;
+            return false;
+        }
+        num_frames_ = 0;
+        ok_ = true;
+        buffer_.clear();
+        buffer_.reserve(kVadTraceHeaderSize + kVadTraceBufferedRecords * kVadTraceRecordSize);
+
+        buffer_.resize(kVadTraceHeaderSize);
+        uint8_t* p = buffer_.data();
+        memcpy(p, kVadTraceMagic, sizeof(kVadTraceMagic));
+        p += sizeof(kVadTraceMagic);
+        VadTraceWriteLe(kVadTraceVersion, 2, &p);
+        VadTraceWriteLe(kVadTraceRecordSize, 2, &p);
+        VadTraceWriteLe((uint32_t)sample_rate_hz, 4, &p);
+        VadTraceWriteLe((uint16_t)mode, 2, &p);
+        VadTraceWriteLe((uint16_t)frame_ms, 2, &p);
+        return true;
+    }
+
+    // Flushes the buffered records and closes the file. False if any write
+    // failed.
+    bool Close() {
+        if (file_ == nullptr) {
+            return false;
+        }
+        Flush();
+        if (fclose(file_) != 0) {
+            ok_ = false;
+        }
+        file_ = nullptr;
+        return ok_;
+    }
+
+    uint64_t num_frames() const { return num_frames_; }
+
+    void OnFeatures(const VadTraceView&) {
+        scored_ = false;
+        raw_vad_ = -1;
+    }
+
+    void OnLikelihood(const VadTraceView& view) {
+        scored_ = true;
+        raw_vad_ = view.vad;
+    }
+
+    void OnFrame(const VadTraceView& view) {
+        if (file_ == nullptr) {
+            return;
+        }
+        const VadInstT* state = (const VadInstT*)view.state;
+        size_t size = buffer_.size();
+        buffer_.resize(size + kVadTraceRecordSize);
+        uint8_t* p = buffer_.data() + size;
+        VadTraceWriteLe(num_frames_++, 8, &p);
+        VadTraceWriteLe((uint8_t)view.vad, 1, &p);
+        VadTraceWriteLe((uint8_t)raw_vad_, 1, &p);
+        VadTraceWriteLe((uint16_t)state->over_hang, 2, &p);
+        VadTraceWriteLe((uint16_t)state->num_of_speech, 2, &p);
+        VadTraceWriteLe((uint16_t)view.total_power, 2, &p);
+        for (int i = 0; i < kNumChannels; i++) {
+            VadTraceWriteLe((uint16_t)view.features[i], 2, &p);
+        }
+        for (int i = 0; i < kNumChannels; i++) {
+            VadTraceWriteLe(scored_ ? (uint16_t)view.log_likelihood_ratios[i] : 0, 2, &p);
+        }
+        VadTraceWriteLe((uint32_t)view.sum_log_likelihood_ratios, 4, &p);
+        WriteTable(state->noise_means, &p);
+        WriteTable(state->speech_means, &p);
+        WriteTable(state->noise_stds, &p);
+        WriteTable(state->speech_stds, &p);
+        if (buffer_.size() >= kVadTraceBufferedRecords * kVadTraceRecordSize) {
+            Flush();
+        }
+    }
+
+private:
+    static void WriteTable(const int16_t* table, uint8_t** p) {
+        for (int i = 0; i < kTableSize; i++) {
+            VadTraceWriteLe((uint16_t)table[i], 2, p);
+        }
+    }
+
+    void Flush() {
+        if (!buffer_.empty() && fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+            ok_ = false;
+        }
+        buffer_.clear();
+    }
+
+    FILE* file_;
+    std::vector<uint8_t> buffer_;
+    uint64_t num_frames_;
+    bool scored_;
+    int raw_vad_;
+    bool ok_;
+};
+
+// A record of a trace, see the layout above.
+typedef struct {
+    uint64_t frame;
+    int8_t vad;
+    int8_t raw_vad;
+    int16_t over_hang;
+    int16_t num_of_speech;
+    int16_t total_power;
+    int16_t features[kNumChannels];
+    int16_t log_likelihood_ratios[kNumChannels];
+    int32_t sum_log_likelihood_ratios;
+    int16_t noise_means[kTableSize];
+    int16_t speech_means[kTableSize];
+    int16_t noise_stds[kTableSize];
+    int16_t speech_stds[kTableSize];
+} VadTraceRecord;
+
+static inline uint64_t VadTraceReadLe(size_t size, const uint8_t** p) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value |= (uint64_t)(*p)[i] << (8 * i);
+    }
+    *p += size;
+    return value;
+}
+
+// Decodes the record at |data|, kVadTraceRecordSize bytes.
+static inline void WebRtcVad_ReadTraceRecord(const uint8_t* data, VadTraceRecord* record) {
+    const uint8_t* p = data;
+    record->frame = VadTraceReadLe(8, &p);
+    record->vad = (int8_t)VadTraceReadLe(1, &p);
+    record->raw_vad = (int8_t)VadTraceReadLe(1, &p);
+    record->over_hang = (int16_t)VadTraceReadLe(2, &p);
+    record->num_of_speech = (int16_t)VadTraceReadLe(2, &p);
+    record->total_power = (int16_t)VadTraceReadLe(2, &p);
+    for (int i = 0; i < kNumChannels; i++) {
+        record->features[i] = (int16_t)VadTraceReadLe(2, &p);
+    }
+    for (int i = 0; i < kNumChannels; i++) {
+        record->log_likelihood_ratios[i] = (int16_t)VadTraceReadLe(2, &p);
+    }
+    record->sum_log_likelihood_ratios = (int32_t)VadTraceReadLe(4, &p);
+    int16_t* tables[4] = {record->noise_means, record->speech_means, record->noise_stds, record->speech_stds};
+    for (int16_t* table : tables) {
+        for (int i = 0; i < kTableSize; i++) {
+            table[i] = (int16_t)VadTraceReadLe(2, &p);
+        }
+    }
+}
+}  // namespace webrtc
+#endif
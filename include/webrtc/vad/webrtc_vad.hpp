@@ -3,6 +3,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "webrtc/vad/vad_stats.hpp"
+
 namespace webrtc {
 typedef struct WebRtcVadInst VadInst;
 
@@ -39,6 +41,43 @@ int WebRtcVad_Init(VadInst* handle);
 //                       has not been initialized).
 int WebRtcVad_set_mode(VadInst* handle, int mode);
 
+// Enables or disables the cascade mode. In cascade mode, every frame first
+// goes through a cheap energy and peak gate on the raw input. Frames within
+// 3 dB of the tracked floor of the input level, up to about -66 dBFS, skip
+// the feature extraction and the GMM: they are decided like frames below the
+// minimum energy, with the filter states reset. That saves most of the work
+// on digital silence and comfort noise, but the decisions are no longer
+// bit-exact with the default mode; vad -c -d reports how far they diverge on
+// a file. Off after WebRtcVad_Init().
+//
+// - handle [i/o] : VAD instance.
+// - enable [i]   : 1 - cascade mode, 0 - full pipeline on every frame.
+//
+// returns        : 0 - (OK),
+//                 -1 - (null pointer, invalid |enable| or the VAD instance
+//                       has not been initialized).
+int WebRtcVad_set_cascade(VadInst* handle, int enable);
+
+// Enables or disables the lite mode, for cheap first-pass screening. The lite
+// mode stops the split filter tree after two splits and runs the GMM on three
+// sub-bands, 0-1, 1-2 and 2-4 kHz, instead of six, with a model derived from
+// the full one and the same thresholds. It cuts the cost of a frame by about
+// 40% at 8 kHz, less at higher rates where the resampling is unchanged, and
+// misses some quiet or band-limited speech that the full model catches;
+// vad -L -d reports the divergence on a file and vad_bench -L the speed-up.
+// The model starts over, as after WebRtcVad_Init(), so call this before the
+// first frame; the mode and the cascade setting are kept. Off after
+// WebRtcVad_Init(). Model profiles, see vad_model_profile.hpp, are of the
+// full model.
+//
+// - handle [i/o] : VAD instance.
+// - enable [i]   : 1 - lite mode, 0 - full model.
+//
+// returns        : 0 - (OK),
+//                 -1 - (null pointer, invalid |enable| or the VAD instance
+//                       has not been initialized).
+int WebRtcVad_set_lite(VadInst* handle, int enable);
+
 // Calculates a VAD decision for the |audio_frame|. For valid sampling rates
 // frame lengths, see the description of WebRtcVad_ValidRatesAndFrameLengths().
 //
@@ -53,6 +92,26 @@ int WebRtcVad_set_mode(VadInst* handle, int mode);
 //                       -1 - (Error)
 int WebRtcVad_Process(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length);
 
+// Advances the VAD over a gap of |num_frames| frames without audio, such as
+// lost packets, instead of running concealed or silent frames through
+// WebRtcVad_Process(). The cost is bounded whatever the length of the gap:
+// the minimum tracker ages and drops values older than 100 frames exactly as
+// WebRtcVad_Process() would with no new minimum in the gap, the hangover
+// of speech before the gap runs down, and the filter states are reset, so the
+// first frame after the gap starts from a well-defined state. The model is
+// not adapted. Frames are counted at the frame length the instance is used
+// with.
+//
+// - handle     [i/o] : VAD instance.
+// - num_frames [i]   : Number of frames in the gap.
+//
+// returns            : 1 - (the last frame of the gap is still in the hangover
+//                           of speech before it),
+//                      0 - (Non-active Voice, or an empty gap),
+//                     -1 - (null pointer or the VAD instance has not been
+//                           initialized).
+int WebRtcVad_AdvanceGap(VadInst* handle, size_t num_frames);
+
 // Checks for valid combinations of |rate| and |frame_length|. We support 10,
 // 20 and 30 ms frames and the rates 8000, 16000 and 32000 Hz.
 //
@@ -62,9 +121,27 @@ int WebRtcVad_Process(VadInst* handle, int fs, const int16_t* audio_frame, size_
 // returns            : 0 - (valid combination), -1 - (invalid combination)
 int WebRtcVad_ValidRateAndFrameLength(int rate, size_t frame_length);
 
+// Snapshot of the counters of a VAD instance, see vad_stats.hpp. The counters
+// start at zero in WebRtcVad_Init() and are not part of hibernated or
+// snapshotted state. Must not run concurrently with processing on |handle|.
+//
+// - handle   [i] : Initialized VAD instance.
+// - counters [o] : Snapshot.
+//
+// returns        : 0 - (OK),
+//                 -1 - (null pointer, uninitialized instance or built without
+//                       WEBRTC_VAD_STATS).
+int WebRtcVad_GetStats(const VadInst* handle, VadCounters* counters);
+
 #ifdef __cplusplus
 }
 #endif
+
+// Like WebRtcVad_Process(), and also calls the hooks of the trace policy
+// |trace| at defined points of the pipeline, see vad_trace.hpp. Not counted
+// by the instrumentation of vad_stats.hpp.
+template <typename Trace>
+int WebRtcVad_ProcessTraced(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length, Trace& trace);
 }  // namespace webrtc
 
 #include "webrtc/vad/vad_core.hpp"
@@ -101,7 +178,52 @@ inline int WebRtcVad_set_mode(VadInst* handle, int mode) {
     return WebRtcVad_set_mode_core(self, mode);
 }
 
-inline int WebRtcVad_Process(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length) {
+inline int WebRtcVad_set_cascade(VadInst* handle, int enable) {
+    VadInstT* self = (VadInstT*)handle;
+
+    if (handle == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+    if (enable != 0 && enable != 1) {
+        return -1;
+    }
+
+    self->cascade = (int16_t)enable;
+    return 0;
+}
+
+inline int WebRtcVad_set_lite(VadInst* handle, int enable) {
+    VadInstT* self = (VadInstT*)handle;
+
+    if (handle == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+
+    return WebRtcVad_set_lite_core(self, enable);
+}
+
+inline int WebRtcVad_AdvanceGap(VadInst* handle, size_t num_frames) {
+    VadInstT* self = (VadInstT*)handle;
+
+    if (handle == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+
+    return WebRtcVad_AdvanceGapCore(self, num_frames) > 0 ? 1 : 0;
+}
+
+template <typename Trace>
+inline int WebRtcVad_ProcessTraced(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length,
+                                   Trace& trace) {
     int vad = -1;
     VadInstT* self = (VadInstT*)handle;
 
@@ -119,18 +241,69 @@ inline int WebRtcVad_Process(VadInst* handle, int fs, const int16_t* audio_frame
         return -1;
     }
 
-    if (fs == 48000) {
-        vad = WebRtcVad_CalcVad48khz(self, audio_frame, frame_length);
+    if (self->cascade && WebRtcVad_CascadeGate(self, audio_frame, frame_length)) {
+        vad = WebRtcVad_CalcVadGatedTraced(self, frame_length / (size_t)(fs / 8000), trace);
+    } else if (fs == 48000) {
+        vad = WebRtcVad_CalcVad48khzTraced(self, audio_frame, frame_length, trace);
     } else if (fs == 32000) {
-        vad = WebRtcVad_CalcVad32khz(self, audio_frame, frame_length);
+        vad = WebRtcVad_CalcVad32khzTraced(self, audio_frame, frame_length, trace);
     } else if (fs == 16000) {
-        vad = WebRtcVad_CalcVad16khz(self, audio_frame, frame_length);
+        vad = WebRtcVad_CalcVad16khzTraced(self, audio_frame, frame_length, trace);
     } else if (fs == 8000) {
-        vad = WebRtcVad_CalcVad8khz(self, audio_frame, frame_length);
+        vad = WebRtcVad_CalcVad8khzTraced(self, audio_frame, frame_length, trace);
     }
     return vad > 0 ? 1 : vad;
 }
 
+#ifdef WEBRTC_VAD_STATS
+// The counters of |handle|, NULL if it is not an initialized instance.
+static inline VadCounters* VadStatsOf(VadInst* handle) {
+    VadInstT* self = (VadInstT*)handle;
+    return self != NULL && self->init_flag == kInitCheck ? &self->stats : NULL;
+}
+
+// Records a frame of |handle| that started at |start_ns| and returned |vad|,
+// with its low energy flag, which traced frames do not count.
+static inline void VadStatsRecordProcessed(VadInst* handle, int vad, uint64_t start_ns) {
+    VadCounters* counters = VadStatsOf(handle);
+    VadStatsRecordFrame(counters, vad, start_ns);
+    if (vad >= 0 && ((VadInstT*)handle)->low_energy) {
+        VadStatsRecordLowEnergy(counters);
+    }
+}
+#endif
+
+inline int WebRtcVad_Process(VadInst* handle, int fs, const int16_t* audio_frame, size_t frame_length) {
+    VadNoTrace trace;
+#ifdef WEBRTC_VAD_STATS
+    const uint64_t start_ns = VadStatsNow();
+    int vad = WebRtcVad_ProcessTraced(handle, fs, audio_frame, frame_length, trace);
+    VadStatsRecordProcessed(handle, vad, start_ns);
+    return vad;
+#else
+    return WebRtcVad_ProcessTraced(handle, fs, audio_frame, frame_length, trace);
+#endif
+}
+
+inline int WebRtcVad_GetStats(const VadInst* handle, VadCounters* counters) {
+#ifdef WEBRTC_VAD_STATS
+    const VadInstT* self = (const VadInstT*)handle;
+
+    if (handle == NULL || counters == NULL) {
+        return -1;
+    }
+    if (self->init_flag != kInitCheck) {
+        return -1;
+    }
+    *counters = self->stats;
+    return 0;
+#else
+    (void)handle;
+    (void)counters;
+    return -1;
+#endif
+}
+
 inline int WebRtcVad_ValidRateAndFrameLength(int rate, size_t frame_length) {
     int return_value = -1;
     size_t i;
@@ -1,5 +1,13 @@
 #ifndef WEBRTC_WEBRTC_HPP
 #define WEBRTC_WEBRTC_HPP
 #include "webrtc/vad/vad.hpp"
+#include "webrtc/vad/vad_activity.hpp"
+#include "webrtc/vad/vad_analysis.hpp"
+#include "webrtc/vad/vad_model_profile.hpp"
+#include "webrtc/vad/vad_perf.hpp"
+#include "webrtc/vad/vad_state.hpp"
+#include "webrtc/vad/vad_stats.hpp"
+#include "webrtc/vad/vad_trace.hpp"
+#include "webrtc/vad/vad_trace_writer.hpp"
 #include "webrtc/vad/webrtc_vad.hpp"
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+import os
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+setup(
+    name="webrtc_vad",
+    version="0.1.0",
+    description="WebRTC VAD over whole audio buffers, with the GIL released",
+    packages=["webrtc_vad"],
+    ext_modules=[
+        Extension(
+            "webrtc_vad._webrtc_vad",
+            sources=["webrtc_vad/_webrtc_vad.cc"],
+            include_dirs=[os.path.join(here, "..", "include")],
+            extra_compile_args=["-std=c++17", "-O3"],
+            language="c++",
+        )
+    ],
+    extras_require={"numpy": ["numpy"]},
+)
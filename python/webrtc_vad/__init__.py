@@ -0,0 +1,63 @@
+"""WebRTC VAD over whole audio buffers.
+
+    import webrtc_vad
+    vad = webrtc_vad.Vad(mode=2, sample_rate=16000, frame_ms=10)
+    decisions = vad.process(samples)                  # uint8, one per frame
+    scores = vad.process(samples, output="scores")    # int32
+    features = vad.process(samples, output="features")  # int16, (frames, 6)
+
+|samples| may be any C-contiguous int16 or float32 buffer (numpy array,
+array.array, memoryview). It is read in place and processed with the GIL
+released, so Python threads running separate Vad instances run in parallel.
+Results are numpy arrays when numpy is installed and memoryviews otherwise;
+both share memory with the buffer returned by the native module.
+"""
+from . import _webrtc_vad
+
+try:
+    import numpy as _np
+except ImportError:
+    _np = None
+
+__all__ = ["Vad", "process"]
+
+# Per-frame record of each output: struct format, numpy dtype, values.
+_OUTPUTS = {
+    "decisions": ("B", "uint8", 1),
+    "scores": ("i", "int32", 1),
+    "features": ("h", "int16", 6),
+}
+
+
+def _wrap(raw, output):
+    fmt, dtype, width = _OUTPUTS[output]
+    if _np is not None:
+        array = _np.frombuffer(raw, dtype=dtype)
+        return array.reshape(-1, width) if width > 1 else array
+    view = memoryview(raw).cast(fmt)
+    if width > 1 and len(view) > 0:
+        view = memoryview(raw).cast(fmt, (len(view) // width, width))
+    return view
+
+
+class Vad(_webrtc_vad.Vad):
+    """Vad(mode=0, sample_rate=16000, frame_ms=10)
+
+    A VAD stream. Samples of a trailing partial frame are carried over to the
+    next process() call, so a recording may be fed in chunks of any size.
+    """
+
+    def process(self, samples, output="decisions"):
+        """Runs the VAD over all whole frames of |samples|.
+
+        output: "decisions" (0 or 1 per frame), "scores" (spectrum-weighted
+        log2 likelihood ratio of speech over noise per frame, 0 for frames
+        too quiet to score) or "features" (log energy of the 6 sub-bands per
+        frame, Q4).
+        """
+        return _wrap(super().process(samples, output), output)
+
+
+def process(samples, sample_rate=16000, mode=0, frame_ms=10, output="decisions"):
+    """Runs a fresh Vad over |samples|, see Vad.process()."""
+    return Vad(mode, sample_rate, frame_ms).process(samples, output)
@@ -0,0 +1,348 @@
+// Native part of the webrtc_vad Python package.
+//
+// Vad.process() takes any C-contiguous buffer of int16 or float32 samples
+// (numpy arrays, array.array, memoryviews, ...) and runs the VAD over all of
+// its whole frames in one call, reading the samples in place and with the GIL
+// released. Results are returned as a bytearray that the Python side wraps
+// without copying, see __init__.py.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include <math.h>
+#include <string.h>
+
+#include "webrtc/webrtc.hpp"
+
+using namespace webrtc;
+
+namespace {
+// 30 ms at 48 kHz.
+const size_t kMaxFrameSamples = 1440;
+
+enum Output { kDecisions, kScores, kFeatures };
+enum SampleType { kInt16, kFloat32 };
+
+struct VadObject {
+    PyObject_HEAD
+    VadInst* handle;
+    int mode;
+    int sample_rate_hz;
+    size_t frame_length;
+    // Set while process() runs without the GIL, to reject concurrent calls on
+    // the same instance.
+    bool busy;
+    // Samples of a partial frame, carried over to the next process() call.
+    int16_t carry[kMaxFrameSamples];
+    size_t carry_length;
+};
+
+// Bytes written per frame for |output|.
+size_t RecordSize(Output output) {
+    switch (output) {
+        case kScores:
+            return sizeof(int32_t);
+        case kFeatures:
+            return kNumChannels * sizeof(int16_t);
+        default:
+            return sizeof(uint8_t);
+    }
+}
+
+bool ParseOutput(const char* name, Output* output) {
+    if (strcmp(name, "decisions") == 0) {
+        *output = kDecisions;
+    } else if (strcmp(name, "scores") == 0) {
+        *output = kScores;
+    } else if (strcmp(name, "features") == 0) {
+        *output = kFeatures;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Accepts native or little-endian 'h' and 'f' buffer formats.
+bool ParseFormat(const Py_buffer& view, SampleType* type) {
+    const char* format = view.format != nullptr ? view.format : "B";
+    if (*format == '@' || *format == '=' || *format == '<') {
+        format++;
+    }
+    if (strcmp(format, "h") == 0 && view.itemsize == sizeof(int16_t)) {
+        *type = kInt16;
+    } else if (strcmp(format, "f") == 0 && view.itemsize == sizeof(float)) {
+        *type = kFloat32;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Converts float samples in [-1, 1] to int16, saturating.
+void FloatToInt16(const float* in, size_t length, int16_t* out) {
+    for (size_t i = 0; i < length; i++) {
+        float value = in[i] * 32768.0f;
+        if (value >= 32767.0f) {
+            out[i] = 32767;
+        } else if (value <= -32768.0f) {
+            out[i] = -32768;
+        } else if (value == value) {
+            out[i] = (int16_t)lrintf(value);
+        } else {
+            out[i] = 0;  // NaN.
+        }
+    }
+}
+
+// Runs one frame and writes its record to |out|. Returns -1 on error.
+int ProcessFrame(VadObject* self, const int16_t* frame, Output output, uint8_t* out) {
+    VadFrameAnalysis analysis;
+    int vad;
+
+    if (output == kDecisions) {
+        vad = WebRtcVad_Process(self->handle, self->sample_rate_hz, frame, self->frame_length);
+        *out = (uint8_t)vad;
+        return vad;
+    }
+    vad = WebRtcVad_ProcessWithAnalysis(self->handle, self->sample_rate_hz, frame, self->frame_length, &analysis);
+    if (vad < 0) {
+        return vad;
+    }
+    if (output == kScores) {
+        memcpy(out, &analysis.sum_log_likelihood_ratios, sizeof(int32_t));
+    } else {
+        memcpy(out, analysis.features, sizeof(analysis.features));
+    }
+    return vad;
+}
+
+// Runs all whole frames of |self->carry| followed by |samples|, keeping the
+// remainder in |self->carry|. Called without the GIL. Returns -1 on error.
+int ProcessSamples(VadObject* self, const void* samples, size_t num_samples, SampleType type, Output output,
+                   uint8_t* out) {
+    const size_t frame_length = self->frame_length;
+    const size_t record_size = RecordSize(output);
+    const int16_t* pcm = static_cast<const int16_t*>(samples);
+    const float* pcm_float = static_cast<const float*>(samples);
+    int16_t converted[kMaxFrameSamples];
+    size_t offset = 0;
+
+    if (self->carry_length > 0) {
+        size_t take = frame_length - self->carry_length;
+        if (take > num_samples) {
+            take = num_samples;
+        }
+        if (type == kInt16) {
+            memcpy(&self->carry[self->carry_length], pcm, take * sizeof(int16_t));
+        } else {
+            FloatToInt16(pcm_float, take, &self->carry[self->carry_length]);
+        }
+        self->carry_length += take;
+        offset = take;
+        if (self->carry_length < frame_length) {
+            return 0;
+        }
+        if (ProcessFrame(self, self->carry, output, out) < 0) {
+            return -1;
+        }
+        out += record_size;
+        self->carry_length = 0;
+    }
+
+    for (; offset + frame_length <= num_samples; offset += frame_length) {
+        const int16_t* frame = &pcm[offset];
+        if (type == kFloat32) {
+            FloatToInt16(&pcm_float[offset], frame_length, converted);
+            frame = converted;
+        }
+        if (ProcessFrame(self, frame, output, out) < 0) {
+            return -1;
+        }
+        out += record_size;
+    }
+
+    self->carry_length = num_samples - offset;
+    if (type == kInt16) {
+        memcpy(self->carry, &pcm[offset], self->carry_length * sizeof(int16_t));
+    } else {
+        FloatToInt16(&pcm_float[offset], self->carry_length, self->carry);
+    }
+    return 0;
+}
+
+bool InitHandle(VadObject* self) {
+    if (self->handle == nullptr) {
+        self->handle = WebRtcVad_Create();
+    }
+    self->carry_length = 0;
+    return self->handle != nullptr && WebRtcVad_Init(self->handle) == 0 &&
+           WebRtcVad_set_mode(self->handle, self->mode) == 0;
+}
+
+int Vad_init(VadObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"mode", "sample_rate", "frame_ms", nullptr};
+    int mode = 0;
+    int sample_rate_hz = 16000;
+    int frame_ms = 10;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iii", const_cast<char**>(keywords), &mode, &sample_rate_hz,
+                                     &frame_ms)) {
+        return -1;
+    }
+    if (mode < 0 || mode > 3) {
+        PyErr_SetString(PyExc_ValueError, "mode must be 0, 1, 2 or 3");
+        return -1;
+    }
+    if (frame_ms <= 0 || WebRtcVad_ValidRateAndFrameLength(sample_rate_hz, sample_rate_hz / 1000 * frame_ms) != 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "sample_rate must be 8000, 16000, 32000 or 48000 and frame_ms 10, 20 or 30");
+        return -1;
+    }
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Vad is in use by another thread");
+        return -1;
+    }
+
+    self->mode = mode;
+    self->sample_rate_hz = sample_rate_hz;
+    self->frame_length = (size_t)(sample_rate_hz / 1000 * frame_ms);
+    if (!InitHandle(self)) {
+        PyErr_SetString(PyExc_MemoryError, "Init vad handle failed");
+        return -1;
+    }
+    return 0;
+}
+
+void Vad_dealloc(VadObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    WebRtcVad_Free(self->handle);
+    type->tp_free(reinterpret_cast<PyObject*>(self));
+    Py_DECREF(type);
+}
+
+PyObject* Vad_process(VadObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"samples", "output", nullptr};
+    PyObject* samples;
+    const char* output_name = "decisions";
+    Output output;
+    SampleType type;
+    Py_buffer view;
+    int ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|s", const_cast<char**>(keywords), &samples, &output_name)) {
+        return nullptr;
+    }
+    if (!ParseOutput(output_name, &output)) {
+        PyErr_Format(PyExc_ValueError, "output must be 'decisions', 'scores' or 'features', not '%s'", output_name);
+        return nullptr;
+    }
+    if (self->handle == nullptr) {
+        PyErr_SetString(PyExc_RuntimeError, "Vad is not initialized");
+        return nullptr;
+    }
+    if (PyObject_GetBuffer(samples, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        return nullptr;
+    }
+    if (!ParseFormat(view, &type)) {
+        PyErr_Format(PyExc_TypeError, "samples must be int16 or float32, not format '%s'",
+                     view.format != nullptr ? view.format : "B");
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Vad is in use by another thread");
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+
+    size_t num_samples = (size_t)(view.len / view.itemsize);
+    size_t num_frames = (self->carry_length + num_samples) / self->frame_length;
+    PyObject* result = PyByteArray_FromStringAndSize(nullptr, (Py_ssize_t)(num_frames * RecordSize(output)));
+    if (result == nullptr) {
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+    uint8_t* out = reinterpret_cast<uint8_t*>(PyByteArray_AS_STRING(result));
+
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    ret = ProcessSamples(self, view.buf, num_samples, type, output, out);
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyBuffer_Release(&view);
+    if (ret != 0) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_RuntimeError, "vad process failed");
+        return nullptr;
+    }
+    return result;
+}
+
+PyObject* Vad_reset(VadObject* self, PyObject*) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Vad is in use by another thread");
+        return nullptr;
+    }
+    if (!InitHandle(self)) {
+        PyErr_SetString(PyExc_MemoryError, "Init vad handle failed");
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* Vad_get_pending(VadObject* self, void*) { return PyLong_FromSize_t(self->carry_length); }
+
+PyMethodDef kVadMethods[] = {
+    {"process", reinterpret_cast<PyCFunction>(Vad_process), METH_VARARGS | METH_KEYWORDS,
+     "process(samples, output='decisions')\n--\n\n"
+     "Runs the VAD over all whole frames of |samples|, a C-contiguous int16 or\n"
+     "float32 buffer. Samples of a trailing partial frame are kept for the next\n"
+     "call. Returns a bytearray with one record per frame: uint8 decisions,\n"
+     "int32 scores (weighted log2 likelihood ratio) or 6 int16 features (log\n"
+     "energy per band, Q4)."},
+    {"reset", reinterpret_cast<PyCFunction>(Vad_reset), METH_NOARGS,
+     "reset()\n--\n\nRestarts the instance from its initial state."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyMemberDef kVadMembers[] = {
+    {const_cast<char*>("mode"), T_INT, offsetof(VadObject, mode), READONLY, nullptr},
+    {const_cast<char*>("sample_rate"), T_INT, offsetof(VadObject, sample_rate_hz), READONLY, nullptr},
+    {const_cast<char*>("frame_length"), T_PYSSIZET, offsetof(VadObject, frame_length), READONLY,
+     const_cast<char*>("Frame length in samples.")},
+    {nullptr, 0, 0, 0, nullptr}};
+
+PyGetSetDef kVadGetSet[] = {
+    {const_cast<char*>("pending"), reinterpret_cast<getter>(Vad_get_pending), nullptr,
+     const_cast<char*>("Number of samples carried over to the next process() call."), nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyType_Slot kVadSlots[] = {{Py_tp_init, reinterpret_cast<void*>(Vad_init)},
+                           {Py_tp_dealloc, reinterpret_cast<void*>(Vad_dealloc)},
+                           {Py_tp_methods, kVadMethods},
+                           {Py_tp_members, kVadMembers},
+                           {Py_tp_getset, kVadGetSet},
+                           {Py_tp_doc, const_cast<char*>("Vad(mode=0, sample_rate=16000, frame_ms=10)")},
+                           {0, nullptr}};
+
+PyType_Spec kVadSpec = {"webrtc_vad._webrtc_vad.Vad", sizeof(VadObject), 0,
+                        Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, kVadSlots};
+
+int ModuleExec(PyObject* module) {
+    PyObject* type = PyType_FromSpec(&kVadSpec);
+    if (type == nullptr) {
+        return -1;
+    }
+    if (PyModule_AddObject(module, "Vad", type) != 0) {
+        Py_DECREF(type);
+        return -1;
+    }
+    return 0;
+}
+
+PyModuleDef_Slot kModuleSlots[] = {{Py_mod_exec, reinterpret_cast<void*>(ModuleExec)}, {0, nullptr}};
+
+PyModuleDef kModule = {PyModuleDef_HEAD_INIT, "_webrtc_vad", nullptr, 0, nullptr, kModuleSlots, nullptr, nullptr,
+                       nullptr};
+}  // namespace
+
+PyMODINIT_FUNC PyInit__webrtc_vad(void) { return PyModuleDef_Init(&kModule); }
@@ -0,0 +1,623 @@
+// vad: speech segments of many audio files, in parallel.
+//
+//   vad [-j threads] [-m mode] [-f frame_ms] [-k chunks [-w warmup_seconds] [-d] | [-c] [-L] [-d]]
+//       [-F csv|jsonl|vda [-s]] [-o output] [-l list]... [file.wav | directory]...
+//
+// Inputs are WAVE files, directories (searched recursively for *.wav) and
+// lists of paths, one per line, given with -l ("-" for stdin). Files are
+// processed by a pool of |threads| workers fed through a bounded queue, so
+// memory stays flat however large the corpus: each worker holds one mapped
+// file and its segments at a time, and vda only keeps the archive paths.
+//
+// Output (stdout unless -o) has one record per speech segment for csv,
+//   path,start_seconds,end_seconds
+// and one record per file for jsonl,
+//   {"file":"path","duration":12.34,"segments":[[0.21,3.05],...]}
+// in order of completion. vda writes a binary archive of the decisions of
+// each file (see vad_archive.hpp, queried with vad_query) to path.vda, or to
+// the same path under the directory given with -o, mirroring the input
+// directories (absolute paths without their root, leading ".." dropped); -s
+// adds the quantized score of every frame. A file whose archive path another
+// input of the run already took fails instead of overwriting it.
+// Files that cannot be processed are reported on stderr and counted, and a
+// throughput summary is printed there at the end.
+//
+// For long recordings, -k splits each file into |chunks| parts processed on
+// as many threads, each warmed up on the preceding |warmup_seconds| (default
+// 30) of audio, see VadProcessChunked(). -d also runs each file serially and
+// reports on stderr how far the chunked decisions diverge, to choose the
+// warm-up for a corpus.
+//
+// -c runs the VAD in cascade mode, which skips most of the work on silence
+// and comfort noise at the cost of bit-exactness, see WebRtcVad_set_cascade().
+// -L runs it in lite mode, a cheaper screening pass on three sub-bands, see
+// WebRtcVad_set_lite(). -d then also runs each file in the default mode and
+// reports on stderr how many decisions differ, how many of them are speech
+// the default mode found and the time both runs took, to check the trade-off
+// on a corpus.
+//
+// Built with -DWEBRTC_VAD_PERF, the hardware counters of each pipeline stage
+// over all files are printed on stderr at the end, see vad_perf.hpp.
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "vad_archive.hpp"
+#include "webrtc/common_audio/wav_reader.hpp"
+#include "webrtc/vad/vad_chunked.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+// Paths queued per worker; bounds memory when inputs are enumerated faster
+// than they are processed.
+static const size_t kQueuedPathsPerWorker = 16;
+
+enum OutputFormat { kCsv, kJsonl, kVda };
+
+struct Options {
+    size_t num_threads = 0;
+    int mode = 0;
+    int frame_ms = 10;
+    size_t num_chunks = 1;
+    double warmup_seconds = 30;
+    bool divergence = false;
+    bool cascade = false;
+    bool lite = false;
+    OutputFormat format = kCsv;
+    bool scores = false;
+    string output_path;
+    vector<string> lists;
+    vector<string> inputs;
+};
+
+// A speech segment, in frames.
+struct Segment {
+    uint64_t start;
+    uint64_t end;
+};
+
+// What ProcessFile() found in a file.
+struct FileResult {
+    int sample_rate;
+    uint64_t num_frames;
+    vector<Segment> segments;
+    // Score of every frame, with |Options::scores|.
+    vector<int32_t> scores;
+    // Divergence report of a chunked run, for stderr.
+    string report;
+};
+
+// Bounded multi-producer/multi-consumer queue of paths.
+class PathQueue {
+public:
+    explicit PathQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+    void Push(string path) {
+        unique_lock<mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return paths_.size() < capacity_; });
+        paths_.push_back(move(path));
+        not_empty_.notify_one();
+    }
+
+    // Returns false once the queue is closed and empty.
+    bool Pop(string* path) {
+        unique_lock<mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return !paths_.empty() || closed_; });
+        if (paths_.empty()) {
+            return false;
+        }
+        *path = move(paths_.front());
+        paths_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void Close() {
+        lock_guard<mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    bool closed_;
+    deque<string> paths_;
+    mutex mutex_;
+    condition_variable not_empty_;
+    condition_variable not_full_;
+};
+
+// Serializes records from the workers to the output and keeps the totals.
+class Output {
+public:
+    Output(FILE* file, OutputFormat format, int frame_ms)
+        : file_(file), format_(format), frame_seconds_(frame_ms / 1000.0) {}
+
+    // Writes the segments of a file, and its report to stderr. Archives are
+    // written by the workers, see WriteArchive().
+    void Write(const string& path, const FileResult& result) {
+        const uint64_t num_frames = result.num_frames;
+        const vector<Segment>& segments = result.segments;
+        string record;
+        char number[64];
+        if (format_ == kCsv) {
+            string escaped = EscapeCsv(path);
+            for (const Segment& segment : segments) {
+                snprintf(number, sizeof(number), ",%.2f,%.2f\n", segment.start * frame_seconds_,
+                         segment.end * frame_seconds_);
+                record += escaped;
+                record += number;
+            }
+        } else if (format_ == kJsonl) {
+            record = "{\"file\":" + EscapeJson(path);
+            snprintf(number, sizeof(number), ",\"duration\":%.2f,\"segments\":[", num_frames * frame_seconds_);
+            record += number;
+            for (size_t i = 0; i < segments.size(); i++) {
+                snprintf(number, sizeof(number), "%s[%.2f,%.2f]", i > 0 ? "," : "", segments[i].start * frame_seconds_,
+                         segments[i].end * frame_seconds_);
+                record += number;
+            }
+            record += "]}\n";
+        }
+
+        lock_guard<mutex> lock(mutex_);
+        fwrite(record.data(), 1, record.size(), file_);
+        fputs(result.report.c_str(), stderr);
+        files_++;
+        audio_seconds_ += num_frames * frame_seconds_;
+    }
+
+    void Fail(const string& path) {
+        lock_guard<mutex> lock(mutex_);
+        fprintf(stderr, "vad: failed to process %s\n", path.c_str());
+        failures_++;
+    }
+
+    uint64_t files() const { return files_; }
+    uint64_t failures() const { return failures_; }
+    double audio_seconds() const { return audio_seconds_; }
+
+private:
+    static string EscapeCsv(const string& value) {
+        if (value.find_first_of(",\"\n") == string::npos) {
+            return value;
+        }
+        string escaped = "\"";
+        for (char c : value) {
+            escaped += c;
+            if (c == '"') {
+                escaped += c;
+            }
+        }
+        return escaped + "\"";
+    }
+
+    static string EscapeJson(const string& value) {
+        string escaped = "\"";
+        for (unsigned char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += (char)c;
+            } else if (c < 0x20) {
+                char code[8];
+                snprintf(code, sizeof(code), "\\u%04x", c);
+                escaped += code;
+            } else {
+                escaped += (char)c;
+            }
+        }
+        return escaped + "\"";
+    }
+
+    FILE* file_;
+    const OutputFormat format_;
+    const double frame_seconds_;
+    mutex mutex_;
+    uint64_t files_ = 0;
+    uint64_t failures_ = 0;
+    double audio_seconds_ = 0;
+};
+
+// Adds frame |frame| with decision |speech| to |segments|; |in_speech| holds
+// the decision of the previous frame.
+static void AddFrame(uint64_t frame, bool speech, bool* in_speech, vector<Segment>* segments) {
+    if (speech && !*in_speech) {
+        segments->push_back({frame, frame});
+    }
+    if (speech) {
+        segments->back().end = frame + 1;
+    }
+    *in_speech = speech;
+}
+
+// Splits the file into |options.num_chunks| chunks run in parallel, see
+// VadProcessChunked(). With |options.divergence| the file is also run
+// serially and the divergence of the chunked decisions reported.
+static bool ProcessChunked(const string& path, const WavReader& reader, const Options& options, FileResult* result) {
+    const uint64_t num_frames = result->num_frames;
+    const int sample_rate = reader.sample_rate();
+    const size_t frame_length = (size_t)(sample_rate / 1000 * options.frame_ms);
+    const size_t warmup_frames = (size_t)(options.warmup_seconds * 1000 / options.frame_ms);
+    const Vad::Aggressiveness aggressiveness = static_cast<Vad::Aggressiveness>(options.mode);
+    vector<int16_t> converted;
+    const int16_t* audio = reader.samples();
+    if (audio == nullptr) {
+        converted.resize(num_frames * frame_length);
+        reader.GetFrame(0, converted.size(), converted.data());
+        audio = converted.data();
+    }
+
+    vector<Vad::Activity> decisions(num_frames);
+    if (!VadProcessChunked(aggressiveness, audio, num_frames, frame_length, sample_rate, options.num_chunks,
+                           warmup_frames, decisions.data())) {
+        return false;
+    }
+    bool in_speech = false;
+    for (uint64_t i = 0; i < num_frames; i++) {
+        AddFrame(i, decisions[i] == Vad::kActive, &in_speech, &result->segments);
+    }
+    if (!options.divergence) {
+        return true;
+    }
+
+    vector<Vad::Activity> serial(num_frames);
+    if (!VadProcessChunked(aggressiveness, audio, num_frames, frame_length, sample_rate, 1, 0, serial.data())) {
+        return false;
+    }
+    vector<VadChunkDivergence> divergence;
+    size_t mismatches =
+        VadCompareChunked(serial.data(), decisions.data(), num_frames, options.num_chunks, &divergence);
+    double worst = 0;
+    for (const VadChunkDivergence& entry : divergence) {
+        worst = max(worst, entry.length > 0 ? 100.0 * entry.mismatches / entry.length : 0.0);
+    }
+    char line[256];
+    snprintf(line, sizeof(line),
+             ": %zu chunks, %.1f s warm-up: %zu of %llu frames differ (%.3f%%, worst chunk %.3f%%)\n",
+             divergence.size(), options.warmup_seconds, mismatches, (unsigned long long)num_frames,
+             num_frames > 0 ? 100.0 * mismatches / num_frames : 0.0, worst);
+    result->report = path + line;
+    return true;
+}
+
+// Runs |reader| through a new instance in the default mode and reports on the
+// divergence of the cascade or lite mode |decisions|, which took |seconds|.
+static bool ReportDivergence(const string& path, const WavReader& reader, const Options& options,
+                             const vector<char>& decisions, double seconds, FileResult* result) {
+    const int sample_rate = reader.sample_rate();
+    const size_t frame_length = (size_t)(sample_rate / 1000 * options.frame_ms);
+    int16_t buffer[480 * 3];
+    Vad vad(static_cast<Vad::Aggressiveness>(options.mode));
+    if (!vad.Init()) {
+        return false;
+    }
+    size_t mismatches = 0;
+    size_t missed = 0;
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < result->num_frames; i++) {
+        Vad::Activity activity = vad.IsSpeech(reader.GetFrame(i * frame_length, frame_length, buffer), frame_length,
+                                              sample_rate);
+        if (activity == Vad::kError) {
+            return false;
+        }
+        if ((activity == Vad::kActive) != (decisions[i] != 0)) {
+            mismatches++;
+            missed += activity == Vad::kActive;
+        }
+    }
+    double default_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const char* name = options.cascade && options.lite ? "cascade, lite" : options.lite ? "lite" : "cascade";
+    char line[256];
+    snprintf(line, sizeof(line),
+             ": %s: %zu of %llu frames differ (%.3f%%, %zu speech frames missed), %.3f s vs %.3f s (%.1fx)\n", name,
+             mismatches, (unsigned long long)result->num_frames,
+             result->num_frames > 0 ? 100.0 * mismatches / result->num_frames : 0.0, missed, seconds, default_seconds,
+             seconds > 0 ? default_seconds / seconds : 0.0);
+    result->report = path + line;
+    return true;
+}
+
+// Runs the VAD over the whole file at |path| and collects its speech segments,
+// and scores with |options.scores|, on |vad| or, with |options.num_chunks|
+// above one, on that many threads. Returns false if the file cannot be read.
+static bool ProcessFile(const string& path, const Options& options, Vad* vad, FileResult* result) {
+    WavReader reader;
+    if (!reader.Open(path.c_str())) {
+        return false;
+    }
+    const int sample_rate = reader.sample_rate();
+    const size_t frame_length = (size_t)(sample_rate / 1000 * options.frame_ms);
+    int16_t buffer[480 * 3];
+
+    result->sample_rate = sample_rate;
+    result->num_frames = reader.num_samples() / frame_length;
+    result->segments.clear();
+    result->scores.clear();
+    result->report.clear();
+    if (options.num_chunks > 1) {
+        return ProcessChunked(path, reader, options, result);
+    }
+
+    if (!vad->Init() || (options.cascade && !vad->SetCascade(true)) || (options.lite && !vad->SetLite(true))) {
+        return false;
+    }
+    const bool report = (options.cascade || options.lite) && options.divergence;
+    vector<char> decisions;
+    bool in_speech = false;
+    VadFrameAnalysis analysis;
+    auto start = chrono::steady_clock::now();
+    for (uint64_t i = 0; i < result->num_frames; i++) {
+        const int16_t* frame = reader.GetFrame(i * frame_length, frame_length, buffer);
+        Vad::Activity activity = options.scores ? vad->IsSpeech(frame, frame_length, sample_rate, &analysis)
+                                                : vad->IsSpeech(frame, frame_length, sample_rate);
+        if (activity == Vad::kError) {
+            return false;
+        }
+        AddFrame(i, activity == Vad::kActive, &in_speech, &result->segments);
+        if (options.scores) {
+            result->scores.push_back(analysis.sum_log_likelihood_ratios);
+        }
+        if (report) {
+            decisions.push_back(activity == Vad::kActive);
+        }
+    }
+    if (report) {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return ReportDivergence(path, reader, options, decisions, seconds, result);
+    }
+    return true;
+}
+
+// The archive paths taken in this run, so that two inputs never write the
+// same archive. Holds one path per archive written.
+class ArchivePaths {
+public:
+    // Returns false if |archive_path| was already taken.
+    bool Take(const string& archive_path) {
+        lock_guard<mutex> lock(mutex_);
+        return paths_.insert(archive_path).second;
+    }
+
+private:
+    unordered_set<string> paths_;
+    mutex mutex_;
+};
+
+// Where the archive of |path| goes: next to it, or in |options.output_path|
+// at the relative path of the input.
+static string ArchivePath(const string& path, const Options& options) {
+    if (options.output_path.empty()) {
+        return path + ".vda";
+    }
+    filesystem::path relative;
+    for (const filesystem::path& part : filesystem::path(path).lexically_normal().relative_path()) {
+        if (!relative.empty() || part != "..") {
+            relative /= part;
+        }
+    }
+    return (filesystem::path(options.output_path) / relative).string() + ".vda";
+}
+
+// Writes the decisions, and scores if any, of a file to its archive.
+static bool WriteArchive(const string& path, const Options& options, const FileResult& result,
+                         ArchivePaths* archive_paths) {
+    VadArchiveWriter writer;
+    string archive_path = ArchivePath(path, options);
+    if (!archive_paths->Take(archive_path)) {
+        fprintf(stderr, "vad: %s would overwrite the archive %s of another input\n", path.c_str(),
+                archive_path.c_str());
+        return false;
+    }
+    error_code error;
+    filesystem::path directory = filesystem::path(archive_path).parent_path();
+    if (!directory.empty() && !filesystem::create_directories(directory, error) && error) {
+        fprintf(stderr, "vad: cannot create %s: %s\n", directory.c_str(), error.message().c_str());
+        return false;
+    }
+    if (!writer.Open(archive_path.c_str(), result.sample_rate, options.frame_ms, options.mode,
+                     !result.scores.empty())) {
+        return false;
+    }
+    if (!result.scores.empty()) {
+        size_t segment = 0;
+        for (uint64_t i = 0; i < result.num_frames; i++) {
+            while (segment < result.segments.size() && result.segments[segment].end <= i) {
+                segment++;
+            }
+            bool speech = segment < result.segments.size() && result.segments[segment].start <= i;
+            writer.Append(speech, result.scores[i]);
+        }
+    } else {
+        uint64_t frame = 0;
+        for (const Segment& segment : result.segments) {
+            writer.AppendRun(false, segment.start - frame);
+            writer.AppendRun(true, segment.end - segment.start);
+            frame = segment.end;
+        }
+        writer.AppendRun(false, result.num_frames - frame);
+    }
+    return writer.Close();
+}
+
+static bool IsWav(const filesystem::path& path) {
+    string extension = path.extension().string();
+    return strcasecmp(extension.c_str(), ".wav") == 0;
+}
+
+// Queues every input path; directories are walked lazily, so the walk is
+// throttled by the queue like everything else.
+static void EnumerateInputs(const Options& options, PathQueue* queue) {
+    for (const string& list : options.lists) {
+        ifstream file;
+        istream* in = &cin;
+        if (list != "-") {
+            file.open(list);
+            if (!file) {
+                fprintf(stderr, "vad: cannot read list %s\n", list.c_str());
+                continue;
+            }
+            in = &file;
+        }
+        string line;
+        while (getline(*in, line)) {
+            if (!line.empty()) {
+                queue->Push(line);
+            }
+        }
+    }
+    for (const string& input : options.inputs) {
+        error_code error;
+        if (!filesystem::is_directory(input, error)) {
+            queue->Push(input);
+            continue;
+        }
+        filesystem::recursive_directory_iterator it(input, filesystem::directory_options::skip_permission_denied,
+                                                    error);
+        for (; !error && it != filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (it->is_regular_file(error) && IsWav(it->path())) {
+                queue->Push(it->path().string());
+            }
+        }
+        if (error) {
+            fprintf(stderr, "vad: cannot walk %s: %s\n", input.c_str(), error.message().c_str());
+        }
+    }
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options->num_threads = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            options->mode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            options->frame_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            options->num_chunks = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options->warmup_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            options->divergence = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            options->cascade = true;
+        } else if (strcmp(argv[i], "-L") == 0) {
+            options->lite = true;
+        } else if (strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) {
+                options->format = kCsv;
+            } else if (strcmp(argv[i], "jsonl") == 0) {
+                options->format = kJsonl;
+            } else if (strcmp(argv[i], "vda") == 0) {
+                options->format = kVda;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "-s") == 0) {
+            options->scores = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            options->lists.push_back(argv[++i]);
+        } else if (argv[i][0] != '-' || argv[i][1] == '\0') {
+            options->inputs.push_back(argv[i]);
+        } else {
+            return false;
+        }
+    }
+    if (options->num_threads == 0) {
+        options->num_threads = max(1u, thread::hardware_concurrency());
+    }
+    return options->mode >= 0 && options->mode <= 3 && options->num_chunks >= 1 && options->warmup_seconds >= 0 &&
+           (options->frame_ms == 10 || options->frame_ms == 20 || options->frame_ms == 30) &&
+           (!options->scores || (options->format == kVda && options->num_chunks == 1)) &&
+           ((!options->cascade && !options->lite) || options->num_chunks == 1) &&
+           (!options->inputs.empty() || !options->lists.empty());
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-j threads] [-m mode] [-f frame_ms] [-k chunks [-w warmup_seconds] [-d] | [-c] [-L] [-d]]\n"
+                "       [-F csv|jsonl|vda [-s]] [-o output] [-l list]... [file.wav | directory]...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* file = stdout;
+    if (options.format == kVda) {
+        error_code error;
+        if (!options.output_path.empty() && !filesystem::is_directory(options.output_path, error)) {
+            fprintf(stderr, "vad: %s is not a directory\n", options.output_path.c_str());
+            return EXIT_FAILURE;
+        }
+    } else if (!options.output_path.empty()) {
+        file = fopen(options.output_path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "vad: cannot write %s: %s\n", options.output_path.c_str(), strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.format == kCsv) {
+        fprintf(file, "file,start,end\n");
+    }
+
+    Output output(file, options.format, options.frame_ms);
+    PathQueue queue(options.num_threads * kQueuedPathsPerWorker);
+    ArchivePaths archive_paths;
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for (size_t i = 0; i < options.num_threads; i++) {
+        workers.emplace_back([&options, &queue, &output, &archive_paths] {
+            Vad vad(static_cast<Vad::Aggressiveness>(options.mode));
+            FileResult result;
+            string path;
+            while (queue.Pop(&path)) {
+                if (ProcessFile(path, options, &vad, &result) &&
+                    (options.format != kVda || WriteArchive(path, options, result, &archive_paths))) {
+                    output.Write(path, result);
+                } else {
+                    output.Fail(path);
+                }
+            }
+        });
+    }
+    EnumerateInputs(options, &queue);
+    queue.Close();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    bool ok = fflush(file) == 0 && (file == stdout || fclose(file) == 0);
+    double audio_hours = output.audio_seconds() / 3600;
+    fprintf(stderr,
+            "vad: %llu files (%llu failed), %.2f audio hours in %.2f s on %zu threads: "
+            "%.1f files/s, %.3f audio hours/s (%.0fx real time)\n",
+            (unsigned long long)output.files(), (unsigned long long)output.failures(), audio_hours, elapsed,
+            options.num_threads, elapsed > 0 ? output.files() / elapsed : 0.0,
+            elapsed > 0 ? audio_hours / elapsed : 0.0, elapsed > 0 ? output.audio_seconds() / elapsed : 0.0);
+    VadPerfStats perf;
+    if (WebRtcVad_GetPerfStats(&perf) == 0) {
+        WebRtcVad_PrintPerfStats(stderr, &perf);
+    }
+    return ok && output.failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,499 @@
+#ifndef TOOLS_VAD_ARCHIVE_HPP
+#define TOOLS_VAD_ARCHIVE_HPP
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+// Compact archive of per-frame VAD decisions, written by vad -F vda and read
+// by vad_query.
+//
+// Decisions are stored as run lengths, optionally with one quantized score
+// (the likelihood ratio of the global test, see VadFrameAnalysis) per frame,
+// in blocks of a fixed number of frames. An index at the end of the file
+// holds the offset of every block and the number of speech frames before it,
+// so a reader that maps the file answers a time-range query by looking up two
+// index entries and decoding at most two blocks, touching a few pages
+// whatever the length of the recording.
+//
+// Layout, all integers little-endian:
+//
+//   header   "VADA", version (16), flags (16), sample rate (32), frame ms (16),
+//            mode (16), frames per block (32), score step (16), reserved (16),
+//            frames (64), index offset (64), blocks (64)
+//   block    first decision (8), run lengths as LEB128 varints, alternating
+//            from the first decision, then one int8 score per frame if the
+//            scores flag (1) is set
+//   index    per block: offset (64), speech frames before the block (64)
+namespace vad_archive {
+static const char kMagic[4] = {'V', 'A', 'D', 'A'};
+static const uint16_t kVersion = 1;
+static const uint16_t kFlagScores = 1;
+static const size_t kHeaderSize = 48;
+static const size_t kIndexEntrySize = 16;
+// One minute of 10 ms frames: a block decodes in microseconds, and the index
+// of a day of audio is 23 kB.
+static const uint32_t kDefaultFramesPerBlock = 6000;
+// The likelihood ratio of the global test lies within +-31 * 66 (the largest
+// shift difference times the sum of |kSpectrumWeight|), so steps of 16 cover
+// it with an int8.
+static const uint16_t kDefaultScoreStep = 16;
+
+static inline uint16_t ReadLe16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static inline uint32_t ReadLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t ReadLe64(const uint8_t* p) { return (uint64_t)ReadLe32(p) | ((uint64_t)ReadLe32(p + 4) << 32); }
+
+static inline void WriteLe(uint64_t value, size_t size, uint8_t* p) {
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+}  // namespace vad_archive
+
+// A speech segment, in frames, [start, end).
+struct VadArchiveSegment {
+    uint64_t start;
+    uint64_t end;
+};
+
+// Writes an archive frame by frame.
+//
+//   VadArchiveWriter writer;
+//   if (!writer.Open("speech.vda", 16000, 10, 2, true)) { ... }
+//   for (...) writer.Append(speech, analysis.sum_log_likelihood_ratios);
+//   if (!writer.Close()) { ... }
+//
+// The header is written last, so an archive whose writer did not Close() is
+// rejected by the reader.
+class VadArchiveWriter {
+public:
+    VadArchiveWriter() : file_(nullptr) {}
+
+    VadArchiveWriter(const VadArchiveWriter&) = delete;
+    VadArchiveWriter& operator=(const VadArchiveWriter&) = delete;
+
+    ~VadArchiveWriter() {
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+    }
+
+    // Creates the archive at |path|. With |with_scores|, every frame must be
+    // added with its score by Append().
+    bool Open(const char* path, int sample_rate_hz, int frame_ms, int mode, bool with_scores,
+              uint32_t frames_per_block = vad_archive::kDefaultFramesPerBlock,
+              uint16_t score_step = vad_archive::kDefaultScoreStep) {
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+        file_ = fopen(path, "wb");
+        if (file_ == nullptr) {
+            fprintf(stderr, "Open %s failed.\n", path);
+            return false;
+        }
+        sample_rate_hz_ = sample_rate_hz;
+        frame_ms_ = frame_ms;
+        mode_ = mode;
+        with_scores_ = with_scores;
+        frames_per_block_ = frames_per_block > 0 ? frames_per_block : vad_archive::kDefaultFramesPerBlock;
+        score_step_ = score_step > 0 ? score_step : vad_archive::kDefaultScoreStep;
+        num_frames_ = 0;
+        num_speech_frames_ = 0;
+        offset_ = 0;
+        index_.clear();
+        block_.clear();
+        scores_.clear();
+        run_length_ = 0;
+        block_open_ = false;
+        ok_ = true;
+
+        uint8_t header[vad_archive::kHeaderSize] = {0};
+        Write(header, sizeof(header));
+        return ok_;
+    }
+
+    // Adds a frame.
+    void Append(bool speech, int32_t score) {
+        AppendRun(speech, 1);
+        int32_t quantized = score >= 0 ? (score + score_step_ / 2) / score_step_
+                                       : -((-score + score_step_ / 2) / score_step_);
+        scores_.push_back((int8_t)(quantized > 127 ? 127 : quantized < -128 ? -128 : quantized));
+    }
+
+    // Adds |length| frames of the same decision; only for archives without
+    // scores.
+    void AppendRun(bool speech, uint64_t length) {
+        while (length > 0) {
+            uint64_t in_block = num_frames_ % frames_per_block_;
+            if (in_block == 0) {
+                StartBlock(speech);
+            }
+            uint64_t count = frames_per_block_ - in_block < length ? frames_per_block_ - in_block : length;
+            if (speech != speech_) {
+                EndRun();
+                speech_ = speech;
+            }
+            run_length_ += count;
+            num_frames_ += count;
+            num_speech_frames_ += speech ? count : 0;
+            length -= count;
+        }
+    }
+
+    // Writes the last block, the index and the header. Returns false if any
+    // write failed.
+    bool Close() {
+        if (file_ == nullptr) {
+            return false;
+        }
+        if (block_open_) {
+            FlushBlock();
+        }
+        uint64_t index_offset = offset_;
+        uint8_t entry[vad_archive::kIndexEntrySize];
+        for (size_t i = 0; i < index_.size(); i += 2) {
+            vad_archive::WriteLe(index_[i], 8, entry);
+            vad_archive::WriteLe(index_[i + 1], 8, entry + 8);
+            Write(entry, sizeof(entry));
+        }
+
+        uint8_t header[vad_archive::kHeaderSize];
+        memcpy(header, vad_archive::kMagic, 4);
+        vad_archive::WriteLe(vad_archive::kVersion, 2, header + 4);
+        vad_archive::WriteLe(with_scores_ ? vad_archive::kFlagScores : 0, 2, header + 6);
+        vad_archive::WriteLe((uint32_t)sample_rate_hz_, 4, header + 8);
+        vad_archive::WriteLe((uint16_t)frame_ms_, 2, header + 12);
+        vad_archive::WriteLe((uint16_t)mode_, 2, header + 14);
+        vad_archive::WriteLe(frames_per_block_, 4, header + 16);
+        vad_archive::WriteLe(score_step_, 2, header + 20);
+        vad_archive::WriteLe(0, 2, header + 22);
+        vad_archive::WriteLe(num_frames_, 8, header + 24);
+        vad_archive::WriteLe(index_offset, 8, header + 32);
+        vad_archive::WriteLe(index_.size() / 2, 8, header + 40);
+        if (ok_ && fseek(file_, 0, SEEK_SET) == 0) {
+            Write(header, sizeof(header));
+        } else {
+            ok_ = false;
+        }
+        ok_ = fclose(file_) == 0 && ok_;
+        file_ = nullptr;
+        return ok_;
+    }
+
+    uint64_t num_frames() const { return num_frames_; }
+
+private:
+    void Write(const void* data, size_t size) {
+        if (ok_ && fwrite(data, 1, size, file_) != size) {
+            ok_ = false;
+        }
+        offset_ += size;
+    }
+
+    void StartBlock(bool speech) {
+        if (block_open_) {
+            FlushBlock();
+        }
+        block_open_ = true;
+        index_.push_back(offset_);
+        index_.push_back(num_speech_frames_);
+        block_.push_back(speech ? 1 : 0);
+        speech_ = speech;
+        run_length_ = 0;
+    }
+
+    void EndRun() {
+        uint64_t value = run_length_;
+        do {
+            uint8_t byte = value & 0x7F;
+            value >>= 7;
+            block_.push_back(value != 0 ? byte | 0x80 : byte);
+        } while (value != 0);
+        run_length_ = 0;
+    }
+
+    void FlushBlock() {
+        EndRun();
+        Write(block_.data(), block_.size());
+        if (with_scores_) {
+            Write(scores_.data(), scores_.size());
+        }
+        block_.clear();
+        scores_.clear();
+    }
+
+    FILE* file_;
+    int sample_rate_hz_;
+    int frame_ms_;
+    int mode_;
+    bool with_scores_;
+    uint32_t frames_per_block_;
+    uint16_t score_step_;
+    uint64_t num_frames_;
+    uint64_t num_speech_frames_;
+    uint64_t offset_;
+    // Offset and speech frames before, per block.
+    std::vector<uint64_t> index_;
+    std::vector<uint8_t> block_;
+    std::vector<int8_t> scores_;
+    bool speech_;
+    uint64_t run_length_;
+    bool block_open_;
+    bool ok_;
+};
+
+// Memory-mapped reader of archives. Queries take frame ranges [begin, end),
+// clamped to the archive; FrameAt() converts times.
+//
+//   VadArchiveReader archive;
+//   if (!archive.Open("speech.vda")) { ... }
+//   bool speech = archive.CountSpeech(archive.FrameAt(t1), archive.FrameAt(t2)) > 0;
+class VadArchiveReader {
+public:
+    VadArchiveReader() : mapping_(nullptr), mapping_size_(0) {}
+
+    VadArchiveReader(const VadArchiveReader&) = delete;
+    VadArchiveReader& operator=(const VadArchiveReader&) = delete;
+
+    ~VadArchiveReader() { Close(); }
+
+    bool Open(const char* path) {
+        Close();
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "Open %s failed.\n", path);
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < vad_archive::kHeaderSize) {
+            fprintf(stderr, "%s is not a VAD archive.\n", path);
+            close(fd);
+            return false;
+        }
+        void* mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            fprintf(stderr, "Map %s failed.\n", path);
+            return false;
+        }
+        mapping_ = static_cast<const uint8_t*>(mapping);
+        mapping_size_ = (size_t)st.st_size;
+        if (!ParseHeader()) {
+            fprintf(stderr, "%s is not a VAD archive.\n", path);
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (mapping_ != nullptr) {
+            munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+        }
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+        num_frames_ = 0;
+    }
+
+    int sample_rate() const { return sample_rate_hz_; }
+    int frame_ms() const { return frame_ms_; }
+    int mode() const { return mode_; }
+    bool has_scores() const { return has_scores_; }
+    uint64_t num_frames() const { return num_frames_; }
+    double frame_seconds() const { return frame_ms_ / 1000.0; }
+
+    // The frame at |seconds|, clamped to [0, num_frames()].
+    uint64_t FrameAt(double seconds) const {
+        if (!(seconds > 0)) {
+            return 0;
+        }
+        double frame = seconds * 1000 / frame_ms_;
+        return frame >= (double)num_frames_ ? num_frames_ : (uint64_t)frame;
+    }
+
+    bool IsSpeech(uint64_t frame) const { return CountSpeech(frame, frame + 1) > 0; }
+
+    // Number of speech frames in [begin, end).
+    uint64_t CountSpeech(uint64_t begin, uint64_t end) const {
+        Clamp(&begin, &end);
+        return begin < end ? SpeechBefore(end) - SpeechBefore(begin) : 0;
+    }
+
+    // The speech segments overlapping [begin, end), clipped to it.
+    void GetSegments(uint64_t begin, uint64_t end, std::vector<VadArchiveSegment>* segments) const {
+        segments->clear();
+        Clamp(&begin, &end);
+        for (uint64_t block = begin / frames_per_block_; begin < end; block++) {
+            ForEachRun(block, [begin, end, segments](uint64_t start, uint64_t length, bool speech) {
+                uint64_t run_end = start + length;
+                if (!speech || run_end <= begin || start >= end) {
+                    return run_end < end;
+                }
+                start = start > begin ? start : begin;
+                run_end = run_end < end ? run_end : end;
+                if (!segments->empty() && segments->back().end == start) {
+                    segments->back().end = run_end;
+                } else {
+                    segments->push_back({start, run_end});
+                }
+                return run_end < end;
+            });
+            begin = (block + 1) * frames_per_block_;
+        }
+    }
+
+    // Writes the scores of [begin, end) to |scores|, quantized to multiples of
+    // the score step. Returns the number of scores written; 0 if the archive
+    // has none.
+    size_t GetScores(uint64_t begin, uint64_t end, int32_t* scores) const {
+        Clamp(&begin, &end);
+        if (!has_scores_) {
+            return 0;
+        }
+        size_t count = 0;
+        while (begin < end) {
+            uint64_t block = begin / frames_per_block_;
+            uint64_t first = block * frames_per_block_;
+            uint64_t length = BlockLength(block);
+            const uint8_t* block_end = BlockEnd(block);
+            if (block_end == nullptr || (uint64_t)(block_end - BlockStart(block)) < length) {
+                break;
+            }
+            const int8_t* block_scores = reinterpret_cast<const int8_t*>(block_end - length);
+            for (; begin < end && begin < first + length; begin++) {
+                scores[count++] = (int32_t)block_scores[begin - first] * score_step_;
+            }
+        }
+        return count;
+    }
+
+private:
+    bool ParseHeader() {
+        const uint8_t* p = mapping_;
+        if (memcmp(p, vad_archive::kMagic, 4) != 0 || vad_archive::ReadLe16(p + 4) != vad_archive::kVersion) {
+            return false;
+        }
+        has_scores_ = (vad_archive::ReadLe16(p + 6) & vad_archive::kFlagScores) != 0;
+        sample_rate_hz_ = (int)vad_archive::ReadLe32(p + 8);
+        frame_ms_ = vad_archive::ReadLe16(p + 12);
+        mode_ = vad_archive::ReadLe16(p + 14);
+        frames_per_block_ = vad_archive::ReadLe32(p + 16);
+        score_step_ = vad_archive::ReadLe16(p + 20);
+        num_frames_ = vad_archive::ReadLe64(p + 24);
+        index_offset_ = vad_archive::ReadLe64(p + 32);
+        num_blocks_ = vad_archive::ReadLe64(p + 40);
+        if (frame_ms_ == 0 || frames_per_block_ == 0 || index_offset_ < vad_archive::kHeaderSize ||
+            index_offset_ > mapping_size_ ||
+            num_blocks_ > (mapping_size_ - index_offset_) / vad_archive::kIndexEntrySize ||
+            num_blocks_ != (num_frames_ + frames_per_block_ - 1) / frames_per_block_) {
+            return false;
+        }
+        index_ = mapping_ + index_offset_;
+        return true;
+    }
+
+    void Clamp(uint64_t* begin, uint64_t* end) const {
+        *end = *end < num_frames_ ? *end : num_frames_;
+        *begin = *begin < *end ? *begin : *end;
+    }
+
+    uint64_t BlockLength(uint64_t block) const {
+        uint64_t first = block * frames_per_block_;
+        return num_frames_ - first < frames_per_block_ ? num_frames_ - first : frames_per_block_;
+    }
+
+    // The block's data, or nullptr if its offsets are corrupt.
+    const uint8_t* BlockStart(uint64_t block) const {
+        uint64_t offset = vad_archive::ReadLe64(index_ + block * vad_archive::kIndexEntrySize);
+        uint64_t next = block + 1 < num_blocks_
+                            ? vad_archive::ReadLe64(index_ + (block + 1) * vad_archive::kIndexEntrySize)
+                            : index_offset_;
+        return offset >= vad_archive::kHeaderSize && offset < next && next <= index_offset_ ? mapping_ + offset
+                                                                                            : nullptr;
+    }
+
+    const uint8_t* BlockEnd(uint64_t block) const {
+        if (BlockStart(block) == nullptr) {
+            return nullptr;
+        }
+        return block + 1 < num_blocks_
+                   ? mapping_ + vad_archive::ReadLe64(index_ + (block + 1) * vad_archive::kIndexEntrySize)
+                   : index_;
+    }
+
+    // Calls |visit(start, length, speech)| for the runs of |block| in order,
+    // until it returns false. Runs of corrupt blocks are cut short.
+    template <typename Visitor>
+    void ForEachRun(uint64_t block, Visitor visit) const {
+        const uint8_t* p = BlockStart(block);
+        const uint8_t* end = BlockEnd(block);
+        if (p == nullptr) {
+            return;
+        }
+        if (has_scores_) {
+            end -= BlockLength(block) < (uint64_t)(end - p) ? BlockLength(block) : (uint64_t)(end - p);
+        }
+        uint64_t frame = block * frames_per_block_;
+        uint64_t block_end = frame + BlockLength(block);
+        bool speech = p < end && *p++ != 0;
+        while (p < end && frame < block_end) {
+            uint64_t length = 0;
+            for (int shift = 0; p < end && shift < 64; shift += 7) {
+                uint8_t byte = *p++;
+                length |= (uint64_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+            length = length < block_end - frame ? length : block_end - frame;
+            if (length > 0 && !visit(frame, length, speech)) {
+                return;
+            }
+            frame += length;
+            speech = !speech;
+        }
+    }
+
+    // Number of speech frames before |frame|.
+    uint64_t SpeechBefore(uint64_t frame) const {
+        if (num_blocks_ == 0) {
+            return 0;
+        }
+        // The end of the archive is the end of its last block.
+        uint64_t block = frame / frames_per_block_ < num_blocks_ ? frame / frames_per_block_ : num_blocks_ - 1;
+        uint64_t count = vad_archive::ReadLe64(index_ + block * vad_archive::kIndexEntrySize + 8);
+        ForEachRun(block, [frame, &count](uint64_t start, uint64_t length, bool speech) {
+            if (start >= frame) {
+                return false;
+            }
+            if (speech) {
+                count += (start + length < frame ? start + length : frame) - start;
+            }
+            return true;
+        });
+        return count;
+    }
+
+    const uint8_t* mapping_;
+    size_t mapping_size_;
+    const uint8_t* index_;
+    bool has_scores_;
+    int sample_rate_hz_;
+    int frame_ms_;
+    int mode_;
+    uint32_t frames_per_block_;
+    uint16_t score_step_;
+    uint64_t num_frames_;
+    uint64_t index_offset_;
+    uint64_t num_blocks_;
+};
+#endif
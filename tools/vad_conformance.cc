@@ -0,0 +1,1188 @@
+// vad_conformance: bit-exactness of every alternative processing path against
+// the scalar WebRtcVad_CalcVad*khz() path.
+//
+//   vad_conformance [-p paths] [-w file.wav] [-l minutes] [-z iterations]
+//                   [-s seed] [-v] [-H]
+//
+// Every scenario is run from a fresh instance through the reference,
+// WebRtcVad_Process(), and through each of the comma-separated
+//   paths   analysis  - WebRtcVad_ProcessWithAnalysis(),
+//           class     - Vad::IsSpeech() with analysis,
+//           hibernate - hibernated and rehydrated into a new instance after
+//                       every frame,
+//           snapshot  - snapshotted and restored into a new instance after
+//                       every frame,
+//           profile   - initialized by WebRtcVad_InitWithProfile() from the
+//                       profile of a fresh instance,
+//           executor  - a VadExecutor stream,
+//           trace     - WebRtcVad_ProcessTraced(), with the analysis taken
+//                       from the trace hooks,
+//           gap       - WebRtcVad_Process(), with the minima of a copy of the
+//                       instance aged by WebRtcVad_AdvanceGap() now and then
+//                       and compared with WebRtcVad_FindMinimum() of
+//                       INT16_MAX, which is never a new minimum, as many
+//                       times, and the speech activity aggregates taken over
+//                       the gap compared with the hangover frame by frame,
+//           overload  - the overload controller of VadExecutor, driven
+//                       through every level (runs on its own signal, not the
+//                       scenarios, see CheckOverload());
+// all of them by default. Per frame, the decisions are compared and, for
+// paths that report them, the features, total power, likelihood ratio and
+// pre-hangover decision. The reference's features are taken from the trace
+// hooks of WebRtcVad_ProcessTraced() on a copy of its instance, which is
+// checked to end up in the same state. After the last frame, the complete
+// VadInstT state is compared for paths that expose it. Paths without a way to
+// change the mode of a running instance (class, executor) skip the scenarios
+// that switch modes; the executor also skips those in cascade and lite mode.
+//
+// The scenarios cover every rate, frame length and mode with silence,
+// full-scale DC of both signs, DC under noise, a full-scale Nyquist tone and
+// square wave, full-scale impulses, a sweep, full-range white noise,
+// synthetic and clipped speech, and |file.wav|
+// (examples/wave_data/wave_1.wav by default) resampled to each rate. Further
+// scenarios run |minutes| (10 by default) of silence, speech and noise
+// through one instance, switch modes every few frames, and run speech,
+// digital silence and quiet noise in cascade mode (see
+// WebRtcVad_set_cascade()) and in lite mode (see WebRtcVad_set_lite()). -z
+// adds |iterations| randomized scenarios, with random rates, frame lengths per
+// call, mode switches, cascade and lite mode and segments of the signals
+// above at random gains and offsets; iteration i
+// is seeded with |seed| + i (|seed| is 1 by default), so -z 1 -s <seed>
+// replays a failure.
+//
+// Prints the first mismatch of every path and scenario and a summary per
+// path. Exits with status 1 on any mismatch. -H also prints a digest of the
+// reference's decisions, analyses and final states over all scenarios, which
+// must not depend on how the library is built: tools/Makefile's wcet target
+// compares the digest of a WEBRTC_VAD_WCET build with the default one.
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../bench/bench_signals.hpp"
+#include "webrtc/vad/vad_executor.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const int kRates[] = {8000, 16000, 32000, 48000};
+static const int kFrameMs[] = {10, 20, 30};
+static const int kModes[] = {0, 1, 2, 3};
+static const char* const kSignals[] = {"silence", "dc_max",  "dc_min", "dc_noise", "nyquist", "square",
+                                       "impulses", "sweep", "noise",  "speech",   "clipped"};
+static const char* const kPaths[] = {"analysis", "class", "hibernate", "snapshot", "profile",
+                                     "executor", "trace", "gap",       "overload"};
+static const int kSignalSeconds = 4;
+static const int kModeSwitchSeconds = 20;
+// Frames the executor path has in flight at most.
+static const size_t kExecutorBatch = 1000;
+// The gap path checks WebRtcVad_AdvanceGap() before every kGapCheckInterval-th
+// frame, with the gaps of kGapFrames in turn and kLongGapFrames instead
+// every kLongGapCheckInterval-th time.
+static const size_t kGapCheckInterval = 100;
+static const size_t kGapFrames[] = {1, 2, 37, 99, 100, 101, 102, 250, 1000, 32668, 65536 + 77};
+static const size_t kLongGapFrames = 40 * 65536 + 5;
+static const size_t kLongGapCheckInterval = 200;
+// The aggregates the gap path carries over every gap: a window that is not a
+// multiple of the frame length, and a history of kGapActivityFrames before it.
+static const int kGapActivityWindowMs = 1230;
+static const int kGapActivityFrameMs = 20;
+static const int kGapActivityFrames = 37;
+// The overload check, see CheckOverload(): 10 ms frames at 16 kHz, queued
+// 30 at a time per stream and level.
+static const int kOverloadRate = 16000;
+static const size_t kOverloadFrameLength = kOverloadRate / 100;
+static const size_t kOverloadStepFrames = 30;
+static const uint64_t kOverloadRecoveryTickNs = 1000000;
+
+struct Options {
+    vector<string> paths;
+    vector<string> wav_paths;
+    int long_minutes = 10;
+    int fuzz_iterations = 0;
+    uint32_t seed = 1;
+    bool verbose = false;
+    bool digest = false;
+};
+
+// One call of the VAD: |length| samples at |offset|, with the instance in
+// |mode|.
+struct FrameCall {
+    size_t offset;
+    size_t length;
+    int mode;
+};
+
+struct Scenario {
+    string name;
+    int rate;
+    vector<int16_t> audio;
+    vector<FrameCall> calls;
+    bool switches_mode;
+    // Run in cascade mode, see WebRtcVad_set_cascade().
+    bool cascade = false;
+    // Run in lite mode, see WebRtcVad_set_lite().
+    bool lite = false;
+};
+
+struct PathResult {
+    vector<int> decisions;
+    // One per call, empty if the path does not report them.
+    vector<VadFrameAnalysis> analyses;
+    // The final state, if the path exposes it.
+    bool has_state = false;
+    VadInstT state;
+    string error;
+};
+
+struct PathSummary {
+    size_t scenarios = 0;
+    size_t skipped = 0;
+    uint64_t frames = 0;
+    size_t failures = 0;
+};
+
+#define STATE_MEMBER(member) \
+    { offsetof(VadInstT, member), #member }
+
+// Names of the members in |kVadStateFields|, for reports.
+static const struct {
+    size_t offset;
+    const char* name;
+} kStateMemberNames[] = {
+    STATE_MEMBER(vad),
+    STATE_MEMBER(downsampling_filter_states),
+    STATE_MEMBER(state_48_to_8.S_48_24),
+    STATE_MEMBER(state_48_to_8.S_24_24),
+    STATE_MEMBER(state_48_to_8.S_24_16),
+    STATE_MEMBER(state_48_to_8.S_16_8),
+    STATE_MEMBER(noise_means),
+    STATE_MEMBER(speech_means),
+    STATE_MEMBER(noise_stds),
+    STATE_MEMBER(speech_stds),
+    STATE_MEMBER(frame_counter),
+    STATE_MEMBER(over_hang),
+    STATE_MEMBER(num_of_speech),
+    STATE_MEMBER(index_vector),
+    STATE_MEMBER(low_value_vector),
+    STATE_MEMBER(mean_value),
+    STATE_MEMBER(upper_state),
+    STATE_MEMBER(lower_state),
+    STATE_MEMBER(hp_filter_state),
+    STATE_MEMBER(over_hang_max_1),
+    STATE_MEMBER(over_hang_max_2),
+    STATE_MEMBER(individual),
+    STATE_MEMBER(total),
+    STATE_MEMBER(cascade),
+    STATE_MEMBER(cascade_floor),
+    STATE_MEMBER(lite),
+};
+
+// FNV-1a over |value|, for the digest of -H.
+static void Digest(int32_t value, uint64_t* digest) {
+    for (int i = 0; i < 4; i++) {
+        *digest = (*digest ^ (uint8_t)(value >> (8 * i))) * 1099511628211ULL;
+    }
+}
+
+// Adds the decisions, analyses and final state of |result| to |digest|.
+static void DigestResult(const PathResult& result, uint64_t* digest) {
+    for (size_t frame = 0; frame < result.decisions.size(); frame++) {
+        Digest(result.decisions[frame], digest);
+        if (frame < result.analyses.size()) {
+            const VadFrameAnalysis& analysis = result.analyses[frame];
+            for (int i = 0; i < kNumChannels; i++) {
+                Digest(analysis.features[i], digest);
+            }
+            Digest(analysis.total_power, digest);
+            Digest(analysis.sum_log_likelihood_ratios, digest);
+            Digest(analysis.vad, digest);
+        }
+    }
+    if (result.has_state) {
+        for (size_t f = 0; f < kVadStateFieldsSize; f++) {
+            for (size_t i = 0; i < kVadStateFields[f].count; i++) {
+                Digest(VadStateGet(&result.state, &kVadStateFields[f], i), digest);
+            }
+        }
+    }
+}
+
+static const char* StateMemberName(size_t offset) {
+    for (const auto& member : kStateMemberNames) {
+        if (member.offset == offset) {
+            return member.name;
+        }
+    }
+    return "?";
+}
+
+// Compares all of VadInstT. Returns false and describes the first difference
+// in |where| if |state| differs from |expected|.
+static bool CompareState(const VadInstT& state, const VadInstT& expected, string* where) {
+    char text[160];
+    for (size_t f = 0; f < kVadStateFieldsSize; f++) {
+        const VadStateField* field = &kVadStateFields[f];
+        for (size_t i = 0; i < field->count; i++) {
+            int32_t value = VadStateGet(&state, field, i);
+            int32_t reference = VadStateGet(&expected, field, i);
+            if (value != reference) {
+                snprintf(text, sizeof(text), "state %s[%zu] %d, expected %d", StateMemberName(field->offset), i,
+                         value, reference);
+                *where = text;
+                return false;
+            }
+        }
+    }
+    if (state.init_flag != expected.init_flag) {
+        snprintf(text, sizeof(text), "state init_flag %d, expected %d", state.init_flag, expected.init_flag);
+        *where = text;
+        return false;
+    }
+    return true;
+}
+
+// Compares the analysis of one frame. Returns false and describes the first
+// difference in |where| if |analysis| differs from |expected|.
+static bool CompareAnalysis(const VadFrameAnalysis& analysis, const VadFrameAnalysis& expected, string* where) {
+    char text[160];
+    for (int i = 0; i < kNumChannels; i++) {
+        if (analysis.features[i] != expected.features[i]) {
+            snprintf(text, sizeof(text), "features[%d] %d, expected %d", i, analysis.features[i],
+                     expected.features[i]);
+            *where = text;
+            return false;
+        }
+    }
+    if (analysis.total_power != expected.total_power) {
+        snprintf(text, sizeof(text), "total_power %d, expected %d", analysis.total_power, expected.total_power);
+    } else if (analysis.sum_log_likelihood_ratios != expected.sum_log_likelihood_ratios) {
+        snprintf(text, sizeof(text), "sum_log_likelihood_ratios %d, expected %d", analysis.sum_log_likelihood_ratios,
+                 expected.sum_log_likelihood_ratios);
+    } else if (analysis.vad != expected.vad) {
+        snprintf(text, sizeof(text), "vad %d, expected %d", analysis.vad, expected.vad);
+    } else {
+        return true;
+    }
+    *where = text;
+    return false;
+}
+
+class ConformancePath {
+public:
+    virtual ~ConformancePath() {}
+    virtual const char* name() const = 0;
+    // False if the path cannot run |scenario|, e.g., because it switches
+    // modes.
+    virtual bool Supports(const Scenario& /* scenario */) const { return true; }
+    // Runs |scenario| from a fresh instance. Returns false and sets
+    // |result->error| if the path failed.
+    virtual bool Run(const Scenario& scenario, PathResult* result) = 0;
+};
+
+// A path through the C API on one VadInst, which the path may replace
+// between frames.
+class InstancePath : public ConformancePath {
+public:
+    bool Run(const Scenario& scenario, PathResult* result) override {
+        VadInst* handle = WebRtcVad_Create();
+        if (handle == nullptr || Init(handle) != 0 || WebRtcVad_set_cascade(handle, scenario.cascade) != 0 ||
+            WebRtcVad_set_lite(handle, scenario.lite) != 0) {
+            WebRtcVad_Free(handle);
+            result->error = "init failed";
+            return false;
+        }
+        int mode = -1;
+        for (const FrameCall& call : scenario.calls) {
+            if (call.mode != mode && WebRtcVad_set_mode(handle, call.mode) != 0) {
+                result->error = "set_mode failed";
+                break;
+            }
+            mode = call.mode;
+            VadFrameAnalysis analysis;
+            int vad = Process(handle, scenario.rate, &scenario.audio[call.offset], call.length, &analysis, result);
+            if (vad < 0 && result->error.empty()) {
+                result->error = "process failed";
+            }
+            if (!result->error.empty()) {
+                break;
+            }
+            result->decisions.push_back(vad);
+            if (has_analysis()) {
+                result->analyses.push_back(analysis);
+            }
+            handle = Carry(handle, result);
+            if (handle == nullptr) {
+                return false;
+            }
+        }
+        result->has_state = true;
+        result->state = *(VadInstT*)handle;
+        WebRtcVad_Free(handle);
+        return result->error.empty();
+    }
+
+protected:
+    virtual bool has_analysis() const { return false; }
+    virtual int Init(VadInst* handle) { return WebRtcVad_Init(handle); }
+    // Processes one frame, like WebRtcVad_Process().
+    virtual int Process(VadInst* handle, int rate, const int16_t* frame, size_t length,
+                        VadFrameAnalysis* /* analysis */, PathResult* /* result */) {
+        return WebRtcVad_Process(handle, rate, frame, length);
+    }
+    // Called after every frame. Returns the instance to continue with, nullptr
+    // on errors.
+    virtual VadInst* Carry(VadInst* handle, PathResult* /* result */) { return handle; }
+};
+
+// WebRtcVad_Process(), with the analysis taken from the trace hooks of
+// WebRtcVad_ProcessTraced() on a copy of the instance.
+class ReferencePath : public InstancePath {
+public:
+    const char* name() const override { return "reference"; }
+
+protected:
+    bool has_analysis() const override { return true; }
+    int Process(VadInst* handle, int rate, const int16_t* frame, size_t length, VadFrameAnalysis* analysis,
+                PathResult* result) override {
+        VadInstT tap = *(VadInstT*)handle;
+        VadAnalysisTrace trace = {analysis};
+        int expected = WebRtcVad_ProcessTraced((VadInst*)&tap, rate, frame, length, trace);
+        int vad = WebRtcVad_Process(handle, rate, frame, length);
+        string where;
+        if (vad != expected || !CompareState(tap, *(VadInstT*)handle, &where)) {
+            result->error = "traced copy diverged from WebRtcVad_Process(): " + where;
+        }
+        return vad;
+    }
+};
+
+class AnalysisPath : public InstancePath {
+public:
+    const char* name() const override { return "analysis"; }
+
+protected:
+    bool has_analysis() const override { return true; }
+    int Process(VadInst* handle, int rate, const int16_t* frame, size_t length, VadFrameAnalysis* analysis,
+                PathResult* /* result */) override {
+        return WebRtcVad_ProcessWithAnalysis(handle, rate, frame, length, analysis);
+    }
+};
+
+class TracePath : public InstancePath {
+public:
+    const char* name() const override { return "trace"; }
+
+protected:
+    bool has_analysis() const override { return true; }
+    int Process(VadInst* handle, int rate, const int16_t* frame, size_t length, VadFrameAnalysis* analysis,
+                PathResult* /* result */) override {
+        VadAnalysisTrace trace = {analysis};
+        return WebRtcVad_ProcessTraced(handle, rate, frame, length, trace);
+    }
+};
+
+// Advances copies of |state| over a gap of |num_frames| frames, one by
+// WebRtcVad_AdvanceGap() and one by as many calls of WebRtcVad_FindMinimum()
+// per channel with a feature value that is never a new minimum. The speech
+// activity aggregates go over the gap likewise, by
+// WebRtcVad_UpdateSpeechActivityGap() and frame by frame with the decisions of
+// the hangover. Returns false and describes the first difference in |where|
+// if they differ.
+static bool CheckGap(const VadInstT& state, size_t num_frames, string* where) {
+    VadInstT gap = state;
+    VadInstT expected = state;
+    VadSpeechActivity activity;
+    VadSpeechActivity expected_activity;
+    char text[160];
+    WebRtcVad_InitSpeechActivity(&activity, kGapActivityWindowMs);
+    for (int frame = 0; frame < kGapActivityFrames; frame++) {
+        WebRtcVad_UpdateSpeechActivity(&activity, frame % 5 < 2, kGapActivityFrameMs);
+    }
+    expected_activity = activity;
+    if (WebRtcVad_UpdateSpeechActivityGap(&activity, (const VadInst*)&gap, num_frames, kGapActivityFrameMs) < 0 ||
+        WebRtcVad_AdvanceGap((VadInst*)&gap, num_frames) < 0) {
+        *where = "advance gap failed";
+        return false;
+    }
+    for (size_t frame = 0; frame < num_frames; frame++) {
+        for (int channel = 0; channel < kNumChannels; channel++) {
+            WebRtcVad_FindMinimum(&expected, INT16_MAX, channel);
+        }
+        WebRtcVad_UpdateSpeechActivity(&expected_activity, (size_t)state.over_hang > frame, kGapActivityFrameMs);
+    }
+    if (memcmp(&activity, &expected_activity, sizeof(activity)) != 0) {
+        snprintf(text, sizeof(text), "gap of %zu frames: activity %llu ms of %llu ms speech, expected %llu ms of %llu ms",
+                 num_frames, (unsigned long long)activity.speech_ms, (unsigned long long)activity.duration_ms,
+                 (unsigned long long)expected_activity.speech_ms, (unsigned long long)expected_activity.duration_ms);
+        *where = text;
+        return false;
+    }
+    for (size_t i = 0; i < arraysize(gap.index_vector); i++) {
+        if (gap.index_vector[i] != expected.index_vector[i] || gap.low_value_vector[i] != expected.low_value_vector[i]) {
+            snprintf(text, sizeof(text), "gap of %zu frames: minimum %zu age %d value %d, expected age %d value %d",
+                     num_frames, i, gap.index_vector[i], gap.low_value_vector[i], expected.index_vector[i],
+                     expected.low_value_vector[i]);
+            *where = text;
+            return false;
+        }
+    }
+    return true;
+}
+
+class GapPath : public InstancePath {
+public:
+    const char* name() const override { return "gap"; }
+    bool Run(const Scenario& scenario, PathResult* result) override {
+        frames_ = 0;
+        return InstancePath::Run(scenario, result);
+    }
+
+protected:
+    int Process(VadInst* handle, int rate, const int16_t* frame, size_t length, VadFrameAnalysis* /* analysis */,
+                PathResult* result) override {
+        if (frames_++ % kGapCheckInterval == 0) {
+            size_t num_frames = checks_ % kLongGapCheckInterval == kLongGapCheckInterval - 1
+                                    ? kLongGapFrames
+                                    : kGapFrames[checks_ % arraysize(kGapFrames)];
+            checks_++;
+            string where;
+            if (!CheckGap(*(const VadInstT*)handle, num_frames, &where)) {
+                result->error = where;
+                return -1;
+            }
+        }
+        return WebRtcVad_Process(handle, rate, frame, length);
+    }
+
+private:
+    size_t frames_ = 0;
+    size_t checks_ = 0;
+};
+
+class HibernatePath : public InstancePath {
+public:
+    HibernatePath() : blob_(WebRtcVad_HibernateMaxSize()) {}
+    const char* name() const override { return "hibernate"; }
+
+protected:
+    VadInst* Carry(VadInst* handle, PathResult* result) override {
+        size_t length = WebRtcVad_Hibernate(handle, blob_.data(), blob_.size());
+        WebRtcVad_Free(handle);
+        VadInst* rehydrated = WebRtcVad_Create();
+        if (length == 0 || WebRtcVad_Rehydrate(rehydrated, blob_.data(), length) != 0) {
+            WebRtcVad_Free(rehydrated);
+            result->error = "hibernate failed";
+            return nullptr;
+        }
+        return rehydrated;
+    }
+
+private:
+    vector<uint8_t> blob_;
+};
+
+class SnapshotPath : public InstancePath {
+public:
+    SnapshotPath() : buffer_(WebRtcVad_SnapshotSize()) {}
+    const char* name() const override { return "snapshot"; }
+
+protected:
+    VadInst* Carry(VadInst* handle, PathResult* result) override {
+        size_t length = WebRtcVad_Snapshot(handle, buffer_.data(), buffer_.size());
+        WebRtcVad_Free(handle);
+        VadInst* restored = WebRtcVad_Create();
+        if (length == 0 || WebRtcVad_Restore(restored, buffer_.data(), length) != 0) {
+            WebRtcVad_Free(restored);
+            result->error = "snapshot failed";
+            return nullptr;
+        }
+        return restored;
+    }
+
+private:
+    vector<uint8_t> buffer_;
+};
+
+// A profile of an instance that has not seen any audio must reproduce
+// WebRtcVad_Init().
+class ProfilePath : public InstancePath {
+public:
+    const char* name() const override { return "profile"; }
+
+protected:
+    int Init(VadInst* handle) override {
+        VadModelProfile profile;
+        VadInst* fresh = WebRtcVad_Create();
+        int ret = fresh == nullptr || WebRtcVad_Init(fresh) != 0 || WebRtcVad_CaptureProfile(fresh, &profile) != 0
+                      ? -1
+                      : WebRtcVad_InitWithProfile(handle, &profile);
+        WebRtcVad_Free(fresh);
+        return ret;
+    }
+};
+
+class ClassPath : public ConformancePath {
+public:
+    const char* name() const override { return "class"; }
+    bool Supports(const Scenario& scenario) const override { return !scenario.switches_mode; }
+    bool Run(const Scenario& scenario, PathResult* result) override {
+        Vad vad((Vad::Aggressiveness)scenario.calls[0].mode);
+        if (!vad.Init() || !vad.SetCascade(scenario.cascade) || !vad.SetLite(scenario.lite)) {
+            result->error = "init failed";
+            return false;
+        }
+        for (const FrameCall& call : scenario.calls) {
+            VadFrameAnalysis analysis;
+            Vad::Activity activity = vad.IsSpeech(&scenario.audio[call.offset], call.length, scenario.rate, &analysis);
+            if (activity == Vad::kError) {
+                result->error = "process failed";
+                return false;
+            }
+            result->decisions.push_back(activity);
+            result->analyses.push_back(analysis);
+        }
+        return true;
+    }
+};
+
+class ExecutorPath : public ConformancePath {
+public:
+    ExecutorPath() : executor_(2) {}
+    const char* name() const override { return "executor"; }
+    bool Supports(const Scenario& scenario) const override {
+        return !scenario.switches_mode && !scenario.cascade && !scenario.lite;
+    }
+    bool Run(const Scenario& scenario, PathResult* result) override {
+        vector<int>& decisions = result->decisions;
+        decisions.assign(scenario.calls.size(), -1);
+        auto callback = [&decisions](uint64_t sequence, Vad::Activity activity) { decisions[sequence] = activity; };
+        VadExecutor::Stream* stream =
+            executor_.AddStream((Vad::Aggressiveness)scenario.calls[0].mode, scenario.rate, callback);
+        if (stream == nullptr) {
+            result->error = "add stream failed";
+            return false;
+        }
+        for (size_t i = 0; i < scenario.calls.size(); i++) {
+            const FrameCall& call = scenario.calls[i];
+            if (!executor_.Submit(stream, &scenario.audio[call.offset], call.length)) {
+                result->error = "submit failed";
+                break;
+            }
+            // Bounds the frames queued in the executor.
+            if ((i + 1) % kExecutorBatch == 0) {
+                executor_.Drain();
+            }
+        }
+        executor_.Drain();
+        executor_.RemoveStream(stream);
+        return result->error.empty();
+    }
+
+private:
+    VadExecutor executor_;
+};
+
+// What a VadExecutor stream does with the frames queued in one turn at a
+// given Degradation: merging them into calls of up to 30 ms, switching to a
+// lite instance with the cascade on, holding the last decision, and
+// advancing each instance over the frames it missed before it is used again.
+class OverloadModel {
+public:
+    OverloadModel() : full_(Vad::kVadAggressive), last_(Vad::kPassive), full_gap_(0), lite_gap_(0) {}
+
+    bool Init() { return full_.Init(); }
+
+    // Appends the decisions of |num_frames| frames of kOverloadFrameLength
+    // samples at |audio| to |decisions|. Returns false if the lite instance
+    // cannot be initialized.
+    bool Process(VadExecutor::Degradation degradation, const int16_t* audio, size_t num_frames,
+                 vector<int>* decisions) {
+        const size_t batch = degradation >= VadExecutor::kLongFrames && degradation < VadExecutor::kHold ? 3 : 1;
+        Vad* vad = nullptr;
+        if (degradation < VadExecutor::kLite) {
+            vad = &full_;
+        } else if (degradation < VadExecutor::kHold) {
+            if (!lite_) {
+                unique_ptr<Vad> lite(new Vad(Vad::kVadAggressive));
+                if (!lite->Init() || !lite->SetLite(true) || !lite->SetCascade(true)) {
+                    return false;
+                }
+                lite_ = std::move(lite);
+            }
+            vad = lite_.get();
+        }
+        for (size_t i = 0; i < num_frames; i += batch) {
+            size_t batch_size = min(batch, num_frames - i);
+            Vad::Activity activity = last_;
+            if (vad != nullptr) {
+                uint64_t& gap = vad == &full_ ? full_gap_ : lite_gap_;
+                if (gap != 0) {
+                    vad->AdvanceGap((size_t)gap);
+                    gap = 0;
+                }
+                activity = vad->IsSpeech(audio + i * kOverloadFrameLength, batch_size * kOverloadFrameLength,
+                                         kOverloadRate);
+                if (activity != Vad::kError) {
+                    last_ = activity;
+                }
+            }
+            if (vad != &full_) {
+                full_gap_ += batch_size;
+            }
+            if (lite_ && vad != lite_.get()) {
+                lite_gap_ += batch_size;
+            }
+            decisions->insert(decisions->end(), batch_size, activity);
+        }
+        return true;
+    }
+
+private:
+    Vad full_;
+    unique_ptr<Vad> lite_;
+    Vad::Activity last_;
+    uint64_t full_gap_;
+    uint64_t lite_gap_;
+};
+
+static uint64_t NowNs() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Drives the overload controller of a one-worker VadExecutor up from level 0
+// to kMaxOverloadLevel and back down, with a driver stream of the top
+// priority: a step up is one tick of 1 ns over a budget of 0, a step down
+// kRecoveryTicks ticks of 1 ms well under the budget. At every level, the
+// level is frozen by a tick of an hour, the worker is held in the driver's
+// callback while kOverloadStepFrames frames of speech are queued on each of
+// four streams of priorities 0-3, and then each stream's degradation must be
+// the level less kHold steps per priority, and its decisions those of an
+// OverloadModel. Counts the levels checked as scenarios.
+static void CheckOverload(PathSummary* summary) {
+    const uint64_t kFrozenTickNs = 3600000000000ULL;
+    const uint64_t kCalmBudgetNs = 1000 * kOverloadRecoveryTickNs;
+    const size_t kSteps = 2 * VadExecutor::kMaxOverloadLevel + 2;
+    const size_t num_streams = VadExecutor::kNumPriorities;
+    vector<int16_t> silence(kOverloadFrameLength, 0);
+    vector<int16_t> speech = bench::Synthesize("speech", kOverloadRate,
+                                               (int)(num_streams + kSteps * kOverloadStepFrames / 100 + 1));
+    VadExecutor executor(1);
+    atomic<bool> hold(false);
+    atomic<bool> held(false);
+    VadExecutor::Stream* driver = executor.AddStream(
+        Vad::kVadAggressive, kOverloadRate,
+        [&hold, &held](uint64_t, Vad::Activity) {
+            held.store(true);
+            while (hold.load()) {
+                this_thread::yield();
+            }
+        },
+        VadExecutor::kNumPriorities - 1);
+    vector<VadExecutor::Stream*> streams;
+    vector<vector<int>> decisions(num_streams, vector<int>(kSteps * kOverloadStepFrames, Vad::kError));
+    vector<OverloadModel> models(num_streams);
+    for (size_t p = 0; p < num_streams; p++) {
+        vector<int>* stream_decisions = &decisions[p];
+        streams.push_back(executor.AddStream(
+            Vad::kVadAggressive, kOverloadRate,
+            [stream_decisions](uint64_t sequence, Vad::Activity activity) { (*stream_decisions)[sequence] = activity; },
+            (int)p));
+        if (streams.back() == nullptr || !models[p].Init()) {
+            printf("FAIL overload: add stream failed\n");
+            summary->failures++;
+            return;
+        }
+    }
+    if (driver == nullptr) {
+        printf("FAIL overload: add stream failed\n");
+        summary->failures++;
+        return;
+    }
+
+    size_t next_frame = 0;
+    // Queues the next frames of every stream at |level| and checks them.
+    auto check_level = [&](int level) {
+        summary->scenarios++;
+        hold.store(true);
+        held.store(false);
+        executor.Submit(driver, silence.data(), silence.size());
+        while (!held.load()) {
+            this_thread::yield();
+        }
+        for (size_t p = 0; p < num_streams; p++) {
+            for (size_t i = 0; i < kOverloadStepFrames; i++) {
+                // Stream p runs p seconds into the signal.
+                executor.Submit(streams[p], &speech[(p * 100 + next_frame + i) * kOverloadFrameLength],
+                                kOverloadFrameLength);
+            }
+        }
+        hold.store(false);
+        executor.Drain();
+        summary->frames += num_streams * kOverloadStepFrames;
+
+        bool ok = true;
+        for (size_t p = 0; p < num_streams && ok; p++) {
+            int steps = level - VadExecutor::kHold * (int)p;
+            VadExecutor::Degradation expected_degradation =
+                (VadExecutor::Degradation)max(0, min((int)VadExecutor::kHold, steps));
+            vector<int> expected;
+            if (streams[p]->degradation() != expected_degradation) {
+                printf("FAIL overload: level %d, priority %zu: degradation %d, expected %d\n", level, p,
+                       (int)streams[p]->degradation(), (int)expected_degradation);
+                ok = false;
+            } else if (!models[p].Process(expected_degradation, &speech[(p * 100 + next_frame) * kOverloadFrameLength],
+                                          kOverloadStepFrames, &expected)) {
+                printf("FAIL overload: level %d, priority %zu: model init failed\n", level, p);
+                ok = false;
+            }
+            for (size_t i = 0; i < expected.size() && ok; i++) {
+                if (decisions[p][next_frame + i] != expected[i]) {
+                    printf("FAIL overload: level %d, priority %zu: frame %zu: decision %d, expected %d\n", level, p,
+                           next_frame + i, decisions[p][next_frame + i], expected[i]);
+                    ok = false;
+                }
+            }
+        }
+        next_frame += kOverloadStepFrames;
+        summary->failures += ok ? 0 : 1;
+        return ok;
+    };
+
+    // Up, one level per tick over the budget, and once more at the top.
+    executor.SetOverloadBudget(kFrozenTickNs, 0);
+    int level = 0;
+    bool ok = check_level(level);
+    for (int step = 0; ok && step <= VadExecutor::kMaxOverloadLevel; step++) {
+        executor.SetOverloadBudget(1, 0);
+        executor.Submit(driver, silence.data(), silence.size());
+        executor.Drain();
+        executor.SetOverloadBudget(kFrozenTickNs, 0);
+        int expected_level = min(level + 1, (int)VadExecutor::kMaxOverloadLevel);
+        if (executor.overload_level() != expected_level) {
+            printf("FAIL overload: level %d after a tick over the budget at %d\n", executor.overload_level(), level);
+            summary->failures++;
+            return;
+        }
+        level = expected_level;
+        ok = check_level(level);
+    }
+
+    // Down, one level per kRecoveryTicks ticks under half the budget; ticks
+    // are counted in wall time, so a slow run may drop more than one level.
+    const uint64_t recovery_ns = VadExecutor::kRecoveryTicks * kOverloadRecoveryTickNs;
+    while (ok && level > 0) {
+        uint64_t start = NowNs();
+        executor.SetOverloadBudget(kOverloadRecoveryTickNs, kCalmBudgetNs);
+        executor.Submit(driver, silence.data(), silence.size());
+        executor.Drain();
+        if (NowNs() - start < recovery_ns && executor.overload_level() != level) {
+            printf("FAIL overload: level %d before %llu ticks under the budget at %d\n", executor.overload_level(),
+                   (unsigned long long)VadExecutor::kRecoveryTicks, level);
+            summary->failures++;
+            return;
+        }
+        this_thread::sleep_for(chrono::nanoseconds(recovery_ns + 5 * kOverloadRecoveryTickNs));
+        executor.Submit(driver, silence.data(), silence.size());
+        executor.Drain();
+        uint64_t max_drop = (NowNs() - start) / recovery_ns;
+        executor.SetOverloadBudget(kFrozenTickNs, kCalmBudgetNs);
+        int recovered = executor.overload_level();
+        if (recovered >= level || (uint64_t)(level - recovered) > max_drop) {
+            printf("FAIL overload: level %d after %llu ticks under the budget at %d\n", recovered,
+                   (unsigned long long)(max_drop * VadExecutor::kRecoveryTicks), level);
+            summary->failures++;
+            return;
+        }
+        level = recovered;
+        ok = check_level(level);
+    }
+}
+
+static int16_t Clamp(double value) { return bench::Saturate(value); }
+
+// |length| samples of |signal| at |rate|, see kSignals.
+static vector<int16_t> Generate(const string& signal, int rate, size_t length, mt19937* rng) {
+    vector<int16_t> audio(length);
+    uniform_int_distribution<int> full_range(-32768, 32767);
+    normal_distribution<double> gaussian(0, 1);
+    if (signal == "speech" || signal == "clipped") {
+        int seconds = (int)(length / rate) + 1;
+        vector<int16_t> speech = bench::Synthesize(signal, rate, seconds);
+        copy(speech.begin(), speech.begin() + length, audio.begin());
+        return audio;
+    }
+    for (size_t i = 0; i < length; i++) {
+        double t = (double)i / rate;
+        if (signal == "dc_max") {
+            audio[i] = 32767;
+        } else if (signal == "dc_min") {
+            audio[i] = -32768;
+        } else if (signal == "dc_noise") {
+            audio[i] = Clamp(-20000 + 300 * gaussian(*rng));
+        } else if (signal == "nyquist") {
+            audio[i] = i % 2 == 0 ? 32767 : -32768;
+        } else if (signal == "square") {
+            audio[i] = fmod(t * 150, 1.0) < 0.5 ? 32767 : -32768;
+        } else if (signal == "impulses") {
+            audio[i] = (*rng)() % (uint32_t)(rate / 20) == 0 ? ((*rng)() % 2 == 0 ? 32767 : -32768) : 0;
+        } else if (signal == "sweep") {
+            // Exponential from 50 Hz to the Nyquist frequency over 4 s.
+            double ratio = rate / 2 / 50.0;
+            double duration = kSignalSeconds;
+            audio[i] = Clamp(16000 * sin(2 * M_PI * 50 * duration / log(ratio) * (pow(ratio, t / duration) - 1)));
+        } else if (signal == "noise") {
+            audio[i] = (int16_t)full_range(*rng);
+        }
+    }
+    return audio;
+}
+
+// Splits |scenario.audio| into frames of |frame_ms| in |mode|.
+static void AddFrames(Scenario* scenario, int frame_ms, int mode) {
+    size_t length = (size_t)scenario->rate * frame_ms / 1000;
+    for (size_t offset = 0; offset + length <= scenario->audio.size(); offset += length) {
+        scenario->calls.push_back({offset, length, mode});
+    }
+}
+
+static vector<Scenario> GenerateScenarios(const Options& options) {
+    vector<Scenario> scenarios;
+    char name[128];
+    for (int rate : kRates) {
+        mt19937 rng(rate);
+        vector<pair<string, vector<int16_t>>> inputs;
+        for (const char* signal : kSignals) {
+            inputs.emplace_back(signal, Generate(signal, rate, (size_t)rate * kSignalSeconds, &rng));
+        }
+        for (const string& wav_path : options.wav_paths) {
+            vector<int16_t> audio = bench::LoadRecorded(wav_path, rate, kSignalSeconds);
+            if (audio.empty()) {
+                fprintf(stderr, "vad_conformance: cannot read %s, skipping it\n", wav_path.c_str());
+                continue;
+            }
+            inputs.emplace_back(wav_path, audio);
+        }
+        for (const auto& input : inputs) {
+            for (int frame_ms : kFrameMs) {
+                for (int mode : kModes) {
+                    snprintf(name, sizeof(name), "%s %d Hz %d ms mode %d", input.first.c_str(), rate, frame_ms,
+                             mode);
+                    Scenario scenario = {name, rate, input.second, {}, false};
+                    AddFrames(&scenario, frame_ms, mode);
+                    scenarios.push_back(move(scenario));
+                }
+            }
+        }
+
+        // Modes switched every 1 to 300 frames, over speech and noise.
+        for (int frame_ms : kFrameMs) {
+            snprintf(name, sizeof(name), "mode switches %d Hz %d ms", rate, frame_ms);
+            Scenario scenario = {name, rate, bench::Synthesize("speech", rate, kModeSwitchSeconds), {}, true};
+            for (size_t i = scenario.audio.size() / 2; i < scenario.audio.size(); i++) {
+                scenario.audio[i] = Clamp(scenario.audio[i] + 1000 * normal_distribution<double>(0, 1)(rng));
+            }
+            AddFrames(&scenario, frame_ms, 0);
+            size_t next_switch = 0;
+            int mode = 0;
+            for (FrameCall& call : scenario.calls) {
+                if (next_switch-- == 0) {
+                    mode = (int)(rng() % 4);
+                    next_switch = rng() % 300;
+                }
+                call.mode = mode;
+            }
+            scenarios.push_back(move(scenario));
+        }
+
+        // Cascade mode over speech, digital silence, dither and quiet noise,
+        // with the gate opening and closing.
+        vector<int16_t> hold = bench::Synthesize("speech", rate, kSignalSeconds);
+        hold.resize(hold.size() + (size_t)rate, 0);
+        for (double level : {2.0, 10.0, 40.0}) {
+            for (size_t i = 0; i < (size_t)rate; i++) {
+                hold.push_back(Clamp(level * normal_distribution<double>(0, 1)(rng)));
+            }
+        }
+        vector<int16_t> speech = bench::Synthesize("speech", rate, kSignalSeconds);
+        hold.insert(hold.end(), speech.begin(), speech.end());
+        for (int frame_ms : kFrameMs) {
+            for (int mode : kModes) {
+                snprintf(name, sizeof(name), "cascade %d Hz %d ms mode %d", rate, frame_ms, mode);
+                Scenario scenario = {name, rate, hold, {}, false, true};
+                AddFrames(&scenario, frame_ms, mode);
+                scenarios.push_back(move(scenario));
+            }
+        }
+
+        // Lite mode over the same signal, without the gate.
+        for (int frame_ms : kFrameMs) {
+            for (int mode : kModes) {
+                snprintf(name, sizeof(name), "lite %d Hz %d ms mode %d", rate, frame_ms, mode);
+                Scenario scenario = {name, rate, hold, {}, false, false, true};
+                AddFrames(&scenario, frame_ms, mode);
+                scenarios.push_back(move(scenario));
+            }
+        }
+    }
+
+    // Long runs at the lowest and highest rate: silence, a minute of speech,
+    // then noise, so that the minimum tracker and the model run for a long
+    // time in each regime.
+    for (int rate : {8000, 48000}) {
+        if (options.long_minutes <= 0) {
+            break;
+        }
+        mt19937 rng(rate + 1);
+        snprintf(name, sizeof(name), "long %d min %d Hz 30 ms mode 3", 2 * options.long_minutes + 1, rate);
+        Scenario scenario = {name, rate, {}, {}, false};
+        size_t run = (size_t)rate * 60 * options.long_minutes;
+        scenario.audio = Generate("silence", rate, run, &rng);
+        vector<int16_t> speech = bench::Synthesize("speech", rate, 60);
+        scenario.audio.insert(scenario.audio.end(), speech.begin(), speech.end());
+        for (size_t i = 0; i < run; i++) {
+            scenario.audio.push_back(Clamp(300 * normal_distribution<double>(0, 1)(rng)));
+        }
+        AddFrames(&scenario, 30, 3);
+        scenarios.push_back(move(scenario));
+    }
+    return scenarios;
+}
+
+// A random scenario: random rate, segments of random signals at random gains
+// and offsets, random frame lengths and mode switches.
+static Scenario FuzzScenario(uint32_t seed) {
+    mt19937 rng(seed);
+    char name[64];
+    Scenario scenario;
+    scenario.rate = kRates[rng() % 4];
+    snprintf(name, sizeof(name), "fuzz seed %u %d Hz", seed, scenario.rate);
+    scenario.name = name;
+    scenario.switches_mode = false;
+
+    const size_t length = scenario.rate / 10 * (1 + rng() % 300);
+    while (scenario.audio.size() < length) {
+        const char* signal = kSignals[rng() % arraysize(kSignals)];
+        size_t segment = min(length - scenario.audio.size(), (size_t)(scenario.rate / 20 * (1 + rng() % 100)));
+        vector<int16_t> audio = Generate(signal, scenario.rate, segment, &rng);
+        double gain = pow(2.0, uniform_real_distribution<double>(-10, 4)(rng));
+        double offset = rng() % 4 == 0 ? uniform_real_distribution<double>(-32768, 32767)(rng) : 0;
+        for (int16_t sample : audio) {
+            scenario.audio.push_back(Clamp(gain * sample + offset));
+        }
+    }
+
+    const bool fixed_length = rng() % 2 == 0;
+    const double switch_probability = rng() % 2 == 0 ? 0 : 1.0 / (1 + rng() % 200);
+    int frame_ms = kFrameMs[rng() % 3];
+    int mode = kModes[rng() % 4];
+    size_t offset = 0;
+    while (true) {
+        if (!fixed_length) {
+            frame_ms = kFrameMs[rng() % 3];
+        }
+        size_t frame_length = (size_t)scenario.rate * frame_ms / 1000;
+        if (offset + frame_length > scenario.audio.size()) {
+            break;
+        }
+        if (!scenario.calls.empty() && uniform_real_distribution<double>(0, 1)(rng) < switch_probability) {
+            mode = kModes[rng() % 4];
+            scenario.switches_mode = true;
+        }
+        scenario.calls.push_back({offset, frame_length, mode});
+        offset += frame_length;
+    }
+    scenario.cascade = rng() % 4 == 0;
+    scenario.lite = rng() % 4 == 0;
+    return scenario;
+}
+
+// Compares |result| of |path| with the |reference| result. Returns false and
+// prints the first mismatch if they differ.
+static bool Check(const Scenario& scenario, const ConformancePath& path, const PathResult& result,
+                  const PathResult& reference) {
+    string where;
+    size_t frame = 0;
+    if (!result.error.empty()) {
+        where = result.error;
+        frame = result.decisions.size();
+    } else if (result.decisions.size() != reference.decisions.size()) {
+        where = "wrong number of decisions";
+    } else {
+        for (; frame < result.decisions.size(); frame++) {
+            if (result.decisions[frame] != reference.decisions[frame]) {
+                where = "decision " + to_string(result.decisions[frame]) + ", expected " +
+                        to_string(reference.decisions[frame]);
+                break;
+            }
+            if (!result.analyses.empty() &&
+                !CompareAnalysis(result.analyses[frame], reference.analyses[frame], &where)) {
+                break;
+            }
+        }
+        if (where.empty() && result.has_state && !CompareState(result.state, reference.state, &where)) {
+            printf("FAIL %s: %s: after the last frame: %s\n", path.name(), scenario.name.c_str(), where.c_str());
+            return false;
+        }
+    }
+    if (where.empty()) {
+        return true;
+    }
+    double seconds = frame < scenario.calls.size() ? (double)scenario.calls[frame].offset / scenario.rate : 0;
+    printf("FAIL %s: %s: frame %zu (%.2f s): %s\n", path.name(), scenario.name.c_str(), frame, seconds,
+           where.c_str());
+    return false;
+}
+
+static vector<string> Split(const char* list) {
+    vector<string> items;
+    string item;
+    for (const char* p = list;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0') {
+                return items;
+            }
+        } else {
+            item += *p;
+        }
+    }
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            options->paths = Split(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            options->wav_paths.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            options->long_minutes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+            options->fuzz_iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            options->seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            options->verbose = true;
+        } else if (strcmp(argv[i], "-H") == 0) {
+            options->digest = true;
+        } else {
+            return false;
+        }
+    }
+    if (options->paths.empty()) {
+        options->paths.assign(begin(kPaths), end(kPaths));
+    }
+    if (options->wav_paths.empty()) {
+        options->wav_paths.push_back("../examples/wave_data/wave_1.wav");
+    }
+    for (const string& path : options->paths) {
+        if (find(begin(kPaths), end(kPaths), path) == end(kPaths)) {
+            return false;
+        }
+    }
+    return options->fuzz_iterations >= 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-p analysis,class,hibernate,snapshot,profile,executor,trace,gap,overload] [-w file.wav]\n"
+                "       [-l minutes] [-z iterations] [-s seed] [-v] [-H]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ReferencePath reference;
+    vector<unique_ptr<ConformancePath>> candidates;
+    candidates.emplace_back(new AnalysisPath());
+    candidates.emplace_back(new ClassPath());
+    candidates.emplace_back(new HibernatePath());
+    candidates.emplace_back(new SnapshotPath());
+    candidates.emplace_back(new ProfilePath());
+    candidates.emplace_back(new ExecutorPath());
+    candidates.emplace_back(new TracePath());
+    candidates.emplace_back(new GapPath());
+    vector<ConformancePath*> paths;
+    for (const auto& candidate : candidates) {
+        if (find(options.paths.begin(), options.paths.end(), candidate->name()) != options.paths.end()) {
+            paths.push_back(candidate.get());
+        }
+    }
+
+    vector<Scenario> scenarios = GenerateScenarios(options);
+    vector<PathSummary> summaries(paths.size());
+    size_t reference_failures = 0;
+    uint64_t digest = 14695981039346656037ULL;
+    auto run = [&](const Scenario& scenario) {
+        if (options.verbose) {
+            printf("%s: %zu frames\n", scenario.name.c_str(), scenario.calls.size());
+        }
+        PathResult expected;
+        if (!reference.Run(scenario, &expected)) {
+            printf("FAIL reference: %s: frame %zu: %s\n", scenario.name.c_str(), expected.decisions.size(),
+                   expected.error.c_str());
+            reference_failures++;
+            return;
+        }
+        DigestResult(expected, &digest);
+        for (size_t p = 0; p < paths.size(); p++) {
+            if (!paths[p]->Supports(scenario)) {
+                summaries[p].skipped++;
+                continue;
+            }
+            PathResult result;
+            paths[p]->Run(scenario, &result);
+            summaries[p].scenarios++;
+            summaries[p].frames += scenario.calls.size();
+            if (!Check(scenario, *paths[p], result, expected)) {
+                summaries[p].failures++;
+            }
+        }
+    };
+    for (const Scenario& scenario : scenarios) {
+        run(scenario);
+    }
+    for (int i = 0; i < options.fuzz_iterations; i++) {
+        run(FuzzScenario(options.seed + i));
+    }
+
+    const bool overload = find(options.paths.begin(), options.paths.end(), "overload") != options.paths.end();
+    PathSummary overload_summary;
+    if (overload) {
+        CheckOverload(&overload_summary);
+    }
+
+    size_t failures = reference_failures;
+    printf("%-10s %9s %8s %12s %8s\n", "path", "scenarios", "skipped", "frames", "failures");
+    for (size_t p = 0; p < paths.size(); p++) {
+        printf("%-10s %9zu %8zu %12llu %8zu\n", paths[p]->name(), summaries[p].scenarios, summaries[p].skipped,
+               (unsigned long long)summaries[p].frames, summaries[p].failures);
+        failures += summaries[p].failures;
+    }
+    if (overload) {
+        printf("%-10s %9zu %8zu %12llu %8zu\n", "overload", overload_summary.scenarios, overload_summary.skipped,
+               (unsigned long long)overload_summary.frames, overload_summary.failures);
+        failures += overload_summary.failures;
+    }
+    printf("%zu scenarios, %d fuzzed, %zu failures\n", scenarios.size() + options.fuzz_iterations,
+           options.fuzz_iterations, failures);
+    if (options.digest) {
+        printf("digest %016llx\n", (unsigned long long)digest);
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
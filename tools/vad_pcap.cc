@@ -0,0 +1,604 @@
+// vad_pcap: per-SSRC speech activity of the RTP streams in a pcap capture.
+//
+//   vad_pcap [-m mode] [-f frame_ms] [-p pt:codec/rate]... [-o dir] capture.pcap
+//
+// The capture is memory-mapped and its packets parsed in place, link layer
+// (Ethernet with VLAN tags, Linux cooked, raw IP or BSD loopback) through
+// IPv4/IPv6 and UDP to RTP. Streams are demultiplexed by SSRC, each into its
+// own VAD instance. PCMU (payload type 0) and PCMA (8) are recognized
+// without options; dynamic payload types are mapped with -p, e.g.,
+// -p 96:L16/16000 or -p 101:PCMU/8000.
+//
+// Packets missing from a stream, by sequence number, and silence suppressed
+// by the sender, by RTP timestamp, show up as gaps on its timeline; the
+// frames around them stay aligned to the RTP clock. Reordered and duplicate
+// packets are dropped. Packets of other payload types on the SSRC of a stream,
+// such as telephone events or comfort noise, count for the sequence numbers
+// and the clock but are not decoded.
+//
+// One timeline per stream is written to |dir|/ssrc_<ssrc>.csv, as runs of
+//   start_seconds,end_seconds,speech|silence|gap
+// relative to the first packet of the stream, and a summary to stdout, with
+// the number of talk spurts and the SNR estimate of the VAD per stream.
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "webrtc/g711/g711.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const uint32_t kPcapMagicMicro = 0xa1b2c3d4;
+static const uint32_t kPcapMagicNano = 0xa1b23c4d;
+static const size_t kPcapHeaderSize = 24;
+static const size_t kPcapRecordHeaderSize = 16;
+
+static const uint32_t kLinkTypeNull = 0;
+static const uint32_t kLinkTypeEthernet = 1;
+static const uint32_t kLinkTypeRaw = 101;
+static const uint32_t kLinkTypeLinuxSll = 113;
+static const uint32_t kLinkTypeLinuxSll2 = 276;
+
+static const uint16_t kEtherTypeIpv4 = 0x0800;
+static const uint16_t kEtherTypeIpv6 = 0x86dd;
+static const uint16_t kEtherTypeVlan = 0x8100;
+static const uint16_t kEtherTypeQinQ = 0x88a8;
+static const uint8_t kIpProtocolUdp = 17;
+
+static const size_t kRtpHeaderSize = 12;
+// Window of the speech-activity aggregates of a stream; only the totals are
+// reported.
+static const int kActivityWindowMs = 10000;
+// 30 ms at 48 kHz.
+static const size_t kMaxFrameSamples = 1440;
+
+enum Codec { kPcmu, kPcma, kL16 };
+
+struct PayloadFormat {
+    Codec codec;
+    int sample_rate_hz;
+};
+
+enum Activity { kSilence = 0, kSpeech = 1, kGap = 2 };
+
+static const char* const kActivityNames[] = {"silence", "speech", "gap"};
+static const char* const kCodecNames[] = {"PCMU", "PCMA", "L16"};
+
+// A run of frames with the same activity.
+struct Run {
+    uint64_t start;
+    uint64_t length;
+    Activity activity;
+};
+
+struct Stream {
+    uint32_t ssrc = 0;
+    // Payload type of the audio, the one the stream was created from.
+    int payload_type = 0;
+    PayloadFormat format = {kPcmu, 8000};
+    unique_ptr<Vad> vad;
+    size_t frame_length = 0;
+    int16_t frame[kMaxFrameSamples];
+    size_t frame_fill = 0;
+    uint16_t next_sequence = 0;
+    uint32_t next_timestamp = 0;
+    double first_time = 0;
+    uint64_t packets = 0;
+    uint64_t lost = 0;
+    uint64_t late = 0;
+    uint64_t frames = 0;
+    uint64_t speech_frames = 0;
+    uint64_t gap_frames = 0;
+    vector<Run> runs;
+};
+
+struct Options {
+    int mode = 0;
+    int frame_ms = 10;
+    string output_dir = ".";
+    map<int, PayloadFormat> payload_formats = {{0, {kPcmu, 8000}}, {8, {kPcma, 8000}}};
+};
+
+static inline uint16_t ReadBe16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+static inline uint32_t ReadBe32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint32_t ReadPcap32(const uint8_t* p, bool swapped) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+static void AppendRun(Stream* stream, Activity activity, uint64_t frames) {
+    if (frames == 0) {
+        return;
+    }
+    if (!stream->runs.empty() && stream->runs.back().activity == activity) {
+        stream->runs.back().length += frames;
+    } else {
+        stream->runs.push_back({stream->frames, frames, activity});
+    }
+    stream->frames += frames;
+    if (activity == kSpeech) {
+        stream->speech_frames += frames;
+    } else if (activity == kGap) {
+        stream->gap_frames += frames;
+    }
+}
+
+static void ProcessFrame(Stream* stream) {
+    Vad::Activity activity = stream->vad->IsSpeech(stream->frame, stream->frame_length, stream->format.sample_rate_hz);
+    AppendRun(stream, activity == Vad::kActive ? kSpeech : kSilence, 1);
+    stream->frame_fill = 0;
+}
+
+// Decodes |num_samples| samples of |payload| into the stream's frame buffer,
+// running the VAD on every completed frame.
+static void Decode(Stream* stream, const uint8_t* payload, size_t num_samples) {
+    size_t sample_size = stream->format.codec == kL16 ? 2 : 1;
+    while (num_samples > 0) {
+        size_t n = stream->frame_length - stream->frame_fill;
+        if (n > num_samples) {
+            n = num_samples;
+        }
+        int16_t* out = &stream->frame[stream->frame_fill];
+        switch (stream->format.codec) {
+            case kPcmu:
+                WebRtcG711_DecodeU(payload, n, out);
+                break;
+            case kPcma:
+                WebRtcG711_DecodeA(payload, n, out);
+                break;
+            case kL16:
+                for (size_t i = 0; i < n; i++) {
+                    out[i] = (int16_t)ReadBe16(&payload[2 * i]);
+                }
+                break;
+        }
+        stream->frame_fill += n;
+        payload += n * sample_size;
+        num_samples -= n;
+        if (stream->frame_fill == stream->frame_length) {
+            ProcessFrame(stream);
+        }
+    }
+}
+
+// Accounts for |num_samples| samples missing from the stream. The partial
+// frame is completed with silence, whole frames of the gap are marked as gap
+// and skipped by the VAD in one step (Vad::AdvanceGap), and the remainder
+// starts the next frame as silence so that frames stay aligned to the RTP
+// timestamps.
+static void SkipSamples(Stream* stream, uint64_t num_samples) {
+    if (stream->frame_fill > 0) {
+        size_t n = stream->frame_length - stream->frame_fill;
+        if (n > num_samples) {
+            n = (size_t)num_samples;
+        }
+        memset(&stream->frame[stream->frame_fill], 0, n * sizeof(int16_t));
+        stream->frame_fill += n;
+        num_samples -= n;
+        if (stream->frame_fill < stream->frame_length) {
+            return;
+        }
+        ProcessFrame(stream);
+    }
+    uint64_t num_frames = num_samples / stream->frame_length;
+    if (num_frames > 0) {
+        stream->vad->AdvanceGap((size_t)num_frames);
+    }
+    AppendRun(stream, kGap, num_frames);
+    stream->frame_fill = (size_t)(num_samples % stream->frame_length);
+    memset(stream->frame, 0, stream->frame_fill * sizeof(int16_t));
+}
+
+class PcapVad {
+public:
+    explicit PcapVad(const Options& options) : options_(options), last_stream_(nullptr) {}
+
+    uint64_t packets() const { return packets_; }
+    uint64_t rtp_packets() const { return rtp_packets_; }
+    const unordered_map<uint32_t, unique_ptr<Stream>>& streams() const { return streams_; }
+
+    // Processes a whole capture. Returns false if it is not a pcap file.
+    bool ProcessCapture(const uint8_t* data, size_t size) {
+        if (size < kPcapHeaderSize) {
+            return false;
+        }
+        uint32_t magic;
+        memcpy(&magic, data, sizeof(magic));
+        bool swapped = magic == __builtin_bswap32(kPcapMagicMicro) || magic == __builtin_bswap32(kPcapMagicNano);
+        magic = swapped ? __builtin_bswap32(magic) : magic;
+        if (magic != kPcapMagicMicro && magic != kPcapMagicNano) {
+            return false;
+        }
+        double fraction_scale = magic == kPcapMagicNano ? 1e-9 : 1e-6;
+        uint32_t link_type = ReadPcap32(&data[20], swapped) & 0x0fffffff;
+
+        size_t offset = kPcapHeaderSize;
+        while (offset + kPcapRecordHeaderSize <= size) {
+            const uint8_t* record = &data[offset];
+            uint32_t captured = ReadPcap32(&record[8], swapped);
+            offset += kPcapRecordHeaderSize;
+            if (captured > size - offset) {
+                break;  // Truncated capture.
+            }
+            double time = ReadPcap32(&record[0], swapped) + ReadPcap32(&record[4], swapped) * fraction_scale;
+            ProcessLinkLayer(link_type, &data[offset], captured, time);
+            offset += captured;
+            packets_++;
+        }
+        return true;
+    }
+
+    // Flushes partial frames at the end of the capture.
+    void Finish() {
+        for (auto& entry : streams_) {
+            Stream* stream = entry.second.get();
+            if (stream->frame_fill > 0) {
+                SkipSamples(stream, stream->frame_length - stream->frame_fill);
+            }
+        }
+    }
+
+private:
+    void ProcessLinkLayer(uint32_t link_type, const uint8_t* p, size_t length, double time) {
+        uint16_t ether_type;
+        switch (link_type) {
+            case kLinkTypeEthernet:
+                if (length < 14) {
+                    return;
+                }
+                ether_type = ReadBe16(&p[12]);
+                p += 14;
+                length -= 14;
+                while ((ether_type == kEtherTypeVlan || ether_type == kEtherTypeQinQ) && length >= 4) {
+                    ether_type = ReadBe16(&p[2]);
+                    p += 4;
+                    length -= 4;
+                }
+                break;
+            case kLinkTypeLinuxSll:
+                if (length < 16) {
+                    return;
+                }
+                ether_type = ReadBe16(&p[14]);
+                p += 16;
+                length -= 16;
+                break;
+            case kLinkTypeLinuxSll2:
+                if (length < 20) {
+                    return;
+                }
+                ether_type = ReadBe16(&p[0]);
+                p += 20;
+                length -= 20;
+                break;
+            case kLinkTypeNull:
+                if (length < 4) {
+                    return;
+                }
+                // Address family in the capturing host's byte order.
+                ether_type = (p[0] == 2 || p[3] == 2) ? kEtherTypeIpv4 : kEtherTypeIpv6;
+                p += 4;
+                length -= 4;
+                break;
+            case kLinkTypeRaw:
+                if (length < 1) {
+                    return;
+                }
+                ether_type = (p[0] >> 4) == 4 ? kEtherTypeIpv4 : kEtherTypeIpv6;
+                break;
+            default:
+                return;
+        }
+        if (ether_type == kEtherTypeIpv4) {
+            ProcessIpv4(p, length, time);
+        } else if (ether_type == kEtherTypeIpv6) {
+            ProcessIpv6(p, length, time);
+        }
+    }
+
+    void ProcessIpv4(const uint8_t* p, size_t length, double time) {
+        if (length < 20 || (p[0] >> 4) != 4) {
+            return;
+        }
+        size_t header_length = (size_t)(p[0] & 0x0f) * 4;
+        size_t total_length = ReadBe16(&p[2]);
+        // Fragments other than a whole datagram are skipped.
+        if (header_length < 20 || total_length < header_length || total_length > length ||
+            (ReadBe16(&p[6]) & 0x3fff) != 0 || p[9] != kIpProtocolUdp) {
+            return;
+        }
+        ProcessUdp(&p[header_length], total_length - header_length, time);
+    }
+
+    void ProcessIpv6(const uint8_t* p, size_t length, double time) {
+        if (length < 40 || (p[0] >> 4) != 6) {
+            return;
+        }
+        size_t payload_length = ReadBe16(&p[4]);
+        uint8_t next_header = p[6];
+        p += 40;
+        length -= 40;
+        if (payload_length < length) {
+            length = payload_length;
+        }
+        // Hop-by-hop, routing and destination options extension headers.
+        while ((next_header == 0 || next_header == 43 || next_header == 60) && length >= 8) {
+            size_t extension_length = ((size_t)p[1] + 1) * 8;
+            if (extension_length > length) {
+                return;
+            }
+            next_header = p[0];
+            p += extension_length;
+            length -= extension_length;
+        }
+        if (next_header == kIpProtocolUdp) {
+            ProcessUdp(p, length, time);
+        }
+    }
+
+    void ProcessUdp(const uint8_t* p, size_t length, double time) {
+        if (length < 8) {
+            return;
+        }
+        size_t udp_length = ReadBe16(&p[4]);
+        if (udp_length < 8 || udp_length > length) {
+            return;
+        }
+        ProcessRtp(&p[8], udp_length - 8, time);
+    }
+
+    void ProcessRtp(const uint8_t* p, size_t length, double time) {
+        if (length < kRtpHeaderSize || (p[0] >> 6) != 2) {
+            return;
+        }
+        int payload_type = p[1] & 0x7f;
+        // RTCP packet types 200 - 204 alias payload types 72 - 76.
+        if (payload_type >= 72 && payload_type <= 76) {
+            return;
+        }
+        size_t header_length = kRtpHeaderSize + (size_t)(p[0] & 0x0f) * 4;
+        if (header_length > length) {
+            return;
+        }
+        if (p[0] & 0x10) {
+            if (header_length + 4 > length) {
+                return;
+            }
+            header_length += 4 + (size_t)ReadBe16(&p[header_length + 2]) * 4;
+            if (header_length > length) {
+                return;
+            }
+        }
+        size_t payload_length = length - header_length;
+        if ((p[0] & 0x20) && payload_length > 0) {
+            size_t padding = p[length - 1];
+            if (padding > payload_length) {
+                return;
+            }
+            payload_length -= padding;
+        }
+
+        uint32_t ssrc = ReadBe32(&p[8]);
+        Stream* stream = last_stream_;
+        if (stream == nullptr || stream->ssrc != ssrc) {
+            stream = FindStream(ssrc, payload_type, time);
+        }
+        if (stream == nullptr) {
+            return;
+        }
+        last_stream_ = stream;
+        rtp_packets_++;
+
+        uint16_t sequence = ReadBe16(&p[2]);
+        uint32_t timestamp = ReadBe32(&p[4]);
+        if (stream->packets > 0) {
+            int16_t sequence_delta = (int16_t)(sequence - stream->next_sequence);
+            int32_t timestamp_delta = (int32_t)(timestamp - stream->next_timestamp);
+            if (sequence_delta < 0) {
+                stream->late++;
+                return;
+            }
+            stream->lost += (uint64_t)sequence_delta;
+            if (timestamp_delta > 0) {
+                SkipSamples(stream, (uint64_t)timestamp_delta);
+            }
+        }
+        stream->packets++;
+        stream->next_sequence = (uint16_t)(sequence + 1);
+        if (payload_type != stream->payload_type) {
+            // Telephone events (RFC 4733), comfort noise (RFC 3389) and other
+            // payloads on the same SSRC share its sequence numbers and clock
+            // but are not audio of its codec: the time they cover shows up as
+            // a gap once the audio resumes.
+            if ((int32_t)(timestamp - stream->next_timestamp) > 0) {
+                stream->next_timestamp = timestamp;
+            }
+            return;
+        }
+
+        size_t num_samples = stream->format.codec == kL16 ? payload_length / 2 : payload_length;
+        Decode(stream, &p[header_length], num_samples);
+        stream->next_timestamp = timestamp + (uint32_t)num_samples;
+    }
+
+    Stream* FindStream(uint32_t ssrc, int payload_type, double time) {
+        auto it = streams_.find(ssrc);
+        if (it != streams_.end()) {
+            return it->second.get();
+        }
+        auto format = options_.payload_formats.find(payload_type);
+        if (format == options_.payload_formats.end()) {
+            return nullptr;
+        }
+
+        unique_ptr<Stream> stream(new Stream());
+        stream->ssrc = ssrc;
+        stream->payload_type = payload_type;
+        stream->format = format->second;
+        stream->frame_length = (size_t)(format->second.sample_rate_hz / 1000 * options_.frame_ms);
+        stream->first_time = time;
+        stream->vad.reset(new Vad(static_cast<Vad::Aggressiveness>(options_.mode)));
+        if (!stream->vad->Init() || !stream->vad->SetSpeechActivityWindow(kActivityWindowMs)) {
+            return nullptr;
+        }
+        Stream* result = stream.get();
+        streams_[ssrc] = move(stream);
+        return result;
+    }
+
+    const Options& options_;
+    unordered_map<uint32_t, unique_ptr<Stream>> streams_;
+    Stream* last_stream_;
+    uint64_t packets_ = 0;
+    uint64_t rtp_packets_ = 0;
+};
+
+// Parses "pt:codec/rate", e.g., "96:L16/16000".
+static bool ParsePayloadFormat(const char* arg, int frame_ms, Options* options) {
+    int payload_type, sample_rate_hz;
+    char codec[8];
+    if (sscanf(arg, "%d:%7[^/]/%d", &payload_type, codec, &sample_rate_hz) != 3 || payload_type < 0 ||
+        payload_type > 127) {
+        return false;
+    }
+    PayloadFormat format = {kPcmu, sample_rate_hz};
+    if (strcmp(codec, "PCMA") == 0) {
+        format.codec = kPcma;
+    } else if (strcmp(codec, "L16") == 0) {
+        format.codec = kL16;
+    } else if (strcmp(codec, "PCMU") != 0) {
+        return false;
+    }
+    if (WebRtcVad_ValidRateAndFrameLength(sample_rate_hz, (size_t)(sample_rate_hz / 1000 * frame_ms)) != 0) {
+        return false;
+    }
+    options->payload_formats[payload_type] = format;
+    return true;
+}
+
+static bool WriteTimeline(const Stream& stream, const Options& options) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/ssrc_%08x.csv", options.output_dir.c_str(), stream.ssrc);
+    FILE* f = fopen(path, "w");
+    if (f == nullptr) {
+        printf("open %s failed: %s\n", path, strerror(errno));
+        return false;
+    }
+    double frame_seconds = options.frame_ms / 1000.0;
+    for (const Run& run : stream.runs) {
+        fprintf(f, "%.3f,%.3f,%s\n", run.start * frame_seconds, (run.start + run.length) * frame_seconds,
+                kActivityNames[run.activity]);
+    }
+    return fclose(f) == 0;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    vector<const char*> payload_args;
+    const char* capture_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            options.mode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            options.frame_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            payload_args.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.output_dir = argv[++i];
+        } else if (argv[i][0] != '-' && capture_path == nullptr) {
+            capture_path = argv[i];
+        } else {
+            capture_path = nullptr;
+            break;
+        }
+    }
+    bool valid = capture_path != nullptr && options.mode >= 0 && options.mode <= 3 &&
+                 (options.frame_ms == 10 || options.frame_ms == 20 || options.frame_ms == 30);
+    for (const char* arg : payload_args) {
+        if (valid && !ParsePayloadFormat(arg, options.frame_ms, &options)) {
+            printf("invalid payload format %s\n", arg);
+            valid = false;
+        }
+    }
+    if (!valid) {
+        printf("usage: %s [-m mode] [-f frame_ms] [-p pt:codec/rate]... [-o dir] capture.pcap\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int fd = open(capture_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("open %s failed: %s\n", capture_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    size_t size = (size_t)st.st_size;
+    void* data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("mmap %s failed\n", capture_path);
+        return EXIT_FAILURE;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    PcapVad pcap_vad(options);
+    auto start = chrono::steady_clock::now();
+    bool ok = pcap_vad.ProcessCapture(static_cast<const uint8_t*>(data), size);
+    pcap_vad.Finish();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    munmap(data, size);
+    if (!ok) {
+        printf("%s is not a pcap capture\n", capture_path);
+        return EXIT_FAILURE;
+    }
+
+    // Streams in order of appearance.
+    vector<const Stream*> streams;
+    for (const auto& entry : pcap_vad.streams()) {
+        streams.push_back(entry.second.get());
+    }
+    sort(streams.begin(), streams.end(), [](const Stream* a, const Stream* b) { return a->first_time < b->first_time; });
+
+    printf("%-10s %-10s %10s %8s %8s %10s %8s %7s %7s\n", "ssrc", "codec", "packets", "lost", "late", "seconds",
+           "speech", "spurts", "snr_db");
+    for (const Stream* stream : streams) {
+        char codec[32];
+        snprintf(codec, sizeof(codec), "%s/%d", kCodecNames[stream->format.codec], stream->format.sample_rate_hz);
+        uint64_t voiced = stream->frames - stream->gap_frames;
+        VadNoiseEstimate estimate;
+        if (!stream->vad->GetNoiseEstimate(&estimate)) {
+            estimate.total_snr = 0;
+        }
+        printf("0x%08x %-10s %10llu %8llu %8llu %10.2f %7.1f%% %7llu %7.1f\n", stream->ssrc, codec,
+               (unsigned long long)stream->packets, (unsigned long long)stream->lost,
+               (unsigned long long)stream->late, stream->frames * options.frame_ms / 1000.0,
+               voiced > 0 ? 100.0 * stream->speech_frames / voiced : 0.0,
+               (unsigned long long)stream->vad->speech_activity()->talk_spurts, estimate.total_snr / 16.0);
+        if (!WriteTimeline(*stream, options)) {
+            return EXIT_FAILURE;
+        }
+    }
+    printf("%llu packets, %llu RTP, %zu streams in %.3f s (%.2f Mpps)\n", (unsigned long long)pcap_vad.packets(),
+           (unsigned long long)pcap_vad.rtp_packets(), streams.size(), elapsed,
+           elapsed > 0 ? pcap_vad.packets() / elapsed / 1e6 : 0.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+// vad_query: time-range queries on archives written by vad -F vda.
+//
+//   vad_query [-q | -S] archive.vda [start_seconds [end_seconds]]
+//
+// Prints the amount of speech in [start_seconds, end_seconds) (the whole
+// archive by default) and its speech segments, clipped to the range, as
+//   start_seconds,end_seconds
+// lines. -S prints the score of every frame in the range instead, as
+//   seconds,score
+// and -q prints nothing: like grep, the exit status is 0 if there is speech
+// in the range, 1 if not and 2 on errors.
+//
+// The archive is mapped, so a query reads the header, two index entries and
+// the blocks it needs, however long the recording.
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "vad_archive.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    bool quiet = false;
+    bool scores = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        if (strcmp(argv[i], "-q") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "-S") == 0) {
+            scores = true;
+        } else {
+            break;
+        }
+    }
+    if (i >= argc || argc - i > 3 || (quiet && scores) || argv[i][0] == '-') {
+        fprintf(stderr, "usage: %s [-q | -S] archive.vda [start_seconds [end_seconds]]\n", argv[0]);
+        return 2;
+    }
+
+    VadArchiveReader archive;
+    if (!archive.Open(argv[i])) {
+        return 2;
+    }
+    uint64_t begin = i + 1 < argc ? archive.FrameAt(atof(argv[i + 1])) : 0;
+    uint64_t end = i + 2 < argc ? archive.FrameAt(atof(argv[i + 2])) : archive.num_frames();
+    uint64_t speech = archive.CountSpeech(begin, end);
+    if (quiet) {
+        return speech > 0 ? 0 : 1;
+    }
+
+    const double frame_seconds = archive.frame_seconds();
+    if (scores) {
+        if (!archive.has_scores()) {
+            fprintf(stderr, "vad_query: %s has no scores\n", argv[i]);
+            return 2;
+        }
+        vector<int32_t> values(end > begin ? end - begin : 0);
+        size_t count = archive.GetScores(begin, end, values.data());
+        for (size_t k = 0; k < count; k++) {
+            printf("%.2f,%d\n", (begin + k) * frame_seconds, values[k]);
+        }
+        return speech > 0 ? 0 : 1;
+    }
+
+    uint64_t length = end > begin ? end - begin : 0;
+    printf("# %s: %.2f s, mode %d, %d Hz, %d ms frames%s\n", argv[i], archive.num_frames() * frame_seconds,
+           archive.mode(), archive.sample_rate(), archive.frame_ms(), archive.has_scores() ? ", scores" : "");
+    printf("# %.2f s of speech in [%.2f, %.2f) s (%.1f%%)\n", speech * frame_seconds, begin * frame_seconds,
+           end * frame_seconds, length > 0 ? 100.0 * speech / length : 0.0);
+    vector<VadArchiveSegment> segments;
+    archive.GetSegments(begin, end, &segments);
+    for (const VadArchiveSegment& segment : segments) {
+        printf("%.2f,%.2f\n", segment.start * frame_seconds, segment.end * frame_seconds);
+    }
+    return speech > 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// vad_trace: per-frame features and model state of the VAD on a file.
+//
+//   vad_trace [-m mode] [-f frame_ms] file.wav trace.vadt
+//   vad_trace -d trace.vadt
+//
+// The first form runs the VAD over a WAVE file with the VadTraceWriter trace
+// policy and writes one record per frame to trace.vadt (see
+// vad_trace_writer.hpp), then prints the frames per second it sustained to
+// stderr. The second form dumps a trace as CSV, one line per frame:
+//   frame,vad,raw_vad,over_hang,num_of_speech,total_power,feature0..5,
+//   llr0..5,sum_llr,noise_means0..11,speech_means0..11,noise_stds0..11,
+//   speech_stds0..11
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "webrtc/common_audio/wav_reader.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static void PrintValues(const int16_t* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        printf(",%d", values[i]);
+    }
+}
+
+static int Dump(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Open %s failed.\n", path);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < kVadTraceHeaderSize) {
+        fprintf(stderr, "vad_trace: %s is not a trace\n", path);
+        close(fd);
+        return 1;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Map %s failed.\n", path);
+        return 1;
+    }
+    const uint8_t* data = (const uint8_t*)mapping;
+    const uint8_t* p = data + sizeof(kVadTraceMagic);
+    uint16_t version = (uint16_t)VadTraceReadLe(2, &p);
+    size_t record_size = (size_t)VadTraceReadLe(2, &p);
+    uint32_t sample_rate_hz = (uint32_t)VadTraceReadLe(4, &p);
+    uint16_t mode = (uint16_t)VadTraceReadLe(2, &p);
+    uint16_t frame_ms = (uint16_t)VadTraceReadLe(2, &p);
+    if (memcmp(data, kVadTraceMagic, sizeof(kVadTraceMagic)) != 0 || version != kVadTraceVersion ||
+        record_size < kVadTraceRecordSize) {
+        fprintf(stderr, "vad_trace: %s is not a version %d trace\n", path, kVadTraceVersion);
+        munmap(mapping, size);
+        return 1;
+    }
+
+    size_t num_frames = (size - kVadTraceHeaderSize) / record_size;
+    printf("# %s: %zu frames, mode %d, %u Hz, %d ms frames\n", path, num_frames, mode, sample_rate_hz, frame_ms);
+    VadTraceRecord record;
+    for (size_t i = 0; i < num_frames; i++) {
+        WebRtcVad_ReadTraceRecord(data + kVadTraceHeaderSize + i * record_size, &record);
+        printf("%llu,%d,%d,%d,%d,%d", (unsigned long long)record.frame, record.vad, record.raw_vad, record.over_hang,
+               record.num_of_speech, record.total_power);
+        PrintValues(record.features, kNumChannels);
+        PrintValues(record.log_likelihood_ratios, kNumChannels);
+        printf(",%d", record.sum_log_likelihood_ratios);
+        PrintValues(record.noise_means, kTableSize);
+        PrintValues(record.speech_means, kTableSize);
+        PrintValues(record.noise_stds, kTableSize);
+        PrintValues(record.speech_stds, kTableSize);
+        printf("\n");
+    }
+    munmap(mapping, size);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int mode = 0;
+    int frame_ms = 10;
+    int i = 1;
+    if (argc == 3 && strcmp(argv[1], "-d") == 0) {
+        return Dump(argv[2]);
+    }
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-m") == 0) {
+            mode = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            frame_ms = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+    if (argc - i != 2 || mode < 0 || mode > 3 || (frame_ms != 10 && frame_ms != 20 && frame_ms != 30)) {
+        fprintf(stderr,
+                "usage: %s [-m mode] [-f frame_ms] file.wav trace.vadt\n"
+                "       %s -d trace.vadt\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    WavReader reader;
+    if (!reader.Open(argv[i])) {
+        return 1;
+    }
+    VadInst* handle = WebRtcVad_Create();
+    if (handle == NULL || WebRtcVad_Init(handle) != 0 || WebRtcVad_set_mode(handle, mode) != 0) {
+        fprintf(stderr, "vad_trace: init vad failed\n");
+        WebRtcVad_Free(handle);
+        return 1;
+    }
+    VadTraceWriter writer;
+    if (!writer.Open(argv[i + 1], reader.sample_rate(), frame_ms, mode)) {
+        WebRtcVad_Free(handle);
+        return 1;
+    }
+
+    const size_t frame_length = (size_t)reader.sample_rate() / 1000 * frame_ms;
+    int16_t buffer[480];
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t k = 0; k + frame_length <= reader.num_samples(); k += frame_length) {
+        const int16_t* frame = reader.GetFrame(k, frame_length, buffer);
+        if (WebRtcVad_ProcessTraced(handle, reader.sample_rate(), frame, frame_length, writer) < 0) {
+            fprintf(stderr, "vad_trace: process failed at sample %zu\n", k);
+            WebRtcVad_Free(handle);
+            return 1;
+        }
+    }
+    bool ok = writer.Close();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    WebRtcVad_Free(handle);
+    if (!ok) {
+        fprintf(stderr, "vad_trace: write %s failed\n", argv[i + 1]);
+        return 1;
+    }
+    fprintf(stderr, "%llu frames in %.3f s, %.0f frames/s\n", (unsigned long long)writer.num_frames(), seconds,
+            seconds > 0 ? writer.num_frames() / seconds : 0.0);
+    return 0;
+}
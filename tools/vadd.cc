@@ -0,0 +1,428 @@
+// vadd: local VAD service daemon.
+//
+//   vadd [-s socket_path] [-j threads]
+//
+// Clients register streams over a Unix domain socket and exchange frames and
+// decisions through shared memory rings, see vadd_protocol.hpp. The main
+// thread only accepts and registers clients: accepted sockets are
+// non-blocking and registered when their request arrives, so a client that
+// connects and sends nothing does not hold up the others. A registered stream
+// is handed to the worker with the fewest streams, which from then on owns it.
+// Workers sleep on the eventfds the clients signal when they publish frames
+// or pop decisions, and drain the rings of the signalled streams in turns of
+// at most |kMaxFramesPerTurn| frames, so a stream with a deep backlog does not
+// hold up the other streams of its worker.
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vadd_protocol.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+static const int kMaxEvents = 64;
+// Frames of one stream processed before the worker moves on to the next
+// signalled stream.
+static const size_t kMaxFramesPerTurn = 16;
+
+static volatile sig_atomic_t running = 1;
+
+static void Stop(int) { running = 0; }
+
+struct Client {
+    int fd = -1;
+    // Signalled by the client, see vadd_protocol.hpp.
+    int event_fd = -1;
+    uint32_t id = 0;
+    vadd::SharedStream* shared = nullptr;
+    size_t shm_size = 0;
+    int sample_rate_hz = 0;
+    uint64_t sequence = 0;
+    unique_ptr<Vad> vad;
+    bool ready = false;  // Queued in its worker's |ready_|.
+
+    ~Client() {
+        if (shared != nullptr) {
+            munmap(shared, shm_size);
+        }
+        if (event_fd >= 0) {
+            close(event_fd);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+enum RegisterResult { kRegistered, kRegisterPending, kRegisterFailed };
+
+// Receives a RegisterRequest and the attached memfd and eventfd on
+// |client->fd| and maps the shared stream. Returns kRegisterPending if the
+// request has not arrived yet, kRegisterFailed if the client should be
+// dropped.
+static RegisterResult Register(Client* client) {
+    vadd::RegisterRequest request;
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(client->fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return kRegisterPending;
+    }
+    int fds[2] = {-1, -1};
+    struct cmsghdr* cmsg = n >= 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(fds, CMSG_DATA(cmsg), min(sizeof(fds), (size_t)(cmsg->cmsg_len - CMSG_LEN(0))));
+    }
+    const int shm_fd = fds[0];
+    client->event_fd = fds[1];
+    if (n != sizeof(request) || cmsg == nullptr || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)) ||
+        (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) != 0) {
+        if (shm_fd >= 0) {
+            close(shm_fd);
+        }
+        return kRegisterFailed;
+    }
+
+    vadd::RegisterReply reply = {-1, client->id};
+    // Mapping more than the memfd holds would fault on the first access.
+    struct stat st;
+    bool valid = request.version == vadd::kProtocolVersion && request.shm_size >= sizeof(vadd::SharedStream) &&
+                 fstat(shm_fd, &st) == 0 && st.st_size >= 0 && (uint64_t)st.st_size >= request.shm_size &&
+                 WebRtcVad_ValidRateAndFrameLength(request.sample_rate_hz, request.sample_rate_hz / 100) == 0 &&
+                 request.mode >= 0 && request.mode <= 3;
+    if (valid) {
+        void* shared = mmap(nullptr, request.shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        if (shared != MAP_FAILED) {
+            client->shared = static_cast<vadd::SharedStream*>(shared);
+            client->shm_size = request.shm_size;
+        }
+    }
+    close(shm_fd);
+
+    if (client->shared != nullptr && client->shared->magic == vadd::kSharedStreamMagic &&
+        client->shared->version == vadd::kProtocolVersion) {
+        client->sample_rate_hz = request.sample_rate_hz;
+        client->vad.reset(new Vad(static_cast<Vad::Aggressiveness>(request.mode)));
+        if (client->vad->Init()) {
+            reply.status = 0;
+        }
+    }
+    send(client->fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+    return reply.status == 0 ? kRegistered : kRegisterFailed;
+}
+
+// Runs the VAD over up to |max_frames| frames published by |client| for which
+// there is room in its decision ring, reading the samples in place. Returns
+// the number of frames processed.
+static size_t ProcessFrames(Client* client, size_t max_frames) {
+    vadd::SharedStream* shared = client->shared;
+    size_t processed = 0;
+    const vadd::SharedFrame* frame;
+    VadDecision* decision;
+
+    while (processed < max_frames && (decision = shared->decisions.BeginWrite()) != nullptr &&
+           (frame = shared->frames.Front()) != nullptr) {
+        size_t num_samples = frame->num_samples;
+        decision->sequence = client->sequence++;
+        decision->activity = num_samples <= vadd::kMaxFrameSamples
+                                 ? client->vad->IsSpeech(frame->samples, num_samples, client->sample_rate_hz)
+                                 : Vad::kError;
+        shared->frames.Release();
+        shared->decisions.Publish();
+        processed++;
+    }
+    return processed;
+}
+
+// Serves the streams handed to it by Add(). Each stream's socket and eventfd
+// are watched by the worker's epoll: the eventfd queues the stream for
+// processing, a hang up on the socket unregisters it.
+class Worker {
+public:
+    Worker() : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)), wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {}
+
+    ~Worker() {
+        close(wake_fd_);
+        close(epoll_fd_);
+    }
+
+    bool Start() {
+        if (epoll_fd_ < 0 || wake_fd_ < 0 || !Watch(wake_fd_, nullptr)) {
+            return false;
+        }
+        thread_ = thread(&Worker::Run, this);
+        return true;
+    }
+
+    // Called from the main thread.
+    void Add(unique_ptr<Client> client) {
+        num_streams_.fetch_add(1, memory_order_relaxed);
+        {
+            lock_guard<mutex> lock(mutex_);
+            inbox_.push_back(move(client));
+        }
+        Wake();
+    }
+
+    // Called from the main thread.
+    void Stop() {
+        stopping_.store(true);
+        Wake();
+        thread_.join();
+    }
+
+    size_t num_streams() const { return num_streams_.load(memory_order_relaxed); }
+
+private:
+    void Wake() {
+        uint64_t one = 1;
+        (void)!write(wake_fd_, &one, sizeof(one));
+    }
+
+    // Watches |fd| of |client| for input, or |wake_fd_| if |client| is
+    // nullptr.
+    bool Watch(int fd, Client* client) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            return false;
+        }
+        if (client != nullptr) {
+            by_fd_[fd] = client;
+        }
+        return true;
+    }
+
+    void TakeInbox() {
+        deque<unique_ptr<Client>> inbox;
+        {
+            lock_guard<mutex> lock(mutex_);
+            inbox.swap(inbox_);
+        }
+        for (unique_ptr<Client>& client : inbox) {
+            Client* stream = client.get();
+            clients_[stream] = move(client);
+            if (Watch(stream->fd, stream) && Watch(stream->event_fd, stream)) {
+                // Frames may have been published before the eventfd was
+                // watched; their signal is still pending, but look anyway.
+                MarkReady(stream);
+            } else {
+                Remove(stream);
+            }
+        }
+    }
+
+    void MarkReady(Client* client) {
+        if (!client->ready) {
+            client->ready = true;
+            ready_.push_back(client);
+        }
+    }
+
+    void Remove(Client* client) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->fd, nullptr);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client->event_fd, nullptr);
+        by_fd_.erase(client->fd);
+        by_fd_.erase(client->event_fd);
+        if (client->ready) {
+            ready_.erase(find(ready_.begin(), ready_.end(), client));
+        }
+        clients_.erase(client);
+        num_streams_.fetch_sub(1, memory_order_relaxed);
+    }
+
+    void Run() {
+        struct epoll_event events[kMaxEvents];
+        uint64_t count;
+        while (!stopping_.load()) {
+            // Streams left with frames after their turn are served again
+            // without waiting.
+            int n = epoll_wait(epoll_fd_, events, kMaxEvents, ready_.empty() ? -1 : 0);
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd_) {
+                    (void)!read(wake_fd_, &count, sizeof(count));
+                    TakeInbox();
+                    continue;
+                }
+                auto it = by_fd_.find(fd);
+                if (it == by_fd_.end()) {
+                    continue;  // Removed by an earlier event of this batch.
+                }
+                Client* client = it->second;
+                // Clients send nothing after the registration, so any event on
+                // the socket is a hang up.
+                if (fd == client->fd) {
+                    Remove(client);
+                    continue;
+                }
+                // Reset the eventfd before draining, so a signal for frames
+                // published from now on is not lost.
+                (void)!read(client->event_fd, &count, sizeof(count));
+                MarkReady(client);
+            }
+
+            // One turn per ready stream; those that hit the limit stay ready.
+            size_t num_ready = ready_.size();
+            for (size_t i = 0; i < num_ready; i++) {
+                Client* client = ready_.front();
+                ready_.pop_front();
+                client->ready = false;
+                if (ProcessFrames(client, kMaxFramesPerTurn) == kMaxFramesPerTurn) {
+                    MarkReady(client);
+                }
+            }
+        }
+    }
+
+    const int epoll_fd_;
+    const int wake_fd_;
+    thread thread_;
+    atomic<bool> stopping_{false};
+    atomic<size_t> num_streams_{0};
+    mutex mutex_;
+    deque<unique_ptr<Client>> inbox_;  // Added, not yet watched.
+    // Owned by the worker thread.
+    map<Client*, unique_ptr<Client>> clients_;
+    map<int, Client*> by_fd_;  // By socket and by eventfd.
+    deque<Client*> ready_;
+};
+
+int main(int argc, char** argv) {
+    string socket_path = vadd::kDefaultSocketPath;
+    size_t num_threads = 0;
+    map<int, unique_ptr<Client>> pending;
+    uint32_t next_id = 0;
+    struct epoll_event events[kMaxEvents];
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_threads = strtoul(argv[++i], nullptr, 10);
+        } else {
+            printf("usage: %s [-s socket_path] [-j threads]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (num_threads == 0) {
+        num_threads = max(1u, thread::hardware_concurrency());
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 64) != 0) {
+        printf("listen on %s failed: %s\n", socket_path.c_str(), strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listen_event = {};
+    listen_event.events = EPOLLIN;
+    listen_event.data.fd = listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+
+    // Workers block SIGINT and SIGTERM, so that they interrupt the main
+    // thread's epoll_wait().
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    vector<unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.emplace_back(new Worker());
+        if (!workers.back()->Start()) {
+            printf("start worker failed.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    pthread_sigmask(SIG_UNBLOCK, &signals, nullptr);
+    printf("vadd listening on %s with %zu workers\n", socket_path.c_str(), num_threads);
+    fflush(stdout);
+
+    while (running) {
+        int n = epoll_wait(epoll_fd, events, kMaxEvents, -1);
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd) {
+                unique_ptr<Client> client(new Client());
+                client->fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+                client->id = next_id++;
+                if (client->fd < 0) {
+                    continue;
+                }
+                struct epoll_event client_event = {};
+                client_event.events = EPOLLIN | EPOLLRDHUP;
+                client_event.data.fd = client->fd;
+                if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client->fd, &client_event) == 0) {
+                    pending[client->fd] = move(client);
+                }
+                continue;
+            }
+            auto it = pending.find(fd);
+            if (it == pending.end()) {
+                continue;
+            }
+            RegisterResult result =
+                (events[i].events & EPOLLIN) != 0 ? Register(it->second.get()) : kRegisterFailed;
+            if (result == kRegisterPending) {
+                continue;
+            }
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            if (result == kRegistered) {
+                Worker* worker = min_element(workers.begin(), workers.end(),
+                                             [](const unique_ptr<Worker>& a, const unique_ptr<Worker>& b) {
+                                                 return a->num_streams() < b->num_streams();
+                                             })
+                                     ->get();
+                worker->Add(move(it->second));
+            }
+            pending.erase(it);
+        }
+    }
+
+    for (unique_ptr<Worker>& worker : workers) {
+        worker->Stop();
+    }
+    workers.clear();
+    pending.clear();
+    close(epoll_fd);
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+// vadd_client: streams a wav file through vadd and checks the decisions.
+//
+//   vadd_client [-s socket_path] [-m mode] [-n streams] file.wav
+//
+// Registers |streams| streams, feeds the file's 10 ms frames to all of them
+// through shared memory and compares every decision with a local Vad. Exits
+// with a failure status on any mismatch, which makes it an end-to-end check
+// of a running daemon.
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <new>
+#include <string>
+#include <vector>
+
+#include "vadd_protocol.hpp"
+#include "webrtc/common_audio/wav_reader.hpp"
+#include "webrtc/webrtc.hpp"
+
+using namespace std;
+using namespace webrtc;
+
+struct Stream {
+    int fd = -1;
+    int event_fd = -1;  // Signals the daemon, see vadd_protocol.hpp.
+    vadd::SharedStream* shared = nullptr;
+    size_t submitted = 0;
+    size_t received = 0;
+};
+
+static bool Connect(const string& socket_path, int sample_rate_hz, int mode, Stream* stream) {
+    size_t shm_size = sizeof(vadd::SharedStream);
+    int shm_fd = memfd_create("vadd_stream", MFD_CLOEXEC);
+    if (shm_fd < 0 || ftruncate(shm_fd, shm_size) != 0) {
+        return false;
+    }
+    void* memory = mmap(nullptr, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (memory == MAP_FAILED) {
+        close(shm_fd);
+        return false;
+    }
+    stream->shared = new (memory) vadd::SharedStream();
+    stream->shared->magic = vadd::kSharedStreamMagic;
+    stream->shared->version = vadd::kProtocolVersion;
+
+    stream->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stream->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (stream->event_fd < 0 || connect(stream->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(shm_fd);
+        return false;
+    }
+
+    vadd::RegisterRequest request = {vadd::kProtocolVersion, sample_rate_hz, mode, (uint32_t)shm_size};
+    const int fds[2] = {shm_fd, stream->event_fd};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    bool sent = sendmsg(stream->fd, &msg, 0) == sizeof(request);
+    close(shm_fd);
+    vadd::RegisterReply reply;
+    return sent && recv(stream->fd, &reply, sizeof(reply), 0) == sizeof(reply) && reply.status == 0;
+}
+
+int main(int argc, char** argv) {
+    string socket_path = vadd::kDefaultSocketPath;
+    string file_path;
+    int mode = 2;
+    size_t num_streams = 1;
+    WavReader reader;
+    int16_t buf[vadd::kMaxFrameSamples];
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mode = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num_streams = strtoul(argv[++i], nullptr, 10);
+        } else {
+            file_path = argv[i];
+        }
+    }
+    if (file_path.empty()) {
+        printf("usage: %s [-s socket_path] [-m mode] [-n streams] file.wav\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!reader.Open(file_path.c_str())) {
+        return EXIT_FAILURE;
+    }
+    // 10 ms frames.
+    const int sample_rate = reader.sample_rate();
+    const size_t frame_length = sample_rate / 100;
+    size_t num_frames = reader.num_samples() / frame_length;
+
+    vector<int> expected;
+    Vad vad(static_cast<Vad::Aggressiveness>(mode));
+    if (!vad.Init()) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < num_frames; i++) {
+        expected.push_back(vad.IsSpeech(reader.GetFrame(i * frame_length, frame_length, buf), frame_length, sample_rate));
+    }
+
+    vector<Stream> streams(num_streams);
+    for (Stream& stream : streams) {
+        if (!Connect(socket_path, sample_rate, mode, &stream)) {
+            printf("register with %s failed\n", socket_path.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t mismatches = 0;
+    size_t done = 0;
+    while (done < num_streams) {
+        done = 0;
+        for (Stream& stream : streams) {
+            const size_t submitted = stream.submitted;
+            const size_t received = stream.received;
+            while (stream.submitted < num_frames) {
+                vadd::SharedFrame* frame = stream.shared->frames.BeginWrite();
+                if (frame == nullptr) {
+                    break;
+                }
+                const int16_t* samples = reader.GetFrame(stream.submitted * frame_length, frame_length, frame->samples);
+                if (samples != frame->samples) {
+                    memcpy(frame->samples, samples, frame_length * sizeof(int16_t));
+                }
+                frame->num_samples = frame_length;
+                stream.shared->frames.Publish();
+                stream.submitted++;
+            }
+            VadDecision decision;
+            while (stream.shared->decisions.TryPop(&decision)) {
+                mismatches += decision.sequence != stream.received || decision.activity != expected[stream.received];
+                stream.received++;
+            }
+            // Wake the daemon for the new frames, or for the frames it left
+            // queued until there was room for their decisions.
+            if (stream.submitted != submitted || stream.received != received) {
+                uint64_t one = 1;
+                (void)!write(stream.event_fd, &one, sizeof(one));
+            }
+            done += stream.received == num_frames;
+        }
+        usleep(100);
+    }
+
+    for (Stream& stream : streams) {
+        close(stream.fd);
+        close(stream.event_fd);
+        munmap(stream.shared, sizeof(vadd::SharedStream));
+    }
+    printf("streams: %zu, frames: %zu, mismatches: %zu\n", num_streams, num_streams * num_frames, mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+#ifndef TOOLS_VADD_PROTOCOL_HPP
+#define TOOLS_VADD_PROTOCOL_HPP
+#include <stdint.h>
+
+#include "webrtc/vad/vad_ring.hpp"
+
+// Protocol between vadd, the local VAD daemon, and its clients.
+//
+// A client creates a shared memory segment (memfd) holding a SharedStream and
+// an eventfd, connects to the daemon's Unix domain socket (SOCK_SEQPACKET) and
+// sends a RegisterRequest with both file descriptors attached (SCM_RIGHTS),
+// the memfd first. The daemon maps the segment, answers with a RegisterReply
+// and from then on runs the VAD directly on the frames the client publishes
+// in |SharedStream::frames|, writing decisions to |SharedStream::decisions|.
+// The daemon sleeps until the client adds to the eventfd, which it must do
+// after publishing frames, and after popping decisions while frames are
+// waiting, since the daemon leaves frames queued while the decision ring is
+// full. One signal may cover any number of frames. Closing the socket
+// unregisters the stream.
+namespace vadd {
+static const char kDefaultSocketPath[] = "/tmp/vadd.sock";
+static const uint32_t kSharedStreamMagic = 0x56414453;  // "VADS"
+static const uint32_t kProtocolVersion = 2;
+static const size_t kFrameSlots = 64;
+// 30 ms at 48 kHz.
+static const size_t kMaxFrameSamples = 1440;
+
+typedef webrtc::VadAudioFrame<kMaxFrameSamples> SharedFrame;
+
+// Lives at the start of the shared memory segment. Constructed in place by
+// the client. The rings are lock-free, so their atomics work across
+// processes.
+struct SharedStream {
+    uint32_t magic;
+    uint32_t version;
+    webrtc::SpscRing<SharedFrame, kFrameSlots> frames;             // Client -> daemon.
+    webrtc::SpscRing<webrtc::VadDecision, kFrameSlots> decisions;  // Daemon -> client.
+};
+
+struct RegisterRequest {
+    uint32_t version;
+    int32_t sample_rate_hz;
+    int32_t mode;  // Aggressiveness, 0 - 3.
+    uint32_t shm_size;
+};
+
+struct RegisterReply {
+    int32_t status;  // 0 - (OK), -1 - (rejected).
+    uint32_t stream_id;
+};
+}  // namespace vadd
+#endif